@@ -39,6 +39,7 @@
 #endif
 #include "common/debug.h"
 #include "common/numa.h"
+#include "common/perf_counters.h"
 
 #include "global/global_context.h"
 #include "io_uring.h"
@@ -80,7 +81,30 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, ai
   if (use_ioring && ioring_queue_t::supported()) {
     bool use_ioring_hipri = cct->_conf.get_val<bool>("bdev_ioring_hipri");
     bool use_ioring_sqthread_poll = cct->_conf.get_val<bool>("bdev_ioring_sqthread_poll");
-    io_queue = std::make_unique<ioring_queue_t>(iodepth, use_ioring_hipri, use_ioring_sqthread_poll);
+    uint64_t fixed_buffers = cct->_conf.get_val<uint64_t>("bdev_ioring_fixed_buffers");
+    uint64_t fixed_buffer_size = 0;
+    if (fixed_buffers) {
+      fixed_buffer_size = p2roundup<uint64_t>(
+	cct->_conf.get_val<Option::size_t>("bdev_ioring_fixed_buffer_size"),
+	CEPH_PAGE_SIZE);
+      // the pool is registered as a single iovec, which is capped at 1G
+      constexpr uint64_t max_region = 1ull << 30;
+      if (fixed_buffer_size == 0 || fixed_buffer_size > max_region) {
+	derr << "WARNING: bdev_ioring_fixed_buffer_size " << fixed_buffer_size
+	     << " is out of range, not using io_uring fixed buffers" << dendl;
+	fixed_buffers = 0;
+      } else {
+	fixed_buffers = std::min<uint64_t>(fixed_buffers,
+					   max_region / fixed_buffer_size);
+      }
+    }
+    if (fixed_buffers) {
+      ioring_buffers = std::make_shared<ioring_fixed_buffers_t>(
+	fixed_buffer_size, fixed_buffers);
+    }
+    io_queue = std::make_unique<ioring_queue_t>(iodepth, use_ioring_hipri,
+						use_ioring_sqthread_poll,
+						ioring_buffers);
   } else {
     static bool once;
     if (use_ioring && !once) {
@@ -514,6 +538,28 @@ int KernelDevice::_aio_start()
       }
       return r;
     }
+    if (ioring_buffers && !ioring_buffers->registered) {
+      derr << __func__ << " failed to register io_uring fixed buffers: "
+	   << cpp_strerror(ioring_buffers->register_error)
+	   << "; check RLIMIT_MEMLOCK. continuing without them" << dendl;
+    }
+    if (ioring_buffers) {
+      string name = "bdev-ioring:" + path.substr(path.rfind('/') + 1);
+      PerfCountersBuilder b(cct, name,
+			    l_bdev_ioring_first, l_bdev_ioring_last);
+      b.add_u64_counter(l_bdev_ioring_fixed_reads, "fixed_reads",
+			"Reads submitted into registered buffers");
+      b.add_u64_counter(l_bdev_ioring_fixed_writes, "fixed_writes",
+			"Writes submitted from registered buffers");
+      b.add_u64_counter(l_bdev_ioring_unfixed_ios, "unfixed_ios",
+			"I/Os submitted with plain iovecs");
+      b.add_u64_counter(l_bdev_ioring_fixed_buffer_misses,
+			"fixed_buffer_misses",
+			"Registered buffer wanted but none was free or large enough");
+      ioring_logger = b.create_perf_counters();
+      cct->get_perfcounters_collection()->add(ioring_logger);
+      ioring_buffers->logger = ioring_logger;
+    }
     aio_thread.create("bstore_aio");
   }
   return 0;
@@ -527,6 +573,12 @@ void KernelDevice::_aio_stop()
     aio_thread.join();
     aio_stop = false;
     io_queue->shutdown();
+    if (ioring_logger) {
+      ioring_buffers->logger = nullptr;
+      cct->get_perfcounters_collection()->remove(ioring_logger);
+      delete ioring_logger;
+      ioring_logger = nullptr;
+    }
   }
 }
 
@@ -1021,6 +1073,16 @@ int KernelDevice::aio_write(
 	ioc->pending_aios.push_back(aio_t(ioc, choose_fd(false, write_hint)));
 	++ioc->num_pending;
 	auto& aio = ioc->pending_aios.back();
+	if (ioring_buffers) {
+	  // a copy into a registered buffer is cheaper than having the
+	  // kernel pin the pages of a small write
+	  if (auto raw = ioring_buffers->try_create(len); raw) {
+	    bufferptr p(std::move(raw));
+	    bl.begin().copy(len, p.c_str());
+	    bl.clear();
+	    bl.append(std::move(p));
+	  }
+	}
 	bl.prepare_iov(&aio.iov);
 	aio.bl.claim_append(bl);
 	aio.pwritev(off, len);
@@ -1207,11 +1269,21 @@ HugePagePoolOfPools HugePagePoolOfPools::from_desc(const std::string& desc) {
 }
 
 // create a buffer basing on user-configurable. it's intended to make
-// our buffers THP-able.
+// our buffers THP-able. only reads submitted through the aio queue can
+// use the io_uring registered buffers; a pread gains nothing from them.
 ceph::unique_leakable_ptr<buffer::raw> KernelDevice::create_custom_aligned(
   const size_t len,
-  IOContext* const ioc) const
+  IOContext* const ioc,
+  const bool for_aio) const
 {
+  if (for_aio && ioring_buffers) {
+    if (auto raw = ioring_buffers->try_create(len); raw) {
+      // recycle the registered buffer as soon as the reader is done
+      // with it; caching it would drain the pool.
+      ioc->flags |= IOContext::FLAG_DONT_CACHE;
+      return raw;
+    }
+  }
   // just to preserve the logic of create_small_page_aligned().
   if (len < CEPH_PAGE_SIZE) {
     return ceph::buffer::create_small_page_aligned(len);
@@ -1307,7 +1379,7 @@ int KernelDevice::aio_read(
     ++ioc->num_pending;
     aio_t& aio = ioc->pending_aios.back();
     aio.bl.push_back(
-      ceph::buffer::ptr_node::create(create_custom_aligned(len, ioc)));
+      ceph::buffer::ptr_node::create(create_custom_aligned(len, ioc, true)));
     aio.bl.prepare_iov(&aio.iov);
     aio.preadv(off, len);
     dout(30) << aio << dendl;
@@ -28,6 +28,9 @@
 
 #define RW_IO_MAX (INT_MAX & CEPH_PAGE_MASK)
 
+class PerfCounters;
+struct ioring_fixed_buffers_t;
+
 class KernelDevice : public BlockDevice {
 protected:
   std::string path;
@@ -47,6 +50,9 @@ private:
   ceph::mutex flush_mutex = ceph::make_mutex("KernelDevice::flush_mutex");
 
   std::unique_ptr<io_queue_t> io_queue;
+  /// registered io_uring buffers, if bdev_ioring_fixed_buffers is set
+  std::shared_ptr<ioring_fixed_buffers_t> ioring_buffers;
+  PerfCounters *ioring_logger = nullptr;
   aio_callback_t discard_callback;
   void *discard_callback_priv;
   bool aio_stop;
@@ -112,7 +118,8 @@ private:
 
   int choose_fd(bool buffered, int write_hint) const;
 
-  ceph::unique_leakable_ptr<buffer::raw> create_custom_aligned(size_t len, IOContext* ioc) const;
+  ceph::unique_leakable_ptr<buffer::raw> create_custom_aligned(
+    size_t len, IOContext* ioc, bool for_aio = false) const;
 
 public:
   KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, aio_callback_t d_cb, void *d_cbpriv);
@@ -1,7 +1,67 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 // vim: ts=8 sw=2 smarttab
 
+#include <sys/mman.h>
+
 #include "io_uring.h"
+#include "common/perf_counters.h"
+#include "include/buffer_raw.h"
+
+namespace {
+
+struct fixed_buffer_raw : public ceph::buffer::raw {
+  std::shared_ptr<ioring_fixed_buffers_t> pool;
+
+  fixed_buffer_raw(char *buf, size_t len,
+		   std::shared_ptr<ioring_fixed_buffers_t> pool)
+    : raw(buf, len), pool(std::move(pool)) {
+  }
+  ~fixed_buffer_raw() override {
+    // recycle, the mapping belongs to the pool
+    pool->free_q.push(data);
+  }
+};
+
+} // anonymous namespace
+
+ioring_fixed_buffers_t::ioring_fixed_buffers_t(size_t buffer_size,
+					       size_t count)
+  : buffer_size(p2roundup<size_t>(buffer_size, CEPH_PAGE_SIZE)),
+    free_q(count)
+{
+  region_size = this->buffer_size * count;
+  void *p = ::mmap(nullptr, region_size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+  if (p == MAP_FAILED) {
+    ceph_abort_msg("can't allocate io_uring fixed buffers");
+  }
+  region = static_cast<char*>(p);
+  for (size_t i = 0; i < count; ++i) {
+    free_q.push(region + i * this->buffer_size);
+  }
+}
+
+ioring_fixed_buffers_t::~ioring_fixed_buffers_t()
+{
+  ::munmap(region, region_size);
+}
+
+ceph::unique_leakable_ptr<ceph::buffer::raw>
+ioring_fixed_buffers_t::try_create(size_t len)
+{
+  if (!registered) {
+    return nullptr;
+  }
+  char *buf;
+  if (len <= buffer_size && free_q.pop(buf)) {
+    return ceph::unique_leakable_ptr<ceph::buffer::raw>(
+      new fixed_buffer_raw(buf, len, shared_from_this()));
+  }
+  if (logger) {
+    logger->inc(l_bdev_ioring_fixed_buffer_misses);
+  }
+  return nullptr;
+}
 
 #if defined(HAVE_LIBURING)
 
@@ -17,6 +77,7 @@ struct ioring_data {
   pthread_mutex_t sq_mutex;
   int epoll_fd = -1;
   std::map<int, int> fixed_fds_map;
+  ioring_fixed_buffers_t *fixed_buffers = nullptr;  ///< if registered
 };
 
 static int ioring_get_cqe(struct ioring_data *d, unsigned int max,
@@ -57,6 +118,30 @@ static void init_sqe(struct ioring_data *d, struct io_uring_sqe *sqe,
 
   ceph_assert(fixed_fd != -1);
 
+  auto fb = d->fixed_buffers;
+  if (fb && io->iov.size() == 1 &&
+      fb->contains(io->iov[0].iov_base, io->iov[0].iov_len)) {
+    // the whole pool is registered as buffer index 0
+    if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV) {
+      io_uring_prep_write_fixed(sqe, fixed_fd, io->iov[0].iov_base,
+				io->iov[0].iov_len, io->offset, 0);
+      if (fb->logger)
+	fb->logger->inc(l_bdev_ioring_fixed_writes);
+    } else if (io->iocb.aio_lio_opcode == IO_CMD_PREADV) {
+      io_uring_prep_read_fixed(sqe, fixed_fd, io->iov[0].iov_base,
+			       io->iov[0].iov_len, io->offset, 0);
+      if (fb->logger)
+	fb->logger->inc(l_bdev_ioring_fixed_reads);
+    } else {
+      ceph_assert(0);
+    }
+    io_uring_sqe_set_data(sqe, io);
+    io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+    return;
+  }
+  if (fb && fb->logger)
+    fb->logger->inc(l_bdev_ioring_unfixed_ios);
+
   if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV)
     io_uring_prep_writev(sqe, fixed_fd, &io->iov[0],
 			 io->iov.size(), io->offset);
@@ -106,11 +191,13 @@ static void build_fixed_fds_map(struct ioring_data *d,
   }
 }
 
-ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_) :
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_,
+			       std::shared_ptr<ioring_fixed_buffers_t> fixed_buffers_) :
   d(make_unique<ioring_data>()),
   iodepth(iodepth_),
   hipri(hipri_),
-  sq_thread(sq_thread_)
+  sq_thread(sq_thread_),
+  fixed_buffers(std::move(fixed_buffers_))
 {
 }
 
@@ -143,6 +230,20 @@ int ioring_queue_t::init(std::vector<int> &fds)
 
   build_fixed_fds_map(d.get(), fds);
 
+  if (fixed_buffers) {
+    struct iovec iov;
+    iov.iov_base = fixed_buffers->region;
+    iov.iov_len = fixed_buffers->region_size;
+    ret = io_uring_register_buffers(&d->io_uring, &iov, 1);
+    if (ret < 0) {
+      // not fatal, the queue works without them
+      fixed_buffers->register_error = ret;
+    } else {
+      d->fixed_buffers = fixed_buffers.get();
+      fixed_buffers->registered = true;
+    }
+  }
+
   d->epoll_fd = epoll_create1(0);
   if (d->epoll_fd < 0) {
     ret = -errno;
@@ -162,6 +263,10 @@ int ioring_queue_t::init(std::vector<int> &fds)
 close_epoll_fd:
   close(d->epoll_fd);
 close_ring_fd:
+  if (d->fixed_buffers) {
+    d->fixed_buffers->registered = false;
+    d->fixed_buffers = nullptr;
+  }
   io_uring_queue_exit(&d->io_uring);
 
   return ret;
@@ -170,6 +275,10 @@ close_ring_fd:
 void ioring_queue_t::shutdown()
 {
   d->fixed_fds_map.clear();
+  if (d->fixed_buffers) {
+    d->fixed_buffers->registered = false;
+    d->fixed_buffers = nullptr;
+  }
   close(d->epoll_fd);
   d->epoll_fd = -1;
   io_uring_queue_exit(&d->io_uring);
@@ -224,7 +333,8 @@ bool ioring_queue_t::supported()
 
 struct ioring_data {};
 
-ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_)
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_,
+			       std::shared_ptr<ioring_fixed_buffers_t> fixed_buffers_)
 {
   ceph_assert(0);
 }
@@ -5,9 +5,54 @@
 
 #include "acconfig.h"
 
+#include <atomic>
+
+#include <boost/lockfree/queue.hpp>
+
+#include "include/intarith.h"
 #include "include/types.h"
 #include "aio/aio.h"
 
+class PerfCounters;
+
+enum {
+  l_bdev_ioring_first = 93000,
+  l_bdev_ioring_fixed_reads,
+  l_bdev_ioring_fixed_writes,
+  l_bdev_ioring_unfixed_ios,
+  l_bdev_ioring_fixed_buffer_misses,
+  l_bdev_ioring_last,
+};
+
+/// Equally sized buffers carved out of a single anonymous mapping that is
+/// registered with the ring.  I/O into these buffers is submitted as
+/// IORING_OP_{READ,WRITE}_FIXED, which saves the kernel from pinning and
+/// unpinning the user pages on every request.  Buffers handed out keep
+/// the pool alive, so they may safely outlive the ring.
+struct ioring_fixed_buffers_t
+  : public std::enable_shared_from_this<ioring_fixed_buffers_t> {
+  ioring_fixed_buffers_t(size_t buffer_size, size_t count);
+  ~ioring_fixed_buffers_t();
+
+  /// returns nullptr if len is larger than a buffer or none is free
+  ceph::unique_leakable_ptr<ceph::buffer::raw> try_create(size_t len);
+
+  bool contains(const void *p, size_t len) const {
+    auto c = static_cast<const char*>(p);
+    return c >= region && c + len <= region + region_size;
+  }
+
+  char *region = nullptr;
+  size_t region_size = 0;
+  const size_t buffer_size;
+  /// buffers are only handed out while the region is registered with the
+  /// ring; registration can fail, e.g. on RLIMIT_MEMLOCK
+  std::atomic<bool> registered = false;
+  int register_error = 0;
+  boost::lockfree::queue<char*> free_q;
+  PerfCounters *logger = nullptr;
+};
+
 struct ioring_data;
 
 struct ioring_queue_t final : public io_queue_t {
@@ -15,13 +60,15 @@ struct ioring_queue_t final : public io_queue_t {
   unsigned iodepth = 0;
   bool hipri = false;
   bool sq_thread = false;
+  std::shared_ptr<ioring_fixed_buffers_t> fixed_buffers;
 
   typedef std::list<aio_t>::iterator aio_iter;
 
   // Returns true if arch is x86-64 and kernel supports io_uring
   static bool supported();
 
-  ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_);
+  ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_,
+		 std::shared_ptr<ioring_fixed_buffers_t> fixed_buffers_ = {});
   ~ioring_queue_t() final;
 
   int init(std::vector<int> &fds) final;
@@ -480,11 +480,18 @@ int rgw_bucket_list(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
 {
   CLS_LOG(10, "entered %s", __func__);
 
-  // maximum number of calls to get_obj_vals we'll try; compromise
-  // between wanting to return the requested # of entries, but not
-  // wanting to slow down this op with too many omap reads
+  // we'll read at most as many keys as this many full calls to
+  // get_obj_vals would; compromise between wanting to return the
+  // requested # of entries, but not wanting to slow down this op with
+  // too many omap reads
   constexpr int max_attempts = 8;
 
+  // with a delimiter, once a read ends inside a common prefix the rest
+  // of it was skipped over, and the read following the seek past that
+  // prefix will likely land in another one; so read this few keys
+  // until a read comes back that is not swallowed by a prefix
+  constexpr uint32_t delim_probe_entries = 8;
+
   auto iter = in->cbegin();
 
   rgw_cls_list_op op;
@@ -543,26 +550,36 @@ int rgw_bucket_list(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
     start_after_omap_key = cls_rgw_after_delim(start_after_omap_key);
   }
 
+  const uint64_t max_keys = uint64_t(max_attempts) * op.num_entries;
+  uint64_t keys_read = 0;
+  bool probe = false; // last read ended inside a common prefix
+
   for (int attempt = 0;
-       attempt < max_attempts &&
+       keys_read < max_keys &&
 	 more &&
 	 !done &&
 	 name_entry_map.size() < op.num_entries;
        ++attempt) {
     std::map<std::string, bufferlist> keys;
 
+    uint32_t read_entries = op.num_entries - name_entry_map.size();
+    if (probe) {
+      read_entries = std::min(read_entries, delim_probe_entries);
+    }
+    probe = false;
+
     // note: get_obj_vals skips past the "ugly namespace" (i.e.,
     // entries that start with the BI_PREFIX_CHAR), so no need to
     // check for such entries
     rc = get_obj_vals(hctx, start_after_omap_key, op.filter_prefix,
-		      op.num_entries - name_entry_map.size(),
-		      &keys, &more);
+		      read_entries, &keys, &more);
     if (rc < 0) {
       return rc;
     }
     CLS_LOG(20, "%s: on attempt %d get_obj_vls returned %ld entries, more=%d",
 	    __func__, attempt, keys.size(), more);
 
+    keys_read += keys.size();
     done = keys.empty();
 
     for (auto kiter = keys.cbegin(); kiter != keys.cend(); ++kiter) {
@@ -640,6 +657,10 @@ int rgw_bucket_list(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
 	  // advance past this subdirectory, but then back up one,
 	  // so the loop increment will put us in the right place
 	  kiter = keys.lower_bound(start_after_omap_key);
+	  if (kiter == keys.end()) {
+	    // the rest of this read was in the subdirectory
+	    probe = true;
+	  }
 	  --kiter;
 
           continue;
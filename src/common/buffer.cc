@@ -12,6 +12,7 @@
  *
  */
 
+#include <array>
 #include <atomic>
 #include <cstring>
 #include <errno.h>
@@ -81,15 +82,261 @@ static ceph::spinlock debug_lock;
     return buffer_missed_crc;
   }
 
+  /*
+   * small_raw_pool keeps per-thread free lists of the allocations
+   * backing small raw_combined buffers, so the encode and messenger
+   * paths churning through them stay away from malloc.  Every slot
+   * starts with a header naming the thread cache it belongs to; a slot
+   * freed by another thread is pushed onto its owner's lock free
+   * remote list, which the owner collects once a local list runs dry;
+   * past max_remote_bytes such slots go straight back to malloc.
+   * Idle slots are accounted in mempool buffer_slab.  A thread may keep
+   * num_classes * max_idle_bytes idle plus max_remote_bytes queued, so
+   * the pool is off unless buffer_small_pool (or the
+   * CEPH_BUFFER_SMALL_POOL environment variable) turns it on.
+   */
+  namespace small_raw_pool {
+    constexpr std::array<size_t, 6> slot_sizes = {
+      256, 512, 1024, 2048, 3072, 4608
+    };
+    constexpr unsigned num_classes = slot_sizes.size();
+    // idle bytes a thread keeps per class before returning slots to malloc
+    constexpr size_t max_idle_bytes = 256 * 1024;
+    // bytes other threads may queue on a thread's remote list; past that
+    // they free straight to malloc, e.g. while the owner is idle
+    constexpr size_t max_remote_bytes = num_classes * max_idle_bytes;
+    // also the largest data alignment the pool can honour
+    constexpr size_t header_size = 16;
+
+    struct cache_t;
+    struct alignas(header_size) header_t {
+      cache_t *owner;
+      unsigned cls;
+    };
+    // a slot sitting in a free list
+    struct free_slot_t : header_t {
+      free_slot_t *next;
+    };
+    static_assert(sizeof(header_t) == header_size);
+    static_assert(sizeof(free_slot_t) <= slot_sizes[0]);
+
+    struct cache_t {
+      // held by the owning thread and by every slot it allocated
+      std::atomic<unsigned> nref{1};
+      std::atomic<bool> dead{false};
+      std::atomic<free_slot_t*> remote{nullptr};
+      // bytes on the remote list, bounded by max_remote_bytes
+      std::atomic<size_t> remote_bytes{0};
+      // only touched by the owning thread
+      std::array<free_slot_t*, num_classes> local{};
+      std::array<size_t, num_classes> nlocal{};
+      // buffer_slab accounting not yet published to the mempool
+      ssize_t pending_items = 0;
+      ssize_t pending_bytes = 0;
+
+      void get() {
+	nref.fetch_add(1, std::memory_order_relaxed);
+      }
+      void put() {
+	if (nref.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+	  delete this;
+	}
+      }
+    };
+
+    static std::atomic<bool> enabled{get_env_bool("CEPH_BUFFER_SMALL_POOL")};
+    static thread_local cache_t *tls_cache = nullptr;
+    static thread_local bool tls_cache_gone = false;
+
+    static void flush_account(cache_t *c) {
+      mempool::get_pool(mempool::mempool_buffer_slab).adjust_count(
+	c->pending_items, c->pending_bytes);
+      c->pending_items = c->pending_bytes = 0;
+    }
+
+    // the sharded mempool counters cost as much as the pool itself,
+    // so batch updates per thread
+    static void account(unsigned cls, int n) {
+      cache_t *c = tls_cache;
+      if (!c) {
+	mempool::get_pool(mempool::mempool_buffer_slab).adjust_count(
+	  n, n * (ssize_t)slot_sizes[cls]);
+	return;
+      }
+      c->pending_items += n;
+      c->pending_bytes += n * (ssize_t)slot_sizes[cls];
+      if (c->pending_items >= 64 || c->pending_items <= -64) {
+	flush_account(c);
+      }
+    }
+
+    // hand an idle slot back to malloc
+    static void release(free_slot_t *s) {
+      account(s->cls, -1);
+      cache_t *owner = s->owner;
+      ::free(s);
+      owner->put();
+    }
+
+    // detach the remote list, and uncount its bytes
+    static free_slot_t *take_remote(cache_t *c) {
+      free_slot_t *head = c->remote.exchange(nullptr, std::memory_order_acquire);
+      size_t bytes = 0;
+      for (free_slot_t *s = head; s; s = s->next) {
+	bytes += slot_sizes[s->cls];
+      }
+      c->remote_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+      return head;
+    }
+
+    static void release_remote(cache_t *c) {
+      free_slot_t *s = take_remote(c);
+      while (s) {
+	free_slot_t *next = s->next;
+	release(s);
+	s = next;
+      }
+    }
+
+    static bool push_local(cache_t *c, free_slot_t *s) {
+      if (c->nlocal[s->cls] * slot_sizes[s->cls] >= max_idle_bytes) {
+	return false;
+      }
+      s->next = c->local[s->cls];
+      c->local[s->cls] = s;
+      ++c->nlocal[s->cls];
+      return true;
+    }
+
+    static void collect_remote(cache_t *c) {
+      free_slot_t *s = take_remote(c);
+      while (s) {
+	free_slot_t *next = s->next;
+	if (!push_local(c, s)) {
+	  release(s);
+	}
+	s = next;
+      }
+    }
+
+    struct thread_exit_t {
+      ~thread_exit_t() {
+	cache_t *c = tls_cache;
+	if (!c) {
+	  tls_cache_gone = true;
+	  return;
+	}
+	flush_account(c);
+	tls_cache = nullptr;
+	tls_cache_gone = true;
+	// slots freed from now on go straight back to malloc; those
+	// pushed while we drain are released by whoever pushed them
+	c->dead = true;
+	release_remote(c);
+	for (unsigned cls = 0; cls < num_classes; ++cls) {
+	  while (free_slot_t *s = c->local[cls]) {
+	    c->local[cls] = s->next;
+	    release(s);
+	  }
+	}
+	c->put();
+      }
+    };
+
+    static cache_t *get_cache() {
+      if (likely(tls_cache != nullptr)) {
+	return tls_cache;
+      }
+      if (tls_cache_gone) {
+	return nullptr;
+      }
+      static thread_local thread_exit_t exit_hook;
+      (void)exit_hook;
+      tls_cache = new cache_t;
+      return tls_cache;
+    }
+
+    /// @return the data of a slot holding total bytes, or nullptr
+    static char *allocate(size_t total) {
+      unsigned cls = 0;
+      while (slot_sizes[cls] < total) {
+	++cls;
+      }
+      cache_t *c = get_cache();
+      if (!c) {
+	return nullptr;
+      }
+      free_slot_t *s = c->local[cls];
+      if (!s) {
+	collect_remote(c);
+	s = c->local[cls];
+      }
+      if (s) {
+	c->local[cls] = s->next;
+	--c->nlocal[cls];
+	account(cls, -1);
+      } else {
+	void *p = nullptr;
+	if (::posix_memalign(&p, header_size, slot_sizes[cls])) {
+	  throw buffer::bad_alloc();
+	}
+	s = static_cast<free_slot_t*>(p);
+	s->owner = c;
+	s->cls = cls;
+	c->get();
+      }
+      return reinterpret_cast<char*>(s) + header_size;
+    }
+
+    static void deallocate(char *data) {
+      auto s = reinterpret_cast<free_slot_t*>(data - header_size);
+      cache_t *owner = s->owner;
+      account(s->cls, 1);
+      if (owner == tls_cache) {
+	if (!push_local(owner, s)) {
+	  release(s);
+	}
+	return;
+      }
+      // s holds a reference on owner, but may be gone once pushed
+      owner->get();
+      const size_t bytes = slot_sizes[s->cls];
+      if (owner->dead) {
+	release(s);
+      } else if (owner->remote_bytes.fetch_add(bytes, std::memory_order_relaxed) +
+		   bytes > max_remote_bytes) {
+	// the owner isn't collecting; don't let its list grow without bound
+	owner->remote_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+	release(s);
+      } else {
+	free_slot_t *head = owner->remote.load(std::memory_order_relaxed);
+	do {
+	  s->next = head;
+	} while (!owner->remote.compare_exchange_weak(head, s));
+	if (owner->dead) {
+	  // the owner exited while we were pushing
+	  release_remote(owner);
+	}
+      }
+      owner->put();
+    }
+  }
+
+  void buffer::set_small_raw_pool(bool b) {
+    small_raw_pool::enabled.store(b, std::memory_order_relaxed);
+  }
+
   /*
    * raw_combined is always placed within a single allocation along
    * with the data buffer.  the data goes at the beginning, and
    * raw_combined at the end.
    */
   class buffer::raw_combined : public buffer::raw {
+    // the allocation comes from small_raw_pool
+    bool pooled;
   public:
-    raw_combined(char *dataptr, unsigned l, int mempool)
-      : raw(dataptr, l, mempool) {
+    raw_combined(char *dataptr, unsigned l, int mempool, bool pooled = false)
+      : raw(dataptr, l, mempool), pooled(pooled) {
     }
 
     static ceph::unique_leakable_ptr<buffer::raw>
@@ -103,6 +350,17 @@ static ceph::spinlock debug_lock;
 				  alignof(buffer::raw_combined));
       size_t datalen = round_up_to(len, alignof(buffer::raw_combined));
 
+      if (small_raw_pool::enabled.load(std::memory_order_relaxed) &&
+	  align <= small_raw_pool::header_size &&
+	  small_raw_pool::header_size + datalen + rawlen <=
+	    small_raw_pool::slot_sizes.back()) {
+	if (char *ptr = small_raw_pool::allocate(
+	      small_raw_pool::header_size + datalen + rawlen)) {
+	  return ceph::unique_leakable_ptr<buffer::raw>(
+	    new (ptr + datalen) raw_combined(ptr, len, mempool, true));
+	}
+      }
+
 #ifdef DARWIN
       char *ptr = (char *) valloc(rawlen + datalen);
 #else
@@ -122,9 +380,16 @@ static ceph::spinlock debug_lock;
 
     static void operator delete(void *ptr) {
       raw_combined *raw = (raw_combined *)ptr;
-      aligned_free((void *)raw->data);
+      if (raw->pooled) {
+	small_raw_pool::deallocate(raw->data);
+      } else {
+	aligned_free((void *)raw->data);
+      }
     }
   };
+  // a page worth of data must fit in the largest slot
+  static_assert(small_raw_pool::header_size + CEPH_BUFFER_ALLOC_UNIT +
+		sizeof(buffer::raw_combined) <= small_raw_pool::slot_sizes.back());
 
   class buffer::raw_malloc : public buffer::raw {
   public:
@@ -167,6 +167,7 @@ public:
   const char** get_tracked_conf_keys() const override {
     static const char *KEYS[] = {
       "mempool_debug",
+      "buffer_small_pool",
       NULL
     };
     return KEYS;
@@ -178,6 +179,10 @@ public:
     if (changed.count("mempool_debug")) {
       mempool::set_debug_mode(cct->_conf->mempool_debug);
     }
+    if (changed.count("buffer_small_pool")) {
+      ceph::buffer::set_small_raw_pool(
+	conf.get_val<bool>("buffer_small_pool"));
+    }
   }
 
   // AdminSocketHook
@@ -238,3 +238,9 @@ uint32_t ceph_crc32c_zeros(uint32_t crc, unsigned len)
     crc = ceph_crc32c(crc, nullptr, remainder);
   return crc;
 }
+
+uint32_t ceph_crc32c_combine(uint32_t crc1, uint32_t crc2, unsigned len2)
+{
+  // no final xor: crc32c(B, crc1) = crc32c(0*len(B), crc1) ^ crc32c(B, 0)
+  return ceph_crc32c_zeros(crc1, len2) ^ crc2;
+}
@@ -89,6 +89,76 @@ static __u32 crush_hash32_rjenkins1_5(__u32 a, __u32 b, __u32 c, __u32 d,
 	return hash;
 }
 
+/*
+ * multi-lane variant of crush_hash32_rjenkins1_3() where only @b varies
+ * between lanes.  the mixing function is plain 32-bit add/sub/xor/shift,
+ * so GCC vector extensions map it directly onto SIMD registers.
+ */
+#if !defined(__KERNEL__) && defined(__GNUC__)
+/*
+ * 16 lanes fill one 512-bit register in the avx512f clone; narrower
+ * units split the vector into several registers.  an 8 lane step picks
+ * up what is left of a batch before falling back to scalar.
+ */
+typedef __u32 crush_u32x16 __attribute__((vector_size(64)));
+typedef __u32 crush_u32x8 __attribute__((vector_size(32)));
+
+/* broadcast a scalar to every lane of a vector of type @T */
+#define crush_splat(T, v) ((T){0} + (__u32)(v))
+
+#define crush_hash32_rjenkins1_3_lanes(T, a, b, c, out)			\
+	do {								\
+		T va = crush_splat(T, a), vc = crush_splat(T, c);	\
+		T x = crush_splat(T, 231232), y = crush_splat(T, 1232); \
+		T vb, hash;						\
+		memcpy(&vb, b, sizeof(vb));				\
+		hash = crush_splat(T, crush_hash_seed ^ a ^ c) ^ vb;	\
+		crush_hashmix(va, vb, hash);				\
+		crush_hashmix(vc, x, hash);				\
+		crush_hashmix(y, va, hash);				\
+		crush_hashmix(vb, x, hash);				\
+		crush_hashmix(y, vc, hash);				\
+		memcpy(out, &hash, sizeof(hash));			\
+	} while (0)
+
+/*
+ * let the dynamic loader pick the widest unit the cpu supports; the
+ * generic clone is still vectorized with baseline SSE2.
+ */
+# if defined(__x86_64__) && defined(__linux__) && !defined(__clang__)
+#  define CRUSH_HASH_TARGET_CLONES \
+	__attribute__((target_clones("avx512f", "avx2", "default")))
+# else
+#  define CRUSH_HASH_TARGET_CLONES
+# endif
+
+CRUSH_HASH_TARGET_CLONES
+static void crush_hash32_rjenkins1_3_batch(__u32 a, const __u32 *b, __u32 c,
+					   __u32 *out, unsigned int n)
+{
+	unsigned int i = 0;
+
+	for (; i + 16 <= n; i += 16)
+		crush_hash32_rjenkins1_3_lanes(crush_u32x16, a, b + i, c,
+					       out + i);
+	if (i + 8 <= n) {
+		crush_hash32_rjenkins1_3_lanes(crush_u32x8, a, b + i, c,
+					       out + i);
+		i += 8;
+	}
+	for (; i < n; i++)
+		out[i] = crush_hash32_rjenkins1_3(a, b[i], c);
+}
+#else
+static void crush_hash32_rjenkins1_3_batch(__u32 a, const __u32 *b, __u32 c,
+					   __u32 *out, unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		out[i] = crush_hash32_rjenkins1_3(a, b[i], c);
+}
+#endif
 
 __u32 crush_hash32(int type, __u32 a)
 {
@@ -120,6 +190,18 @@ __u32 crush_hash32_3(int type, __u32 a, __u32 b, __u32 c)
 	}
 }
 
+void crush_hash32_3_batch(int type, __u32 a, const __u32 *b, __u32 c,
+			  __u32 *out, unsigned int n)
+{
+	switch (type) {
+	case CRUSH_HASH_RJENKINS1:
+		crush_hash32_rjenkins1_3_batch(a, b, c, out, n);
+		break;
+	default:
+		memset(out, 0, n * sizeof(*out));
+	}
+}
+
 __u32 crush_hash32_4(int type, __u32 a, __u32 b, __u32 c, __u32 d)
 {
 	switch (type) {
@@ -20,4 +20,13 @@ extern __u32 crush_hash32_4(int type, __u32 a, __u32 b, __u32 c, __u32 d);
 extern __u32 crush_hash32_5(int type, __u32 a, __u32 b, __u32 c, __u32 d,
 			    __u32 e);
 
+/*
+ * hash @n values of @b against a fixed @a and @c, storing the results
+ * in @out.  results are bit-identical to calling crush_hash32_3() on
+ * each element; the point is to let the compiler evaluate several lanes
+ * at once (SSE2/AVX2/AVX-512 where available).
+ */
+extern void crush_hash32_3_batch(int type, __u32 a, const __u32 *b, __u32 c,
+				 __u32 *out, unsigned int n);
+
 #endif
@@ -222,6 +222,40 @@ int ErasureCode::encode(const set<int> &want_to_encode,
   return 0;
 }
 
+int ErasureCode::encode_with_crc(const set<int> &want_to_encode,
+                                 const bufferlist &in,
+                                 map<int, bufferlist> *encoded,
+                                 vector<uint32_t> *crcs)
+{
+  unsigned int k = get_data_chunk_count();
+  unsigned int m = get_chunk_count() - k;
+  ceph_assert(crcs->size() == k + m);
+  int err = encode_prepare(in, *encoded);
+  if (err)
+    return err;
+  err = encode_chunks_with_crc(want_to_encode, encoded, crcs);
+  if (err)
+    return err;
+  for (unsigned int i = 0; i < k + m; i++) {
+    if (want_to_encode.count(i) == 0)
+      encoded->erase(i);
+  }
+  return 0;
+}
+
+int ErasureCode::encode_chunks_with_crc(const set<int> &want_to_encode,
+                                        map<int, bufferlist> *encoded,
+                                        vector<uint32_t> *crcs)
+{
+  int err = encode_chunks(want_to_encode, encoded);
+  if (err)
+    return err;
+  for (auto i : want_to_encode) {
+    (*crcs)[i] = (*encoded)[i].crc32c((*crcs)[i]);
+  }
+  return 0;
+}
+
 int ErasureCode::_decode(const set<int> &want_to_read,
 			 const map<int, bufferlist> &chunks,
 			 map<int, bufferlist> *decoded)
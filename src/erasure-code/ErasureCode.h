@@ -81,6 +81,17 @@ namespace ceph {
                        const bufferlist &in,
                        std::map<int, bufferlist> *encoded) override;
 
+    int encode_with_crc(const std::set<int> &want_to_encode,
+                        const bufferlist &in,
+                        std::map<int, bufferlist> *encoded,
+                        std::vector<uint32_t> *crcs) override;
+
+    // encode_chunks() followed by a crc32c of each wanted chunk; plugins
+    // override it to checksum while the data is still in cache
+    virtual int encode_chunks_with_crc(const std::set<int> &want_to_encode,
+                                       std::map<int, bufferlist> *encoded,
+                                       std::vector<uint32_t> *crcs);
+
     int decode(const std::set<int> &want_to_read,
                 const std::map<int, bufferlist> &chunks,
                 std::map<int, bufferlist> *decoded, int chunk_size) override;
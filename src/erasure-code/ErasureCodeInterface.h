@@ -140,6 +140,7 @@
     chunks with cost 6 + 6 = 12. 
  */ 
 
+#include <cerrno>
 #include <map>
 #include <set>
 #include <vector>
@@ -370,6 +371,34 @@ namespace ceph {
     virtual int encode_chunks(const std::set<int> &want_to_encode,
                               std::map<int, bufferlist> *encoded) = 0;
 
+    /**
+     * Same as **encode** but also fold every chunk listed in
+     * **want_to_encode** into the running crc32c found at the same
+     * index of **crcs**, i.e. crcs[i] = crc32c(crcs[i], chunk i).
+     *
+     * Implementations may interleave checksumming with the parity
+     * computation so that each piece of the stripe is checksummed
+     * while it is still in cache, instead of reading the encoded
+     * chunks again afterwards.
+     *
+     * This method is optional. The default implementation returns
+     * -EOPNOTSUPP and touches neither **encoded** nor **crcs**, in
+     * which case the caller is expected to use **encode** and
+     * checksum the chunks itself.
+     *
+     * @param [in] want_to_encode chunk indexes to be encoded
+     * @param [in] in data to be encoded
+     * @param [out] encoded map chunk indexes to chunk data
+     * @param [in,out] crcs get_chunk_count() running crc32c values
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int encode_with_crc(const std::set<int> &want_to_encode,
+                                const bufferlist &in,
+                                std::map<int, bufferlist> *encoded,
+                                std::vector<uint32_t> *crcs) {
+      return -EOPNOTSUPP;
+    }
+
     /**
      * Decode the **chunks** and store at least **want_to_read**
      * chunks in **decoded**.
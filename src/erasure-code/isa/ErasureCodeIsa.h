@@ -76,6 +76,10 @@ public:
   int encode_chunks(const std::set<int> &want_to_encode,
                     std::map<int, ceph::buffer::list> *encoded) override;
 
+  int encode_chunks_with_crc(const std::set<int> &want_to_encode,
+                             std::map<int, ceph::buffer::list> *encoded,
+                             std::vector<uint32_t> *crcs) override;
+
   int decode_chunks(const std::set<int> &want_to_read,
                             const std::map<int, ceph::buffer::list> &chunks,
                             std::map<int, ceph::buffer::list> *decoded) override;
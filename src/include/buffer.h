@@ -118,6 +118,8 @@ struct error_code;
   int get_missed_crc();
   /// enable/disable tracking of cached crcs
   void track_cached_crc(bool b);
+  /// enable/disable the per-thread pool backing small buffers
+  void set_small_raw_pool(bool b);
 
   /*
    * an abstract raw buffer.  with a reference count.
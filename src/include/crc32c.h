@@ -30,6 +30,19 @@ extern ceph_crc32c_func_t ceph_choose_crc32(void);
  */
 uint32_t ceph_crc32c_zeros(uint32_t crc, unsigned length);
 
+/**
+ * combine the crc32c of two adjacent buffers
+ *
+ * Given crc1 = crc32c(A, seed) and crc2 = crc32c(B, 0), returns
+ * crc32c(A followed by B, seed).  This lets the pieces of a buffer be
+ * checksummed independently (or in any order) and stitched afterwards.
+ *
+ * @param crc1 crc of the first buffer, with any initial value
+ * @param crc2 crc of the second buffer, with initial value 0
+ * @param len2 length of the second buffer
+ */
+uint32_t ceph_crc32c_combine(uint32_t crc1, uint32_t crc2, unsigned len2);
+
 /**
  * calculate crc32c
  *
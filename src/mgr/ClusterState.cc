@@ -89,9 +89,9 @@ void ClusterState::ingest_pgstats(ref_t<MPGStats> stats)
     pending_inc.update_stat(from, std::move(empty_stat));  
   }
 
-  for (auto p : stats->pg_stat) {
+  for (auto& p : stats->pg_stat) {
     pg_t pgid = p.first;
-    const auto &pg_stats = p.second;
+    auto &pg_stats = p.second;
 
     // In case we're hearing about a PG that according to last
     // OSDMap update should not exist
@@ -124,8 +124,17 @@ void ClusterState::ingest_pgstats(ref_t<MPGStats> stats)
 	       << q->second.reported_seq << dendl;
       continue;
     }
+    // OSDs resend every primary PG on each report, but only bump the
+    // version pair when the published stats change.  Skip the ones we
+    // already have (unless we marked them stale in the meantime) so
+    // apply_incremental only touches PGs that changed.
+    if (q != pg_map.pg_stat.end() &&
+	q->second.get_version_pair() == pg_stats.get_version_pair() &&
+	q->second.state == pg_stats.state) {
+      continue;
+    }
 
-    pending_inc.pg_stat_updates[pgid] = pg_stats;
+    pending_inc.pg_stat_updates[pgid] = std::move(pg_stats);
   }
   for (auto p : stats->pool_stat) {
     pending_inc.pool_statfs_updates[std::make_pair(p.first, from)] = p.second;
@@ -788,6 +788,7 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
     dout(7) << __func__ << " loading latest full map e" << latest_full << dendl;
     osdmap = OSDMap();
     osdmap.decode(latest_bl);
+    mapping.mark_all_dirty(osdmap.get_epoch());
   }
 
   bufferlist bl;
@@ -826,6 +827,7 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
     dout(7) << "update_from_paxos  applying incremental " << osdmap.epoch+1
 	    << dendl;
     OSDMap::Incremental inc(inc_bl);
+    mapping.note_incremental(osdmap, inc);
     err = osdmap.apply_incremental(inc);
     ceph_assert(err == 0);
 
@@ -875,6 +877,7 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
 
 	osdmap = OSDMap();
 	osdmap.decode(orig_full_bl);
+	mapping.mark_all_dirty(osdmap.get_epoch());
 
 	dout(20) << __func__ << " canonical full osdmap:\n";
 	JSONFormatter jf(true);
@@ -1071,6 +1074,9 @@ void OSDMonitor::start_mapping()
   }
   if (!osdmap.get_pools().empty()) {
     auto fin = new C_UpdateCreatingPGs(this, osdmap.get_epoch());
+    if (!g_conf().get_val<bool>("mon_osd_mapping_incremental")) {
+      mapping.mark_all_dirty(osdmap.get_epoch());
+    }
     mapping_job = mapping.start_update(osdmap, mapper,
 				       g_conf()->mon_osd_mapping_pgs_per_chunk);
     dout(10) << __func__ << " started mapping job " << mapping_job.get()
@@ -1136,12 +1136,26 @@ void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
     pool_stat_t &pool_sum_ref = pg_pool_sum[update_pool];
     if (pg_stat_iter == pg_stat.end()) {
       pg_stat.insert(make_pair(update_pg, update_stat));
+      purged_snaps_dirty.insert(update_pool);
+      stat_pg_add(update_pg, update_stat);
     } else {
-      stat_pg_sub(update_pg, pg_stat_iter->second);
-      pool_sum_ref.sub(pg_stat_iter->second);
-      pg_stat_iter->second = update_stat;
+      pg_stat_t &cur_stat = pg_stat_iter->second;
+      // most updates only move counters; leave the per-osd indexes
+      // alone unless the mapping or blockers actually changed
+      bool sameosds =
+	cur_stat.acting == update_stat.acting &&
+	cur_stat.up == update_stat.up &&
+	cur_stat.up_primary == update_stat.up_primary &&
+	cur_stat.blocked_by == update_stat.blocked_by;
+      if ((cur_stat.state == 0) != (update_stat.state == 0) ||
+	  cur_stat.purged_snaps != update_stat.purged_snaps) {
+	purged_snaps_dirty.insert(update_pool);
+      }
+      stat_pg_sub(update_pg, cur_stat, sameosds);
+      pool_sum_ref.sub(cur_stat);
+      cur_stat = update_stat;
+      stat_pg_add(update_pg, update_stat, sameosds);
     }
-    stat_pg_add(update_pg, update_stat);
     pool_sum_ref.add(update_stat);
   }
 
@@ -1198,6 +1212,7 @@ void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
       }
 
       pg_stat.erase(s);
+      purged_snaps_dirty.insert(removed_pg.pool());
       if (pool_erased) {
         deleted_pools.insert(removed_pg.pool());
       }
@@ -1272,6 +1287,7 @@ void PGMap::calc_stats()
   num_pg_by_state.clear();
   num_pg_by_pool_state.clear();
   num_pg_by_osd.clear();
+  purged_snaps_all_dirty = true;
 
   for (auto p = pg_stat.begin();
        p != pg_stat.end();
@@ -1429,9 +1445,23 @@ bool PGMap::stat_pg_sub(const pg_t &pgid, const pg_stat_t &s,
 
 void PGMap::calc_purged_snaps()
 {
-  purged_snaps.clear();
+  // only pools that saw a pg come, go, change its purged_snaps or
+  // enter/leave the unknown state need another pass over their pgs
+  if (purged_snaps_all_dirty) {
+    purged_snaps.clear();
+  } else if (purged_snaps_dirty.empty()) {
+    return;
+  } else {
+    for (auto pool : purged_snaps_dirty) {
+      purged_snaps.erase(pool);
+    }
+  }
   set<int64_t> unknown;
   for (auto& i : pg_stat) {
+    if (!purged_snaps_all_dirty &&
+	purged_snaps_dirty.count(i.first.pool()) == 0) {
+      continue;
+    }
     if (i.second.state == 0) {
       unknown.insert(i.first.pool());
       purged_snaps.erase(i.first.pool());
@@ -1447,6 +1477,8 @@ void PGMap::calc_purged_snaps()
       j->second.intersection_of(i.second.purged_snaps);
     }
   }
+  purged_snaps_dirty.clear();
+  purged_snaps_all_dirty = false;
 }
 
 void PGMap::calc_osd_sum_by_class(const OSDMap& osdmap)
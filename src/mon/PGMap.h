@@ -319,6 +319,10 @@ public:
   mempool::pgmap::list<std::pair<pool_stat_t, utime_t> > pg_sum_deltas;
   mempool::pgmap::unordered_map<int64_t,mempool::pgmap::unordered_map<uint64_t,int32_t>> num_pg_by_pool_state;
 
+  // pools whose purged_snaps calc_purged_snaps() must redo (soft state)
+  mempool::pgmap::set<int64_t> purged_snaps_dirty;
+  bool purged_snaps_all_dirty = true;
+
   utime_t stamp;
 
   void update_pool_deltas(
@@ -337,6 +341,8 @@ public:
     }
 
     pg_pool_sum.erase(pool);
+    purged_snaps.erase(pool);
+    purged_snaps_dirty.erase(pool);
     num_pg_by_pool_state.erase(pool);
     num_pg_by_pool.erase(pool);
     per_pool_sum_deltas.erase(pool);
@@ -335,6 +335,10 @@ ssize_t AsyncConnection::_try_send(bool more)
   if (likely(!inject_network_congestion())) {
     r = cs.send(outgoing_bl, more);
   }
+  if (r > 0 && outgoing_frames) {
+    logger->hinc(l_msgr_send_frames_histogram, outgoing_frames, r);
+    outgoing_frames = 0;
+  }
   if (r < 0) {
     ldout(async_msgr->cct, 1) << __func__ << " send error: " << cpp_strerror(r) << dendl;
     return r;
@@ -381,6 +385,12 @@ void AsyncConnection::process() {
 
   ldout(async_msgr->cct, 20) << __func__ << dendl;
 
+  // zerocopy send completions arrive as EPOLLERR on the socket and keep
+  // firing until they are read, whatever state the protocol is in.
+  if (cs) {
+    cs.reap_send_completions();
+  }
+
   switch (state) {
     case STATE_NONE: {
       ldout(async_msgr->cct, 20) << __func__ << " enter none state" << dendl;
@@ -618,6 +628,7 @@ void AsyncConnection::fault()
   recv_start = recv_end = 0;
   state_offset = 0;
   outgoing_bl.clear();
+  outgoing_frames = 0;
 }
 
 void AsyncConnection::_stop() {
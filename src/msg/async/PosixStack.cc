@@ -19,8 +19,12 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
 #include <algorithm>
+#include <deque>
 
 #include "PosixStack.h"
 
@@ -37,16 +41,163 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "PosixStack "
 
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define MSGR_HAVE_ZEROCOPY 1
+#endif
+
+#ifdef MSGR_HAVE_ZEROCOPY
+// Bytes handed to the kernel with MSG_ZEROCOPY.  The kernel transmits
+// straight out of these pages, so we must pin them until every sendmsg()
+// that covered them has been reported done on the socket error queue.
+class ZerocopyPending {
+  struct send_t {
+    uint32_t first_id;     ///< id of the first sendmsg() covering these bytes
+    uint32_t last_id;      ///< id of the last one
+    uint32_t outstanding;  ///< ids in [first_id, last_id] not reported yet
+    ceph::buffer::list bl;
+    ceph::mono_clock::time_point stamp;
+  };
+  uint32_t next_id = 0;  ///< mirrors the kernel's per-socket counter
+  std::deque<send_t> sends;
+
+  // the kernel reports each id exactly once, but possibly out of order
+  // and merged with its neighbours into [lo, hi]
+  void complete(uint32_t lo, uint32_t hi, bool copied) {
+    auto now = ceph::mono_clock::now();
+    // ids are compared relative to lo, so counter wraparound is harmless
+    const int64_t end = static_cast<int32_t>(hi - lo);
+    std::erase_if(sends, [&](send_t &p) {
+      const int64_t first = static_cast<int32_t>(p.first_id - lo);
+      const int64_t last = static_cast<int32_t>(p.last_id - lo);
+      const int64_t n = std::min(last, end) - std::max<int64_t>(first, 0) + 1;
+      if (n <= 0) {
+        return false;
+      }
+      ceph_assert(n <= p.outstanding);
+      p.outstanding -= n;
+      if (p.outstanding) {
+        return false;
+      }
+      if (logger) {
+        logger->inc(copied ? l_msgr_send_zerocopy_copied_bytes :
+                             l_msgr_send_zerocopy_bytes, p.bl.length());
+        logger->tinc(l_msgr_send_zerocopy_lat, now - p.stamp);
+      }
+      return true;
+    });
+  }
+
+ public:
+  PerfCounters *logger = nullptr;
+
+  bool empty() const {
+    return sends.empty();
+  }
+
+  void hold(ceph::buffer::list &&bl, unsigned calls) {
+    sends.push_back(send_t{next_id, next_id + calls - 1, calls,
+                           std::move(bl), ceph::mono_clock::now()});
+    next_id += calls;
+  }
+
+  // read the zerocopy notifications off the error queue of fd and release
+  // the bytes they cover.  each notification covers the range of sendmsg()
+  // ids [ee_info, ee_data].
+  // @return true if the kernel had to copy any of them after all
+  bool reap(int fd) {
+    bool copied = false;
+    while (!sends.empty()) {
+      struct msghdr msg;
+      char control[CMSG_SPACE(sizeof(struct sock_extended_err)) * 4];
+      // FIPS zeroization audit 20191115: this memset is not security related.
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (::recvmsg(fd, &msg, MSG_ERRQUEUE) < 0) {
+        // EAGAIN: the error queue is empty
+        break;
+      }
+      for (auto cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+            !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+          continue;
+        }
+        auto serr = reinterpret_cast<const struct sock_extended_err*>(
+          CMSG_DATA(cm));
+        if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+          continue;
+        }
+        bool c = serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED;
+        complete(serr->ee_info, serr->ee_data, c);
+        copied |= c;
+      }
+    }
+    return copied;
+  }
+};
+
+// Owns the fd of a closed socket whose zerocopy sends are still in flight:
+// their completions only ever arrive on that fd's error queue, and the
+// kernel keeps transmitting queued data after close().  Polls until they
+// are all in, or until the peer has stopped acking for too long.
+class ZerocopyReaper : public EventCallback {
+  static constexpr uint64_t poll_us = 10000;
+  static constexpr auto max_linger = std::chrono::seconds(30);
+
+  EventCenter *center;
+  int fd;
+  ZerocopyPending pending;
+  ceph::mono_clock::time_point deadline;
+
+ public:
+  ZerocopyReaper(EventCenter *c, int fd, ZerocopyPending &&p)
+    : center(c), fd(fd), pending(std::move(p)),
+      deadline(ceph::mono_clock::now() + max_linger) {}
+
+  void do_request(uint64_t) override {
+    pending.reap(fd);
+    if (pending.empty() || ceph::mono_clock::now() > deadline) {
+      compat_closesocket(fd);
+      delete this;
+      return;
+    }
+    center->create_time_event(poll_us, this);
+  }
+};
+#endif
+
 class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   ceph::NetHandler &handler;
   int _fd;
   entity_addr_t sa;
   bool connected;
 
+#ifdef MSGR_HAVE_ZEROCOPY
+  EventCenter *center = nullptr;
+  uint64_t zerocopy_min_bytes = 0;  ///< 0 means zerocopy is off
+  ZerocopyPending zerocopy_pending;
+#endif
+
  public:
   explicit PosixConnectedSocketImpl(ceph::NetHandler &h, const entity_addr_t &sa,
-				    int f, bool connected)
-      : handler(h), _fd(f), sa(sa), connected(connected) {}
+				    int f, bool connected, Worker *w = nullptr)
+      : handler(h), _fd(f), sa(sa), connected(connected) {
+#ifdef MSGR_HAVE_ZEROCOPY
+    if (w && w->cct->_conf.get_val<bool>("ms_async_zerocopy")) {
+      center = &w->center;
+      zerocopy_pending.logger = w->get_perf_counter();
+      int one = 1;
+      if (::setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0) {
+        zerocopy_min_bytes =
+          w->cct->_conf.get_val<Option::size_t>("ms_async_zerocopy_min_bytes");
+      } else {
+        int r = -ceph_sock_errno();
+        ldout(w->cct, 1) << __func__ << " SO_ZEROCOPY not supported on fd "
+                         << _fd << ": " << cpp_strerror(r) << dendl;
+      }
+    }
+#endif
+  }
 
   int is_connected() override {
     if (connected)
@@ -77,23 +228,38 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   // return the sent length
   // < 0 means error occurred
   #ifndef _WIN32
-  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more)
+  //
+  // if zerocopy_calls is given, send with MSG_ZEROCOPY and count the
+  // sendmsg() calls which consumed a zerocopy notification id.
+  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more,
+                            unsigned *zerocopy_calls = nullptr)
   {
     size_t sent = 0;
+    int zerocopy_flag = 0;
+#ifdef MSGR_HAVE_ZEROCOPY
+    if (zerocopy_calls)
+      zerocopy_flag = MSG_ZEROCOPY;
+#endif
     while (1) {
       MSGR_SIGPIPE_STOPPER;
       ssize_t r;
-      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0) | zerocopy_flag);
       if (r < 0) {
         int err = ceph_sock_errno();
         if (err == EINTR) {
           continue;
         } else if (err == EAGAIN) {
           break;
+        } else if (err == ENOBUFS && zerocopy_flag) {
+          // out of optmem for pinning pages; copy the rest
+          zerocopy_flag = 0;
+          continue;
         }
         return -err;
       }
 
+      if (zerocopy_flag)
+        ++*zerocopy_calls;
       sent += r;
       if (len == sent) break;
 
@@ -115,6 +281,12 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 
   ssize_t send(ceph::buffer::list &bl, bool more) override {
     size_t sent_bytes = 0;
+    unsigned zerocopy_calls = 0;
+    bool zerocopy = false;
+#ifdef MSGR_HAVE_ZEROCOPY
+    reap_send_completions();
+    zerocopy = zerocopy_min_bytes && bl.length() >= zerocopy_min_bytes;
+#endif
     auto pb = std::cbegin(bl.buffers());
     uint64_t left_pbrs = bl.get_num_buffers();
     while (left_pbrs) {
@@ -133,7 +305,8 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 	msglen += pb->length();
 	++pb;
       }
-      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
+      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more,
+                             zerocopy ? &zerocopy_calls : nullptr);
       if (r < 0)
         return r;
 
@@ -150,8 +323,15 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
         bl.splice(sent_bytes, bl.length()-sent_bytes, &swapped);
         bl.swap(swapped);
       } else {
-        bl.clear();
+        swapped.swap(bl);
+      }
+#ifdef MSGR_HAVE_ZEROCOPY
+      // swapped now holds the bytes we sent.  the kernel may still be
+      // reading them if any went out with MSG_ZEROCOPY
+      if (zerocopy_calls) {
+        zerocopy_pending.hold(std::move(swapped), zerocopy_calls);
       }
+#endif
     }
 
     return static_cast<ssize_t>(sent_bytes);
@@ -204,6 +384,17 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     ::shutdown(_fd, SHUT_RDWR);
   }
   void close() override {
+#ifdef MSGR_HAVE_ZEROCOPY
+    reap_send_completions();
+    if (!zerocopy_pending.empty()) {
+      // keep the pins, and the fd their completions arrive on, until the
+      // kernel is done sending from them
+      center->dispatch_event_external(
+        new ZerocopyReaper(center, _fd, std::move(zerocopy_pending)));
+      zerocopy_pending = ZerocopyPending();
+      return;
+    }
+#endif
     compat_closesocket(_fd);
   }
   void set_priority(int sd, int prio, int domain) override {
@@ -212,6 +403,16 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   int fd() const override {
     return _fd;
   }
+#ifdef MSGR_HAVE_ZEROCOPY
+  void reap_send_completions() override {
+    if (zerocopy_pending.reap(_fd)) {
+      // the kernel could not avoid the copy for this route (e.g. loopback
+      // or a device without scatter-gather); stop paying for the
+      // notifications on this socket.
+      zerocopy_min_bytes = 0;
+    }
+  }
+#endif
   friend class PosixServerSocketImpl;
   friend class PosixNetworkStack;
 };
@@ -262,7 +463,7 @@ int PosixServerSocketImpl::accept(ConnectedSocket *sock, const SocketOptions &op
   out->set_sockaddr((sockaddr*)&ss);
   handler.set_priority(sd, opt.priority, out->get_family());
 
-  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true));
+  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true, w));
   *sock = ConnectedSocket(std::move(csi));
   return 0;
 }
@@ -331,7 +532,7 @@ int PosixWorker::connect(const entity_addr_t &addr, const SocketOptions &opts, C
 
   net.set_priority(sd, opts.priority, addr.get_family());
   *socket = ConnectedSocket(
-      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock)));
+      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock, this)));
   return 0;
 }
 
@@ -101,7 +101,11 @@ ProtocolV2::ProtocolV2(AsyncConnection *connection)
       rx_frame_asm(&session_stream_handlers, false, cct->_conf->ms_crc_data,
                    &session_compression_handlers),
       next_tag(static_cast<Tag>(0)),
-      keepalive(false) {
+      keepalive(false),
+      send_batch_bytes(
+        cct->_conf.get_val<Option::size_t>("ms_async_send_batch_bytes")),
+      send_batch_max_delay(std::chrono::microseconds(
+        cct->_conf.get_val<uint64_t>("ms_async_send_batch_max_delay_us"))) {
 }
 
 ProtocolV2::~ProtocolV2() {
@@ -154,6 +158,7 @@ void ProtocolV2::reset_session() {
   connection->dispatch_queue->discard_queue(connection->conn_id);
   discard_out_queue();
   connection->outgoing_bl.clear();
+  connection->outgoing_frames = 0;
 
   connection->dispatch_queue->queue_remote_reset(connection);
 
@@ -543,6 +548,10 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
 			     m->get_payload(),
 			     m->get_middle(),
 			     m->get_data());
+  const auto batched_bytes = connection->outgoing_bl.length();
+  if (batched_bytes == 0) {
+    send_batch_start = ceph::mono_clock::now();
+  }
   if (!append_frame(message)) {
     m->put();
     return -EILSEQ;
@@ -556,13 +565,30 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
                  << " src=" << entity_name_t(messenger->get_myname())
                  << " off=" << header2.data_off
                  << dendl;
+  if (more && send_batch_bytes &&
+      connection->outgoing_bl.length() < send_batch_bytes &&
+      ceph::mono_clock::now() - send_batch_start < send_batch_max_delay) {
+    // leave it to the next message, or to write_event(), to flush
+    const auto queued_bytes = connection->outgoing_bl.length() - batched_bytes;
+    connection->logger->inc(l_msgr_send_bytes, queued_bytes);
+    if (session_stream_handlers.tx) {
+      connection->logger->inc(l_msgr_send_encrypted_bytes, queued_bytes);
+    }
+    ldout(cct, 10) << __func__ << " batching " << m << ", "
+                   << connection->outgoing_bl.length()
+                   << " bytes pending" << dendl;
+    m->put();
+    return 0;
+  }
   ssize_t total_send_size = connection->outgoing_bl.length();
   ssize_t rc = connection->_try_send(more);
   if (rc < 0) {
     ldout(cct, 1) << __func__ << " error sending " << m << ", "
                   << cpp_strerror(rc) << dendl;
   } else {
-    const auto sent_bytes = total_send_size - connection->outgoing_bl.length();
+    // frames batched earlier were accounted for when they were queued
+    const auto sent_bytes = std::max<ssize_t>(
+      0, total_send_size - connection->outgoing_bl.length() - batched_bytes);
     connection->logger->inc(l_msgr_send_bytes, sent_bytes);
     if (session_stream_handlers.tx) {
       connection->logger->inc(l_msgr_send_encrypted_bytes, sent_bytes);
@@ -595,6 +621,7 @@ bool ProtocolV2::append_frame(F& frame) {
   ldout(cct, 25) << __func__ << " assembled frame " << bl.length()
                  << " bytes " << tx_frame_asm << dendl;
   connection->outgoing_bl.claim_append(bl);
+  connection->outgoing_frames++;
   return true;
 }
 
@@ -655,14 +682,12 @@ void ProtocolV2::write_event() {
 
     auto start = ceph::mono_clock::now();
     bool more;
-    do {
-      if (connection->is_queued()) {
-	if (r = connection->_try_send(); r!= 0) {
-	  // either fails to send or not all queued buffer is sent
-	  break;
-	}
-      }
-
+    // flush what is left over from before; once we are past this point
+    // outgoing_bl only holds frames batched by write_message()
+    if (connection->is_queued()) {
+      r = connection->_try_send();
+    }
+    while (r == 0 && can_write) {
       const auto out_entry = _get_next_outgoing();
       if (!out_entry.m) {
         break;
@@ -700,7 +725,7 @@ void ProtocolV2::write_event() {
 	// when the outbound socket is writeable again
         break;
       }
-    } while (can_write);
+    }
     write_in_progress = false;
 
     // if r > 0 mean data still lefted, so no need _try_send.
@@ -2794,6 +2819,7 @@ CtPtr ProtocolV2::reuse_connection(const AsyncConnectionRef& existing,
           // From performance point of view it should be fine – this happens
           // far away from hot paths.
           existing->outgoing_bl.clear();
+          existing->outgoing_frames = 0;
           existing->open_write = false;
           exproto->session_stream_handlers = std::move(temp_stream_handlers);
           exproto->session_compression_handlers = std::move(temp_compression_handlers);
@@ -122,6 +122,14 @@ private:
   bool keepalive;
   bool write_in_progress = false;
 
+  // Frames queued within one write_event() are gathered in outgoing_bl
+  // and handed to the socket together, once send_batch_bytes are pending,
+  // the first of them has waited send_batch_max_delay, or the queue runs
+  // dry.  send_batch_bytes == 0 sends every message on its own.
+  const uint64_t send_batch_bytes;
+  const ceph::timespan send_batch_max_delay;
+  ceph::mono_time send_batch_start;
+
   CompConnectionMeta comp_meta;
   std::ostream& _conn_prefix(std::ostream *_dout);
   void run_continuation(Ct<ProtocolV2> *pcontinuation);
@@ -35,6 +35,7 @@ class ConnectedSocketImpl {
   virtual void close() = 0;
   virtual int fd() const = 0;
   virtual void set_priority(int sd, int prio, int domain) = 0;
+  virtual void reap_send_completions() {}
 };
 
 class ConnectedSocket;
@@ -130,6 +131,14 @@ class ConnectedSocket {
     _csi->set_priority(sd, prio, domain);
   }
 
+  /// Release buffers whose asynchronous (zerocopy) transmission completed.
+  ///
+  /// Must be called from the owning worker whenever the socket is polled,
+  /// since completions are signalled as socket errors.
+  void reap_send_completions() {
+    _csi->reap_send_completions();
+  }
+
   explicit operator bool() const {
     return _csi.get();
   }
@@ -213,6 +222,12 @@ enum {
   l_msgr_recv_encrypted_bytes,
   l_msgr_send_encrypted_bytes,
 
+  l_msgr_send_zerocopy_bytes,
+  l_msgr_send_zerocopy_copied_bytes,
+  l_msgr_send_zerocopy_lat,
+
+  l_msgr_send_frames_histogram,
+
   l_msgr_last,
 };
 
@@ -271,6 +286,29 @@ class Worker {
     plb.add_u64_counter(l_msgr_recv_encrypted_bytes, "msgr_recv_encrypted_bytes", "Network received encrypted bytes", NULL, 0, unit_t(UNIT_BYTES));
     plb.add_u64_counter(l_msgr_send_encrypted_bytes, "msgr_send_encrypted_bytes", "Network sent encrypted bytes", NULL, 0, unit_t(UNIT_BYTES));
 
+    plb.add_u64_counter(l_msgr_send_zerocopy_bytes, "msgr_send_zerocopy_bytes", "Network bytes sent without copy (MSG_ZEROCOPY)", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_msgr_send_zerocopy_copied_bytes, "msgr_send_zerocopy_copied_bytes", "Network bytes sent with MSG_ZEROCOPY which the kernel copied anyway", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_time_avg(l_msgr_send_zerocopy_lat, "msgr_send_zerocopy_lat", "Latency from zerocopy send to buffer release");
+
+    PerfHistogramCommon::axis_config_d frames_axis_config{
+      "Frames per send",
+      PerfHistogramCommon::SCALE_LINEAR, ///< Frame count in linear scale
+      0,                                 ///< Start at 0
+      1,                                 ///< Quantization unit is 1 frame
+      34,                                ///< Up to 32 and more
+    };
+    PerfHistogramCommon::axis_config_d bytes_axis_config{
+      "Bytes sent",
+      PerfHistogramCommon::SCALE_LOG2,   ///< Size in logarithmic scale
+      0,                                 ///< Start at 0
+      512,                               ///< Quantization unit is 512 bytes
+      16,                                ///< Up to >8M
+    };
+    plb.add_u64_counter_histogram(
+      l_msgr_send_frames_histogram, "msgr_send_frames_histogram",
+      frames_axis_config, bytes_axis_config,
+      "Histogram of msgr2 frames vs bytes handed to the socket per send");
+
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
 
@@ -18,6 +18,9 @@ static constexpr const std::size_t AESGCM_KEY_LEN{16};
 static constexpr const std::size_t AESGCM_IV_LEN{12};
 static constexpr const std::size_t AESGCM_TAG_LEN{16};
 static constexpr const std::size_t AESGCM_BLOCK_LEN{16};
+// plaintext fragments shorter than this are copied into the output buffer
+// and encrypted there together with their neighbours
+static constexpr const std::size_t AESGCM_COALESCE_MAX{1024};
 
 struct nonce_t {
   ceph_le32 fixed;
@@ -44,6 +47,27 @@ class AES128GCM_OnWireTxHandler : public ceph::crypto::onwire::TxHandler {
   bool new_nonce_format;  // 64-bit counter?
   static_assert(sizeof(nonce) == AESGCM_IV_LEN);
 
+  // Small fragments (preamble, encoded headers, padding, epilogue, the
+  // many tiny ptrs of an encoded message front) would otherwise cost one
+  // EVP call each.  They are staged in the output buffer, which is
+  // reserved in one piece by reset_tx_handler(), and encrypted in place
+  // as a single run once a large fragment or the final step comes.
+  unsigned char* run = nullptr;
+  std::size_t run_len = 0;
+
+  unsigned char* stage(ceph::bufferlist::contiguous_filler& filler,
+                       std::size_t len) {
+    auto out = reinterpret_cast<unsigned char*>(filler.c_str());
+    if (run_len == 0) {
+      run = out;
+    }
+    ceph_assert(run + run_len == out);
+    run_len += len;
+    filler.advance(len);
+    return out;
+  }
+  void encrypt_run();
+
 public:
   AES128GCM_OnWireTxHandler(CephContext* const cct,
 			    const key_t& key,
@@ -75,9 +99,25 @@ public:
   void reset_tx_handler(const uint32_t* first, const uint32_t* last) override;
 
   void authenticated_encrypt_update(const ceph::bufferlist& plaintext) override;
+  void authenticated_encrypt_update_zeros(std::uint32_t len) override;
   ceph::bufferlist authenticated_encrypt_final() override;
 };
 
+void AES128GCM_OnWireTxHandler::encrypt_run()
+{
+  if (run_len == 0) {
+    return;
+  }
+  int update_len = 0;
+  if(1 != EVP_EncryptUpdate(ectx.get(), run, &update_len, run, run_len)) {
+    throw std::runtime_error("EVP_EncryptUpdate failed");
+  }
+  ceph_assert_always(update_len >= 0);
+  ceph_assert(static_cast<std::size_t>(update_len) == run_len);
+  run = nullptr;
+  run_len = 0;
+}
+
 void AES128GCM_OnWireTxHandler::reset_tx_handler(const uint32_t* first,
                                                  const uint32_t* last)
 {
@@ -94,6 +134,8 @@ void AES128GCM_OnWireTxHandler::reset_tx_handler(const uint32_t* first,
   }
 
   ceph_assert(buffer.get_append_buffer_unused_tail_length() == 0);
+  run = nullptr;
+  run_len = 0;
   buffer.reserve(std::accumulate(first, last, AESGCM_TAG_LEN));
 
   if (!new_nonce_format) {
@@ -113,8 +155,14 @@ void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
   auto filler = buffer.append_hole(plaintext.length());
 
   for (const auto& plainbuf : plaintext.buffers()) {
-    int update_len = 0;
+    if (plainbuf.length() < AESGCM_COALESCE_MAX) {
+      ::memcpy(stage(filler, plainbuf.length()), plainbuf.c_str(),
+               plainbuf.length());
+      continue;
+    }
+    encrypt_run();
 
+    int update_len = 0;
     if(1 != EVP_EncryptUpdate(ectx.get(),
 	reinterpret_cast<unsigned char*>(filler.c_str()),
 	&update_len,
@@ -133,8 +181,19 @@ void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
 		 << dendl;
 }
 
+void AES128GCM_OnWireTxHandler::authenticated_encrypt_update_zeros(
+  std::uint32_t len)
+{
+  ceph_assert(buffer.get_append_buffer_unused_tail_length() >= len);
+  auto filler = buffer.append_hole(len);
+  // FIPS zeroization audit 20191115: this memset is not security related.
+  ::memset(stage(filler, len), 0, len);
+}
+
 ceph::bufferlist AES128GCM_OnWireTxHandler::authenticated_encrypt_final()
 {
+  encrypt_run();
+
   int final_len = 0;
   ceph_assert(buffer.get_append_buffer_unused_tail_length() ==
               AESGCM_BLOCK_LEN);
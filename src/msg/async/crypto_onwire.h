@@ -83,6 +83,10 @@ struct TxHandler {
   virtual void authenticated_encrypt_update(
     const ceph::bufferlist& plaintext) = 0;
 
+  // Same as above for len zero bytes of plaintext. Used to pad segments
+  // to the cipher block size without growing the caller's bufferlists.
+  virtual void authenticated_encrypt_update_zeros(std::uint32_t len) = 0;
+
   // Generates authentication signature and returns bufferlist crafted
   // basing on plaintext from preceding call to _update().
   virtual ceph::bufferlist authenticated_encrypt_final() = 0;
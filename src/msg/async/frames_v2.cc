@@ -134,7 +134,7 @@ bufferlist FrameAssembler::asm_secure_rev0(const preamble_block_t& preamble,
   uint32_t onwire_lens[MAX_NUM_SEGMENTS + 2];
   onwire_lens[0] = preamble_bl.length();
   for (size_t i = 0; i < m_descs.size(); i++) {
-    onwire_lens[i + 1] = segment_bls[i].length();  // already padded
+    onwire_lens[i + 1] = get_segment_padded_len(i);
   }
   onwire_lens[m_descs.size() + 1] = epilogue_bl.length();
   m_crypto->tx->reset_tx_handler(onwire_lens,
@@ -144,6 +144,10 @@ bufferlist FrameAssembler::asm_secure_rev0(const preamble_block_t& preamble,
     if (segment_bls[i].length() > 0) {
       m_crypto->tx->authenticated_encrypt_update(segment_bls[i]);
     }
+    if (onwire_lens[i + 1] > segment_bls[i].length()) {
+      m_crypto->tx->authenticated_encrypt_update_zeros(
+        onwire_lens[i + 1] - segment_bls[i].length());
+    }
   }
   m_crypto->tx->authenticated_encrypt_update(epilogue_bl);
   return m_crypto->tx->authenticated_encrypt_final();
@@ -184,6 +188,8 @@ bufferlist FrameAssembler::asm_crc_rev1(const preamble_block_t& preamble,
 bufferlist FrameAssembler::asm_secure_rev1(const preamble_block_t& preamble,
                                            bufferlist segment_bls[]) const {
   bufferlist preamble_bl;
+  // segments are padded on the fly, see assemble_frame()
+  uint32_t seg0_pad_len = get_segment_padded_len(0) - segment_bls[0].length();
   if (segment_bls[0].length() > FRAME_PREAMBLE_INLINE_SIZE) {
     // first segment is partially inlined, inline buffer is full
     preamble_bl.reserve(sizeof(preamble));
@@ -207,8 +213,11 @@ bufferlist FrameAssembler::asm_secure_rev1(const preamble_block_t& preamble,
   auto frame_bl = m_crypto->tx->authenticated_encrypt_final();
 
   if (segment_bls[0].length() > 0) {
-    m_crypto->tx->reset_tx_handler({segment_bls[0].length()});
+    m_crypto->tx->reset_tx_handler({segment_bls[0].length() + seg0_pad_len});
     m_crypto->tx->authenticated_encrypt_update(segment_bls[0]);
+    if (seg0_pad_len > 0) {
+      m_crypto->tx->authenticated_encrypt_update_zeros(seg0_pad_len);
+    }
     frame_bl.claim_append(m_crypto->tx->authenticated_encrypt_final());
   }
   if (m_descs.size() == 1) {
@@ -226,7 +235,7 @@ bufferlist FrameAssembler::asm_secure_rev1(const preamble_block_t& preamble,
   // MAX_NUM_SEGMENTS - 1 + epilogue
   uint32_t onwire_lens[MAX_NUM_SEGMENTS];
   for (size_t i = 1; i < m_descs.size(); i++) {
-    onwire_lens[i - 1] = segment_bls[i].length();  // already padded
+    onwire_lens[i - 1] = get_segment_padded_len(i);
   }
   onwire_lens[m_descs.size() - 1] = epilogue_bl.length();
   m_crypto->tx->reset_tx_handler(onwire_lens, onwire_lens + m_descs.size());
@@ -234,6 +243,10 @@ bufferlist FrameAssembler::asm_secure_rev1(const preamble_block_t& preamble,
     if (segment_bls[i].length() > 0) {
       m_crypto->tx->authenticated_encrypt_update(segment_bls[i]);
     }
+    if (onwire_lens[i - 1] > segment_bls[i].length()) {
+      m_crypto->tx->authenticated_encrypt_update_zeros(
+        onwire_lens[i - 1] - segment_bls[i].length());
+    }
   }
   m_crypto->tx->authenticated_encrypt_update(epilogue_bl);
   frame_bl.claim_append(m_crypto->tx->authenticated_encrypt_final());
@@ -260,16 +273,12 @@ bufferlist FrameAssembler::assemble_frame(Tag tag, bufferlist segment_bls[],
   if (m_crypto->rx) {
     for (size_t i = 0; i < m_descs.size(); i++) {
       ceph_assert(segment_bls[i].length() == m_descs[i].logical_len);
-      // We're padding segments to biggest cipher's block size. Although
-      // AES-GCM can live without that as it's a stream cipher, we don't
-      // want to be fixed to stream ciphers only.
-      uint32_t padded_len = get_segment_padded_len(i);
-      if (padded_len > segment_bls[i].length()) {
-        uint32_t pad_len = padded_len - segment_bls[i].length();
-        segment_bls[i].reserve(pad_len);
-        segment_bls[i].append_zero(pad_len);
-      }
     }
+    // We're padding segments to biggest cipher's block size. Although
+    // AES-GCM can live without that as it's a stream cipher, we don't
+    // want to be fixed to stream ciphers only.  The padding is fed to
+    // the cipher directly by asm_secure_rev*() rather than appended to
+    // segment_bls, which would cost an extra allocation per segment.
     if (m_is_rev1) {
       return asm_secure_rev1(preamble, segment_bls);
     }
@@ -10,6 +10,8 @@
 #include "HybridAllocator.h"
 #include "common/debug.h"
 #include "common/admin_socket.h"
+#include "common/errno.h"
+#include "common/safe_io.h"
 #define dout_subsys ceph_subsys_bluestore
 using TOPNSPC::common::cmd_getval;
 
@@ -50,6 +52,17 @@ public:
           this,
           "give allocator fragmentation (0-no fragmentation, 1-absolute fragmentation)");
         ceph_assert(r == 0);
+        r = admin_socket->register_command(
+	  ("bluestore allocator trace start " + name +
+	   " name=path,type=CephString").c_str(),
+	  this,
+	  "start recording allocate/release calls to a binary trace file");
+        ceph_assert(r == 0);
+        r = admin_socket->register_command(
+	  ("bluestore allocator trace stop " + name).c_str(),
+	  this,
+	  "stop recording allocate/release calls");
+        ceph_assert(r == 0);
         r = admin_socket->register_command(
 	  ("bluestore allocator fragmentation histogram " + name +
            " name=alloc_unit,type=CephInt,req=false" +
@@ -105,6 +118,12 @@ public:
       f->open_object_section("fragmentation");
       f->dump_float("fragmentation_rating", alloc->get_fragmentation());
       f->close_section();
+    } else if (command == "bluestore allocator trace start " + name) {
+      string path;
+      cmd_getval(cmdmap, "path", path);
+      r = alloc->start_trace(path, ss);
+    } else if (command == "bluestore allocator trace stop " + name) {
+      alloc->stop_trace();
     } else if (command == "bluestore allocator fragmentation histogram " + name) {
       int64_t alloc_unit = 4096;
       cmd_getval(cmdmap, "alloc_unit", alloc_unit);
@@ -159,6 +178,8 @@ Allocator::Allocator(std::string_view name,
 Allocator::~Allocator()
 {
   delete asok_hook;
+  stop_trace();
+  delete trace;
 }
 
 const string& Allocator::get_name() const {
@@ -193,6 +214,182 @@ Allocator *Allocator::create(
   return alloc;
 }
 
+class Allocator::Trace {
+public:
+  ceph::mutex lock = ceph::make_mutex("Allocator::Trace::lock");
+  int fd = -1;
+  /// set while the initial free list is being captured; records queued
+  /// before the capture are superseded by it
+  bool snapshotting = false;
+  std::string head;  ///< magic, header and initial free extents
+  std::string buf;   ///< pending records
+  ceph::mono_time last;
+
+  static constexpr size_t flush_bytes = 1 << 20;
+
+  static void put_varint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+      out.push_back(char(v | 0x80));
+      v >>= 7;
+    }
+    out.push_back(char(v));
+  }
+  static void put_signed(std::string& out, int64_t v) {
+    // zigzag, so that small negative values stay short
+    put_varint(out, (uint64_t(v) << 1) ^ uint64_t(v >> 63));
+  }
+  void put_time() {
+    auto now = ceph::mono_clock::now();
+    put_varint(buf, (now - last).count());
+    last = now;
+  }
+
+  int flush() {
+    if (!head.empty()) {
+      int r = safe_write(fd, head.data(), head.size());
+      if (r < 0) {
+	return r;
+      }
+      head.clear();
+    }
+    int r = safe_write(fd, buf.data(), buf.size());
+    buf.clear();
+    return r;
+  }
+  int maybe_flush() {
+    if (snapshotting || buf.size() < flush_bytes) {
+      return 0;
+    }
+    return flush();
+  }
+};
+
+int Allocator::start_trace(const std::string& path, std::ostream& ss)
+{
+  // admin socket commands are serialized, so trace is only created here
+  if (!trace) {
+    trace = new Trace;
+  }
+  {
+    std::lock_guard l(trace->lock);
+    if (trace->fd >= 0) {
+      ss << "already tracing";
+      return -EBUSY;
+    }
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+		    0644);
+    if (fd < 0) {
+      int r = -errno;
+      ss << "unable to open " << path << ": " << cpp_strerror(r);
+      return r;
+    }
+    trace->fd = fd;
+    trace->head.assign(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    Trace::put_varint(trace->head, device_size);
+    Trace::put_varint(trace->head, block_size);
+    std::string type = get_type();
+    Trace::put_varint(trace->head, type.size());
+    trace->head.append(type);
+    trace->buf.clear();
+    trace->last = ceph::mono_clock::now();
+    trace->snapshotting = true;
+    // publishes trace to is_tracing() callers
+    tracing.store(true, std::memory_order_release);
+  }
+  // foreach() holds the allocator lock across the whole walk, and
+  // operations are recorded under that same lock, so everything queued
+  // before the first callback is already reflected in the snapshot.
+  bool first = true;
+  foreach([&](uint64_t offset, uint64_t length) {
+    std::lock_guard l(trace->lock);
+    if (first) {
+      trace->buf.clear();
+      first = false;
+    }
+    trace->head.push_back(TRACE_FREE);
+    Trace::put_varint(trace->head, offset);
+    Trace::put_varint(trace->head, length);
+  });
+  std::lock_guard l(trace->lock);
+  trace->snapshotting = false;
+  int r = trace->flush();
+  if (r < 0) {
+    ss << "unable to write " << path << ": " << cpp_strerror(r);
+    tracing = false;
+    ::close(trace->fd);
+    trace->fd = -1;
+  }
+  return r;
+}
+
+void Allocator::stop_trace()
+{
+  if (!trace) {
+    return;
+  }
+  std::lock_guard l(trace->lock);
+  tracing = false;
+  if (trace->fd >= 0) {
+    trace->flush();
+    ::close(trace->fd);
+    trace->fd = -1;
+  }
+}
+
+void Allocator::_trace_allocate(uint64_t want, uint64_t unit,
+				uint64_t max_alloc_size, int64_t hint,
+				const PExtentVector* extents,
+				const trace_mark_t& mark, int64_t result)
+{
+  std::lock_guard l(trace->lock);
+  if (trace->fd < 0) {
+    return;
+  }
+  auto& buf = trace->buf;
+  buf.push_back(TRACE_ALLOC);
+  trace->put_time();
+  Trace::put_varint(buf, want);
+  Trace::put_varint(buf, unit);
+  Trace::put_varint(buf, max_alloc_size);
+  Trace::put_signed(buf, hint);
+  Trace::put_signed(buf, result);
+  // some allocators extend the caller's last extent in place
+  size_t n = extents->size() - mark.n;
+  bool grown = mark.n && (*extents)[mark.n - 1].length != mark.last_len;
+  Trace::put_varint(buf, n + (grown ? 1 : 0));
+  if (grown) {
+    auto& e = (*extents)[mark.n - 1];
+    Trace::put_varint(buf, e.offset + mark.last_len);
+    Trace::put_varint(buf, e.length - mark.last_len);
+  }
+  for (size_t i = mark.n; i < extents->size(); ++i) {
+    Trace::put_varint(buf, (*extents)[i].offset);
+    Trace::put_varint(buf, (*extents)[i].length);
+  }
+  if (trace->maybe_flush() < 0) {
+    tracing = false;
+  }
+}
+
+void Allocator::_trace_release(const interval_set<uint64_t>& release_set)
+{
+  std::lock_guard l(trace->lock);
+  if (trace->fd < 0) {
+    return;
+  }
+  auto& buf = trace->buf;
+  buf.push_back(TRACE_RELEASE);
+  trace->put_time();
+  Trace::put_varint(buf, release_set.num_intervals());
+  for (auto [offset, length] : release_set) {
+    Trace::put_varint(buf, offset);
+    Trace::put_varint(buf, length);
+  }
+  if (trace->maybe_flush() < 0) {
+    tracing = false;
+  }
+}
+
 void Allocator::release(const PExtentVector& release_vec)
 {
   interval_set<uint64_t> release_set;
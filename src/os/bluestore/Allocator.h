@@ -12,6 +12,7 @@
 #ifndef CEPH_OS_BLUESTORE_ALLOCATOR_H
 #define CEPH_OS_BLUESTORE_ALLOCATOR_H
 
+#include <atomic>
 #include <functional>
 #include <ostream>
 #include "include/ceph_assert.h"
@@ -117,9 +118,64 @@ public:
   typedef std::vector<free_state_hist_bucket> FreeStateHistogram;
   void build_free_state_histogram(size_t alloc_unit, FreeStateHistogram& hist);
 
+  // Allocation tracing.  While enabled (see the "bluestore allocator trace"
+  // admin socket commands) every allocate() and release() is appended to
+  // a compact binary trace that ceph_test_alloc_replay can replay against
+  // any allocator type.
+  int start_trace(const std::string& path, std::ostream& ss);
+  void stop_trace();
+  bool is_tracing() const {
+    return tracing.load(std::memory_order_acquire);
+  }
+
+  /// state of the caller's extent vector before allocate() appends to it
+  struct trace_mark_t {
+    size_t n = 0;
+    uint32_t last_len = 0;
+    explicit trace_mark_t(const PExtentVector* extents) {
+      if (!extents->empty()) {
+	n = extents->size();
+	last_len = extents->back().length;
+      }
+    }
+  };
+
+  // trace file layout: magic, then varint encoded header and records
+  static constexpr char TRACE_MAGIC[8] = {'B','S','A','T','R','C','0','1'};
+  enum {
+    TRACE_FREE = 'F',     ///< offset length: free at trace start
+    TRACE_ALLOC = 'A',    ///< dt want unit max hint result n (offset length)*n
+    TRACE_RELEASE = 'R',  ///< dt n (offset length)*n
+  };
+
+protected:
+  /// to be called by allocate() implementations, preferably still under
+  /// their own lock so that the trace preserves the order of operations
+  void trace_allocate(uint64_t want, uint64_t unit, uint64_t max_alloc_size,
+		      int64_t hint, const PExtentVector* extents,
+		      const trace_mark_t& mark, int64_t result) {
+    if (is_tracing()) {
+      _trace_allocate(want, unit, max_alloc_size, hint, extents, mark, result);
+    }
+  }
+  /// to be called by release() implementations, see trace_allocate()
+  void trace_release(const interval_set<uint64_t>& release_set) {
+    if (is_tracing()) {
+      _trace_release(release_set);
+    }
+  }
+
 private:
   class SocketHook;
   SocketHook* asok_hook = nullptr;
+  class Trace;
+  Trace* trace = nullptr;
+  std::atomic<bool> tracing = {false};
+
+  void _trace_allocate(uint64_t want, uint64_t unit, uint64_t max_alloc_size,
+		       int64_t hint, const PExtentVector* extents,
+		       const trace_mark_t& mark, int64_t result);
+  void _trace_release(const interval_set<uint64_t>& release_set);
 protected:
   const int64_t device_size = 0;
   const int64_t block_size = 0;
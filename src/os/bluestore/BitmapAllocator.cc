@@ -26,6 +26,7 @@ int64_t BitmapAllocator::allocate(
 {
   uint64_t allocated = 0;
   size_t old_size = extents->size();
+  trace_mark_t mark(extents);
   ldout(cct, 10) << __func__ << std::hex << " 0x" << want_size
 		 << "/" << alloc_unit << "," << max_alloc_size << "," << hint
 		 << std::dec << dendl;
@@ -33,6 +34,10 @@ int64_t BitmapAllocator::allocate(
     
   _allocate_l2(want_size, alloc_unit, max_alloc_size, hint,
     &allocated, extents);
+  // the bitmap locks internally, so unlike the other allocators these
+  // records may be reordered against concurrent callers
+  trace_allocate(want_size, alloc_unit, max_alloc_size, hint, extents, mark,
+		 allocated ? int64_t(allocated) : -ENOSPC);
   if (!allocated) {
     return -ENOSPC;
   }
@@ -59,6 +64,7 @@ void BitmapAllocator::release(
     }
   }
   _free_l2(release_set);
+  trace_release(release_set);
   ldout(cct, 10) << __func__ << " done" << dendl;
 }
 
@@ -74,6 +74,8 @@ MEMPOOL_DEFINE_OBJECT_FACTORY(BlueStore::Onode, bluestore_onode,
 
 MEMPOOL_DEFINE_OBJECT_FACTORY(BlueStore::Buffer, bluestore_buffer,
 			      bluestore_cache_buffer);
+MEMPOOL_DEFINE_OBJECT_FACTORY(BlueStore::BufferSpace::buffer_map_t::map_t,
+			      bluestore_buffer_map, bluestore_cache_meta);
 MEMPOOL_DEFINE_OBJECT_FACTORY(BlueStore::Extent, bluestore_extent,
 			      bluestore_extent);
 MEMPOOL_DEFINE_OBJECT_FACTORY(BlueStore::Blob, bluestore_blob,
@@ -1176,6 +1178,141 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
 #endif
 };
 
+// ClockOnodeCacheShard
+//
+// CLOCK approximation of LRU.  Cached onodes stay on a ring whether or not
+// they are pinned, and unpinning an existing onode only sets its cache_ref
+// bit, without taking the shard lock.  Trimming sweeps the hand around the
+// ring under the lock: pinned onodes are skipped, referenced ones get a
+// second chance (and move to the newest age bin), the rest are evicted.
+struct ClockOnodeCacheShard : public BlueStore::OnodeCacheShard {
+  typedef boost::intrusive::list<
+    BlueStore::Onode,
+    boost::intrusive::member_hook<
+      BlueStore::Onode,
+      boost::intrusive::list_member_hook<>,
+      &BlueStore::Onode::lru_item> > list_t;
+
+  list_t ring;
+  list_t::iterator hand = ring.end();
+  uint64_t pinned_seen = 0;  ///< pinned onodes passed during this revolution
+  uint64_t num_pinned = 0;   ///< ... during the last complete one
+
+  explicit ClockOnodeCacheShard(CephContext *cct)
+    : BlueStore::OnodeCacheShard(cct) {}
+
+  void _link(BlueStore::Onode* o, int level) {
+    // the slot just behind the hand is the last one it will look at; put
+    // cold onodes right at the hand instead so they go first
+    auto p = ring.insert(hand, *o);
+    if (level > 0) {
+      o->cache_ref = true;
+    } else {
+      o->cache_ref = false;
+      hand = p;
+    }
+    o->cache_age_bin = age_bins.front();
+    *(o->cache_age_bin) += 1;
+  }
+  void _unlink(BlueStore::Onode* o) {
+    auto p = ring.iterator_to(*o);
+    if (p == hand) {
+      ++hand;
+    }
+    ring.erase(p);
+    *(o->cache_age_bin) -= 1;
+  }
+
+  void _add(BlueStore::Onode* o, int level) override
+  {
+    o->set_cached();
+    _link(o, level);
+    ++num;
+    dout(20) << __func__ << " " << this << " " << o->oid << " added, num="
+             << num << dendl;
+  }
+  void _rm(BlueStore::Onode* o) override
+  {
+    o->clear_cached();
+    if (o->lru_item.is_linked()) {
+      _unlink(o);
+    }
+    ceph_assert(num);
+    --num;
+    dout(20) << __func__ << " " << this << " " << " " << o->oid << " removed, num=" << num << dendl;
+  }
+
+  void maybe_unpin(BlueStore::Onode* o) override
+  {
+    // Touch without the shard lock.  Every cached onode is already on the
+    // ring, so unlike the lru there is nothing to relink; onodes of removed
+    // objects are left cold and go on the next sweep.  Skip the store if
+    // the bit is set so hot onodes don't bounce their cache line.
+    if (o->exists && !o->cache_ref.load(std::memory_order_relaxed)) {
+      o->cache_ref.store(true, std::memory_order_relaxed);
+    }
+  }
+
+  void _trim_to(uint64_t new_size) override
+  {
+    if (new_size >= num) {
+      return; // don't even try
+    }
+    uint64_t n = num - new_size;
+    // every onode can be passed at most twice: once to clear its reference
+    // bit and once to evict it.  pinned ones may keep us from reaching
+    // new_size, as with the lru.
+    uint64_t budget = 2 * ring.size();
+    while (n > 0 && budget-- > 0 && !ring.empty()) {
+      if (hand == ring.end()) {
+	hand = ring.begin();
+	num_pinned = pinned_seen;
+	pinned_seen = 0;
+      }
+      BlueStore::Onode *o = &*hand;
+      if (o->pin_nref > 1) {
+	++pinned_seen;
+	++hand;
+	continue;
+      }
+      if (o->cache_ref.exchange(false, std::memory_order_relaxed)) {
+	if (o->cache_age_bin != age_bins.front()) {
+	  *(o->cache_age_bin) -= 1;
+	  o->cache_age_bin = age_bins.front();
+	  *(o->cache_age_bin) += 1;
+	}
+	++hand;
+	continue;
+      }
+      dout(20) << __func__ << "  rm " << o->oid << " "
+               << o->nref << " " << o->cached << dendl;
+      _rm(o);
+      o->c->onode_space._remove(o->oid);
+      --n;
+    }
+  }
+  void _move_pinned(OnodeCacheShard *to, BlueStore::Onode *o) override
+  {
+    if (to == this) {
+      return;
+    }
+    _rm(o);
+    ceph_assert(o->nref > 1);
+    to->_add(o, 0);
+  }
+  void add_stats(uint64_t *onodes, uint64_t *pinned_onodes) override
+  {
+    std::lock_guard l(lock);
+    *onodes += num;
+    *pinned_onodes += std::min<uint64_t>(num, num_pinned);
+  }
+#ifdef DEBUG_CACHE
+  void _audit(const char *when) override
+  {
+  }
+#endif
+};
+
 // OnodeCacheShard
 BlueStore::OnodeCacheShard *BlueStore::OnodeCacheShard::create(
     CephContext* cct,
@@ -1183,8 +1320,11 @@ BlueStore::OnodeCacheShard *BlueStore::OnodeCacheShard::create(
     PerfCounters *logger)
 {
   BlueStore::OnodeCacheShard *c = nullptr;
-  // Currently we only implement an LRU cache for onodes
-  c = new LruOnodeCacheShard(cct);
+  if (type == "clock") {
+    c = new ClockOnodeCacheShard(cct);
+  } else {
+    c = new LruOnodeCacheShard(cct);
+  }
   c->logger = logger;
   return c;
 }
@@ -1660,6 +1800,7 @@ void BlueStore::BufferSpace::_clear(BufferCacheShard* cache)
   while (!buffer_map.empty()) {
     _rm_buffer(cache, buffer_map.begin());
   }
+  buffer_map.release_if_empty();
 }
 
 int BlueStore::BufferSpace::_discard(BufferCacheShard* cache, uint32_t offset, uint32_t length)
@@ -1832,6 +1973,7 @@ void BlueStore::BufferSpace::_finish_write(BufferCacheShard* cache, uint64_t seq
       ldout(cache->cct, 20) << __func__ << " added " << *b << dendl;
     }
   }
+  buffer_map.release_if_empty();
   cache->_trim();
   cache->_audit("finish_write end");
 }
@@ -1911,6 +2053,7 @@ void BlueStore::BufferSpace::split(BufferCacheShard* cache, size_t pos, BlueStor
     }
   }
   ceph_assert(writing.empty());
+  buffer_map.release_if_empty();
   cache->_trim();
 }
 
@@ -2865,6 +3008,7 @@ uint32_t BlueStore::Blob::merge_blob(CephContext* cct, Blob* blob_to_dissolve)
       dst->bc.buffer_map.insert({buf.key(), std::move(buf.mapped())});
     }
   }
+  src->bc.buffer_map.release_if_empty();
   // move BufferSpace writing
   auto wrt_dst_it = dst->bc.writing.begin();
   while(!src->bc.writing.empty()) {
@@ -4857,6 +5001,8 @@ void BlueStore::DeferredBatch::prepare_write(
 	   << " crc " << i.first->second.bl.crc32c(-1)
 	   << std::dec << dendl;
   seq_bytes[seq] += length;
+  ++prepared_ios;
+  prepared_bytes += length;
 #ifdef DEBUG_DEFERRED
   _audit(cct);
 #endif
@@ -6228,6 +6374,17 @@ void BlueStore::_init_logger()
 		    NULL,
 		    PerfCountersBuilder::PRIO_DEBUGONLY,
 		    unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_deferred_write_bytes_saved,
+		    "deferred_write_bytes_saved",
+		    "Deferred write bytes dropped as overwritten before reaching "
+		    "the WAL or disk",
+		    NULL,
+		    PerfCountersBuilder::PRIO_DEBUGONLY,
+		    unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_deferred_write_ops_saved,
+		    "deferred_write_ops_saved",
+		    "Deferred write extents merged into neighbours or dropped "
+		    "before reaching the WAL or disk");
 
   b.add_u64_counter(l_bluestore_write_big_skipped_blobs,
       "write_big_skipped_blobs",
@@ -8614,9 +8771,10 @@ void BlueStore::set_cache_shards(unsigned num)
   onode_cache_shards.resize(num);
   buffer_cache_shards.resize(num);
   for (unsigned i = oold; i < num; ++i) {
-    onode_cache_shards[i] = 
-        OnodeCacheShard::create(cct, cct->_conf->bluestore_cache_type,
-                                 logger);
+    onode_cache_shards[i] =
+        OnodeCacheShard::create(
+          cct, cct->_conf.get_val<std::string>("bluestore_onode_cache_type"),
+          logger);
   }
   for (unsigned i = bold; i < num; ++i) {
     buffer_cache_shards[i] = 
@@ -14417,6 +14575,7 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
     throttle.log_state_latency(txc, logger, l_bluestore_state_deferred_queued_lat);
   }
   uint64_t start = 0, pos = 0;
+  uint64_t submitted_ios = 0, submitted_bytes = 0;
   bufferlist bl;
   auto i = b->iomap.begin();
   while (true) {
@@ -14425,6 +14584,8 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
 	dout(20) << __func__ << " write 0x" << std::hex
 		 << start << "~" << bl.length()
 		 << " crc " << bl.crc32c(-1) << std::dec << dendl;
+	++submitted_ios;
+	submitted_bytes += bl.length();
 	if (!g_conf()->bluestore_debug_omit_block_device_write) {
 	  logger->inc(l_bluestore_submitted_deferred_writes);
 	  logger->inc(l_bluestore_submitted_deferred_write_bytes, bl.length());
@@ -14449,6 +14610,12 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
     bl.claim_append(i->second.bl);
     ++i;
   }
+  // overwritten ranges were discarded and adjacent ones merged as the
+  // batch was built up
+  logger->inc(l_bluestore_deferred_write_ops_saved,
+	      b->prepared_ios - submitted_ios);
+  logger->inc(l_bluestore_deferred_write_bytes_saved,
+	      b->prepared_bytes - submitted_bytes);
 
   bdev->aio_submit(&b->ioc);
 }
@@ -14681,6 +14848,11 @@ int BlueStore::queue_transactions(
 
   // journal deferred items
   if (txc->deferred_txn) {
+    auto [bytes_saved, ops_saved] = txc->deferred_txn->compact();
+    if (ops_saved) {
+      logger->inc(l_bluestore_deferred_write_ops_saved, ops_saved);
+      logger->inc(l_bluestore_deferred_write_bytes_saved, bytes_saved);
+    }
     txc->deferred_txn->seq = ++deferred_seq;
     bufferlist bl;
     encode(*txc->deferred_txn, bl);
@@ -143,6 +143,8 @@ enum {
   l_bluestore_issued_deferred_write_bytes,
   l_bluestore_submitted_deferred_writes,
   l_bluestore_submitted_deferred_write_bytes,
+  l_bluestore_deferred_write_bytes_saved,
+  l_bluestore_deferred_write_ops_saved,
 
   l_bluestore_write_big_skipped_blobs,
   l_bluestore_write_big_skipped_bytes,
@@ -382,8 +384,71 @@ public:
 	boost::intrusive::list_member_hook<>,
 	&Buffer::state_item> > state_list_t;
 
-    mempool::bluestore_cache_meta::map<uint32_t, Buffer>
-      buffer_map;
+    /// buffers by offset.  Most blobs never hold a cached buffer, so the
+    /// underlying map is allocated on first insert and released again by
+    /// release_if_empty() once it drains; an unused BufferSpace costs a
+    /// single pointer instead of an empty std::map.
+    class buffer_map_t {
+    public:
+      struct map_t : public mempool::bluestore_cache_meta::map<uint32_t, Buffer> {
+	MEMPOOL_CLASS_HELPERS();
+      };
+      typedef map_t::iterator iterator;
+      typedef map_t::const_iterator const_iterator;
+      typedef map_t::node_type node_type;
+      typedef map_t::value_type value_type;
+
+    private:
+      std::unique_ptr<map_t> m;
+
+      static map_t& _empty() {
+	// shared, never modified: lets lookups on an unallocated map return
+	// valid (end) iterators without allocating
+	static map_t e;
+	return e;
+      }
+      map_t& _get() const {
+	return m ? *m : _empty();
+      }
+      map_t& _alloc() {
+	if (!m) {
+	  m.reset(new map_t);
+	}
+	return *m;
+      }
+
+    public:
+      bool empty() const { return !m || m->empty(); }
+      size_t size() const { return m ? m->size() : 0; }
+      size_t count(uint32_t k) const { return m ? m->count(k) : 0; }
+
+      iterator begin() { return _get().begin(); }
+      iterator end() { return _get().end(); }
+      const_iterator begin() const { return _get().cbegin(); }
+      const_iterator end() const { return _get().cend(); }
+      const_iterator cbegin() const { return _get().cbegin(); }
+      const_iterator cend() const { return _get().cend(); }
+      iterator find(uint32_t k) { return _get().find(k); }
+      iterator lower_bound(uint32_t k) { return _get().lower_bound(k); }
+
+      template <typename... Args>
+      std::pair<iterator, bool> emplace(Args&&... args) {
+	return _alloc().emplace(std::forward<Args>(args)...);
+      }
+      std::pair<iterator, bool> insert(value_type&& v) {
+	return _alloc().insert(std::move(v));
+      }
+      iterator erase(iterator p) { return m->erase(p); }
+      size_t erase(uint32_t k) { return m ? m->erase(k) : 0; }
+      node_type extract(const_iterator p) { return m->extract(p); }
+
+      /// free the map once it holds no buffers; invalidates iterators
+      void release_if_empty() {
+	if (m && m->empty()) {
+	  m.reset();
+	}
+      }
+    } buffer_map;
 
     // we use a bare intrusive list here instead of std::map because
     // it uses less memory and we expect this to be very small (very
@@ -431,10 +496,11 @@ public:
     }
     void _rm_buffer(BufferCacheShard* cache, Buffer *b) {
       _rm_buffer(cache, buffer_map.find(b->offset));
+      buffer_map.release_if_empty();
     }
-    std::map<uint32_t, Buffer>::iterator
+    buffer_map_t::iterator
     _rm_buffer(BufferCacheShard* cache,
-		    std::map<uint32_t, Buffer>::iterator p) {
+		    buffer_map_t::iterator p) {
       ceph_assert(p != buffer_map.end());
       cache->_audit("_rm_buffer start");
       if (p->second.is_writing()) {
@@ -447,7 +513,7 @@ public:
       return p;
     }
 
-    std::map<uint32_t, Buffer>::iterator _data_lower_bound(uint32_t offset) {
+    buffer_map_t::iterator _data_lower_bound(uint32_t offset) {
       auto i = buffer_map.lower_bound(offset);
       if (i != buffer_map.begin()) {
 	--i;
@@ -464,6 +530,7 @@ public:
     int discard(BufferCacheShard* cache, uint32_t offset, uint32_t length) {
       std::lock_guard l(cache->lock);
       int ret = _discard(cache, offset, length);
+      buffer_map.release_if_empty();
       cache->_trim();
       return ret;
     }
@@ -1316,6 +1383,8 @@ public:
     mempool::bluestore_cache_meta::string key;
 
     boost::intrusive::list_member_hook<> lru_item;
+    /// referenced since the clock hand last passed (clock onode cache only)
+    std::atomic<bool> cache_ref = false;
 
     bluestore_onode_t onode;  ///< metadata stored as value in kv store
     bool exists;              ///< true if object logically exists
@@ -2092,6 +2161,9 @@ private:
     IOContext ioc;                   ///< our aios
     /// bytes of pending io for each deferred seq (may be 0)
     std::map<uint64_t,int> seq_bytes;
+    /// writes and bytes queued via prepare_write, before coalescing
+    uint64_t prepared_ios = 0;
+    uint64_t prepared_bytes = 0;
 
     void _discard(CephContext *cct, uint64_t offset, uint64_t length);
     void _audit(CephContext *cct);
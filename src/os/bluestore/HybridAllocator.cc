@@ -62,6 +62,7 @@ int64_t HybridAllocator::allocate(
   };
 
   std::lock_guard l(lock);
+  trace_mark_t mark(extents);
   // try bitmap first to avoid unneeded contiguous extents split if
   // desired amount is less than shortes range in AVL
   if (bmap_alloc && bmap_alloc->get_free() &&
@@ -87,7 +88,9 @@ int64_t HybridAllocator::allocate(
       ceph_assert(orig_size == extents->size());
     }
   }
-  return res ? res : -ENOSPC;
+  res = res ? res : -ENOSPC;
+  trace_allocate(want, unit, max_alloc_size, hint, extents, mark, res);
+  return res;
 }
 
 void HybridAllocator::release(const interval_set<uint64_t>& release_set) {
@@ -95,6 +98,7 @@ void HybridAllocator::release(const interval_set<uint64_t>& release_set) {
   // this will attempt to put free ranges into AvlAllocator first and
   // fallback to bitmap one via _try_insert_range call
   _release(release_set);
+  trace_release(release_set);
 }
 
 uint64_t HybridAllocator::get_free()
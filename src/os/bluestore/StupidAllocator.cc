@@ -178,6 +178,8 @@ int64_t StupidAllocator::allocate(
   uint64_t offset = 0;
   uint32_t length = 0;
   int res = 0;
+  const int64_t orig_hint = hint;
+  trace_mark_t mark(extents);
 
   if (max_alloc_size == 0) {
     max_alloc_size = want_size;
@@ -214,6 +216,10 @@ int64_t StupidAllocator::allocate(
     hint = offset + length;
   }
 
+  // allocate_int() locks per chunk, so these records may be reordered
+  // against concurrent callers
+  trace_allocate(want_size, alloc_unit, max_alloc_size, orig_hint, extents,
+		 mark, allocated_size ? int64_t(allocated_size) : -ENOSPC);
   if (allocated_size == 0) {
     return -ENOSPC;
   }
@@ -234,6 +240,7 @@ void StupidAllocator::release(
     _insert_free(offset, length);
     num_free += length;
   }
+  trace_release(release_set);
 }
 
 uint64_t StupidAllocator::get_free()
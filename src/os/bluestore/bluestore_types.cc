@@ -1267,6 +1267,76 @@ void bluestore_deferred_transaction_t::dump(Formatter *f) const
   f->close_section();
 }
 
+std::pair<uint64_t, uint64_t> bluestore_deferred_transaction_t::compact()
+{
+  uint64_t in_bytes = 0, in_extents = 0;
+  for (auto& op : ops) {
+    if (op.op != bluestore_deferred_op_t::OP_WRITE) {
+      return {0, 0};
+    }
+    in_extents += op.extents.size();
+  }
+  if (in_extents < 2) {
+    return {0, 0};
+  }
+
+  // offset -> data, non-overlapping; later writes punch out earlier ones
+  map<uint64_t, bufferlist> m;
+  for (auto& op : ops) {
+    auto p = op.data.cbegin();
+    for (auto& e : op.extents) {
+      bufferlist bl;
+      p.copy(e.length, bl);
+      in_bytes += e.length;
+      uint64_t end = e.end();
+      auto i = m.lower_bound(e.offset);
+      if (i != m.begin()) {
+	auto prev = std::prev(i);
+	uint64_t prev_end = prev->first + prev->second.length();
+	if (prev_end > e.offset) {
+	  if (prev_end > end) {
+	    bufferlist tail;
+	    tail.substr_of(prev->second, end - prev->first, prev_end - end);
+	    m[end].swap(tail);
+	  }
+	  bufferlist head;
+	  head.substr_of(prev->second, 0, e.offset - prev->first);
+	  prev->second.swap(head);
+	}
+      }
+      while (i != m.end() && i->first < end) {
+	uint64_t i_end = i->first + i->second.length();
+	if (i_end > end) {
+	  bufferlist tail;
+	  tail.substr_of(i->second, end - i->first, i_end - end);
+	  m[end].swap(tail);
+	}
+	i = m.erase(i);
+      }
+      m[e.offset].swap(bl);
+    }
+  }
+
+  bluestore_deferred_op_t out;
+  out.op = bluestore_deferred_op_t::OP_WRITE;
+  for (auto& [offset, bl] : m) {
+    if (!out.extents.empty() &&
+	out.extents.back().end() == offset &&
+	(uint64_t)out.extents.back().length + bl.length() <=
+	  std::numeric_limits<uint32_t>::max()) {
+      out.extents.back().length += bl.length();
+    } else {
+      out.extents.emplace_back(offset, bl.length());
+    }
+    out.data.claim_append(bl);
+  }
+  std::pair<uint64_t, uint64_t> saved(
+    in_bytes - out.data.length(), in_extents - out.extents.size());
+  ops.clear();
+  ops.push_back(std::move(out));
+  return saved;
+}
+
 void bluestore_deferred_transaction_t::generate_test_instances(list<bluestore_deferred_transaction_t*>& o)
 {
   o.push_back(new bluestore_deferred_transaction_t());
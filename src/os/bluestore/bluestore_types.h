@@ -1159,6 +1159,11 @@ struct bluestore_deferred_transaction_t {
 
   bluestore_deferred_transaction_t() : seq(0) {}
 
+  /// fold all writes into a single op with the minimal set of extents:
+  /// bytes overwritten by a later op are dropped and adjacent extents are
+  /// merged.  returns the number of data bytes and extents eliminated.
+  std::pair<uint64_t, uint64_t> compact();
+
   DENC(bluestore_deferred_transaction_t, v, p) {
     DENC_START(1, 1, p);
     denc(v.seq, p);
@@ -1206,144 +1206,7 @@ void ECBackend::handle_sub_read_reply(
 {
   trace.event("ec sub read reply");
   dout(10) << __func__ << ": reply " << op << dendl;
-  map<ceph_tid_t, ReadOp>::iterator iter = read_pipeline.tid_to_read_map.find(op.tid);
-  if (iter == read_pipeline.tid_to_read_map.end()) {
-    //canceled
-    dout(20) << __func__ << ": dropped " << op << dendl;
-    return;
-  }
-  ReadOp &rop = iter->second;
-  for (auto i = op.buffers_read.begin();
-       i != op.buffers_read.end();
-       ++i) {
-    ceph_assert(!op.errors.count(i->first));	// If attribute error we better not have sent a buffer
-    if (!rop.to_read.count(i->first)) {
-      // We canceled this read! @see filter_read_op
-      dout(20) << __func__ << " to_read skipping" << dendl;
-      continue;
-    }
-    list<boost::tuple<uint64_t, uint64_t, uint32_t> >::const_iterator req_iter =
-      rop.to_read.find(i->first)->second.to_read.begin();
-    list<
-      boost::tuple<
-	uint64_t, uint64_t, map<pg_shard_t, bufferlist> > >::iterator riter =
-      rop.complete[i->first].returned.begin();
-    for (list<pair<uint64_t, bufferlist> >::iterator j = i->second.begin();
-	 j != i->second.end();
-	 ++j, ++req_iter, ++riter) {
-      ceph_assert(req_iter != rop.to_read.find(i->first)->second.to_read.end());
-      ceph_assert(riter != rop.complete[i->first].returned.end());
-      pair<uint64_t, uint64_t> adjusted =
-	sinfo.aligned_offset_len_to_chunk(
-	  make_pair(req_iter->get<0>(), req_iter->get<1>()));
-      ceph_assert(adjusted.first == j->first);
-      riter->get<2>()[from] = std::move(j->second);
-    }
-  }
-  for (auto i = op.attrs_read.begin();
-       i != op.attrs_read.end();
-       ++i) {
-    ceph_assert(!op.errors.count(i->first));	// if read error better not have sent an attribute
-    if (!rop.to_read.count(i->first)) {
-      // We canceled this read! @see filter_read_op
-      dout(20) << __func__ << " to_read skipping" << dendl;
-      continue;
-    }
-    rop.complete[i->first].attrs.emplace();
-    (*(rop.complete[i->first].attrs)).swap(i->second);
-  }
-  for (auto i = op.errors.begin();
-       i != op.errors.end();
-       ++i) {
-    rop.complete[i->first].errors.insert(
-      make_pair(
-	from,
-	i->second));
-    dout(20) << __func__ << " shard=" << from << " error=" << i->second << dendl;
-  }
-
-  map<pg_shard_t, set<ceph_tid_t> >::iterator siter =
-					read_pipeline.shard_to_read_map.find(from);
-  ceph_assert(siter != read_pipeline.shard_to_read_map.end());
-  ceph_assert(siter->second.count(op.tid));
-  siter->second.erase(op.tid);
-
-  ceph_assert(rop.in_progress.count(from));
-  rop.in_progress.erase(from);
-  unsigned is_complete = 0;
-  bool need_resend = false;
-  // For redundant reads check for completion as each shard comes in,
-  // or in a non-recovery read check for completion once all the shards read.
-  if (rop.do_redundant_reads || rop.in_progress.empty()) {
-    for (map<hobject_t, read_result_t>::const_iterator iter =
-        rop.complete.begin();
-      iter != rop.complete.end();
-      ++iter) {
-      set<int> have;
-      for (map<pg_shard_t, bufferlist>::const_iterator j =
-          iter->second.returned.front().get<2>().begin();
-        j != iter->second.returned.front().get<2>().end();
-        ++j) {
-        have.insert(j->first.shard);
-        dout(20) << __func__ << " have shard=" << j->first.shard << dendl;
-      }
-      map<int, vector<pair<int, int>>> dummy_minimum;
-      int err;
-      if ((err = ec_impl->minimum_to_decode(rop.want_to_read[iter->first], have, &dummy_minimum)) < 0) {
-	dout(20) << __func__ << " minimum_to_decode failed" << dendl;
-        if (rop.in_progress.empty()) {
-	  // If we don't have enough copies, try other pg_shard_ts if available.
-	  // During recovery there may be multiple osds with copies of the same shard,
-	  // so getting EIO from one may result in multiple passes through this code path.
-	  if (!rop.do_redundant_reads) {
-	    int r = read_pipeline.send_all_remaining_reads(iter->first, rop);
-	    if (r == 0) {
-	      // We changed the rop's to_read and not incrementing is_complete
-	      need_resend = true;
-	      continue;
-	    }
-	    // Couldn't read any additional shards so handle as completed with errors
-	  }
-	  // We don't want to confuse clients / RBD with objectstore error
-	  // values in particular ENOENT.  We may have different error returns
-	  // from different shards, so we'll return minimum_to_decode() error
-	  // (usually EIO) to reader.  It is likely an error here is due to a
-	  // damaged pg.
-	  rop.complete[iter->first].r = err;
-	  ++is_complete;
-	}
-      } else {
-        ceph_assert(rop.complete[iter->first].r == 0);
-	if (!rop.complete[iter->first].errors.empty()) {
-	  if (cct->_conf->osd_read_ec_check_for_errors) {
-	    dout(10) << __func__ << ": Not ignoring errors, use one shard err=" << err << dendl;
-	    err = rop.complete[iter->first].errors.begin()->second;
-            rop.complete[iter->first].r = err;
-	  } else {
-	    get_parent()->clog_warn() << "Error(s) ignored for "
-				       << iter->first << " enough copies available";
-	    dout(10) << __func__ << " Error(s) ignored for " << iter->first
-		     << " enough copies available" << dendl;
-	    rop.complete[iter->first].errors.clear();
-	  }
-	}
-	// avoid re-read for completed object as we may send remaining reads for uncopmpleted objects
-	rop.to_read.at(iter->first).need.clear();
-	rop.to_read.at(iter->first).want_attrs = false;
-	++is_complete;
-      }
-    }
-  }
-  if (need_resend) {
-    read_pipeline.do_read_op(rop);
-  } else if (rop.in_progress.empty() || 
-             is_complete == rop.complete.size()) {
-    dout(20) << __func__ << " Complete: " << rop << dendl;
-    rop.trace.event("ec read complete");
-    read_pipeline.complete_read_op(rop);
-  } else {
-    dout(10) << __func__ << " readop not complete: " << rop << dendl;
-  }
+  read_pipeline.handle_sub_read_reply(from, op);
 }
 
 void ECBackend::check_recovery_sources(const OSDMapRef& osdmap)
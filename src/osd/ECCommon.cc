@@ -12,6 +12,8 @@
  *
  */
 
+#include <bit>
+#include <cmath>
 #include <iostream>
 #include <sstream>
 
@@ -303,6 +305,7 @@ int ECCommon::ReadPipeline::get_remaining_shards(
   const set<int> &avail,
   const set<int> &want,
   const read_result_t &result,
+  const set<pg_shard_t> &skip,
   map<pg_shard_t, vector<pair<int, int>>> *to_read,
   bool for_recovery)
 {
@@ -310,7 +313,7 @@ int ECCommon::ReadPipeline::get_remaining_shards(
 
   set<int> have;
   map<shard_id_t, pg_shard_t> shards;
-  set<pg_shard_t> error_shards;
+  set<pg_shard_t> error_shards = skip;
   for (auto &p : result.errors) {
     error_shards.insert(p.first);
   }
@@ -344,7 +347,7 @@ int ECCommon::ReadPipeline::get_remaining_shards(
   return 0;
 }
 
-void ECCommon::ReadPipeline::start_read_op(
+ceph_tid_t ECCommon::ReadPipeline::start_read_op(
   int priority,
   map<hobject_t, set<int>> &want_to_read,
   map<hobject_t, read_request_t> &to_read,
@@ -374,6 +377,7 @@ void ECCommon::ReadPipeline::start_read_op(
     op.trace.event("start ec read");
   }
   do_read_op(op);
+  return tid;
 }
 
 void ECCommon::ReadPipeline::do_read_op(ReadOp &op)
@@ -421,10 +425,12 @@ void ECCommon::ReadPipeline::do_read_op(ReadOp &op)
 
   std::vector<std::pair<int, Message*>> m;
   m.reserve(messages.size());
+  auto now = ceph::mono_clock::now();
   for (map<pg_shard_t, ECSubRead>::iterator i = messages.begin();
        i != messages.end();
        ++i) {
     op.in_progress.insert(i->first);
+    op.sent[i->first] = now;
     shard_to_read_map[i->first].insert(op.tid);
     i->second.tid = tid;
     MOSDECSubOpRead *msg = new MOSDECSubOpRead;
@@ -563,7 +569,7 @@ void ECCommon::ReadPipeline::objects_read_and_reconstruct(
     obj_want_to_read.insert(make_pair(to_read.first, want_to_read));
   }
 
-  start_read_op(
+  ceph_tid_t tid = start_read_op(
     CEPH_MSG_PRIO_DEFAULT,
     obj_want_to_read,
     for_read_op,
@@ -571,12 +577,20 @@ void ECCommon::ReadPipeline::objects_read_and_reconstruct(
     fast_read,
     false,
     std::make_unique<ClientReadCompleter>(*this, &(in_progress_client_reads.back())));
+  if (!fast_read &&
+      cct->_conf.get_val<bool>("osd_ec_hedged_reads") &&
+      ec_impl->get_coding_chunk_count() > 0) {
+    auto &rop = tid_to_read_map.at(tid);
+    rop.hedge = true;
+    schedule_hedge(rop);
+  }
 }
 
 
 int ECCommon::ReadPipeline::send_all_remaining_reads(
   const hobject_t &hoid,
-  ReadOp &rop)
+  ReadOp &rop,
+  const set<pg_shard_t> &skip)
 {
   set<int> already_read;
   const set<pg_shard_t>& ots = rop.obj_to_source[hoid];
@@ -585,7 +599,8 @@ int ECCommon::ReadPipeline::send_all_remaining_reads(
   dout(10) << __func__ << " have/error shards=" << already_read << dendl;
   map<pg_shard_t, vector<pair<int, int>>> shards;
   int r = get_remaining_shards(hoid, already_read, rop.want_to_read[hoid],
-			       rop.complete[hoid], &shards, rop.for_recovery);
+			       rop.complete[hoid], skip, &shards,
+			       rop.for_recovery);
   if (r)
     return r;
 
@@ -610,6 +625,151 @@ int ECCommon::ReadPipeline::send_all_remaining_reads(
   return 0;
 }
 
+void ECCommon::ReadPipeline::handle_sub_read_reply(
+  pg_shard_t from,
+  ECSubReadReply &op)
+{
+  map<ceph_tid_t, ReadOp>::iterator iter = tid_to_read_map.find(op.tid);
+  if (iter == tid_to_read_map.end()) {
+    //canceled
+    dout(20) << __func__ << ": dropped " << op << dendl;
+    return;
+  }
+  ReadOp &rop = iter->second;
+  for (auto i = op.buffers_read.begin();
+       i != op.buffers_read.end();
+       ++i) {
+    ceph_assert(!op.errors.count(i->first));	// If attribute error we better not have sent a buffer
+    if (!rop.to_read.count(i->first)) {
+      // We canceled this read! @see filter_read_op
+      dout(20) << __func__ << " to_read skipping" << dendl;
+      continue;
+    }
+    list<boost::tuple<uint64_t, uint64_t, uint32_t> >::const_iterator req_iter =
+      rop.to_read.find(i->first)->second.to_read.begin();
+    list<
+      boost::tuple<
+	uint64_t, uint64_t, map<pg_shard_t, bufferlist> > >::iterator riter =
+      rop.complete[i->first].returned.begin();
+    for (list<pair<uint64_t, bufferlist> >::iterator j = i->second.begin();
+	 j != i->second.end();
+	 ++j, ++req_iter, ++riter) {
+      ceph_assert(req_iter != rop.to_read.find(i->first)->second.to_read.end());
+      ceph_assert(riter != rop.complete[i->first].returned.end());
+      pair<uint64_t, uint64_t> adjusted =
+	sinfo.aligned_offset_len_to_chunk(
+	  make_pair(req_iter->get<0>(), req_iter->get<1>()));
+      ceph_assert(adjusted.first == j->first);
+      riter->get<2>()[from] = std::move(j->second);
+    }
+  }
+  for (auto i = op.attrs_read.begin();
+       i != op.attrs_read.end();
+       ++i) {
+    ceph_assert(!op.errors.count(i->first));	// if read error better not have sent an attribute
+    if (!rop.to_read.count(i->first)) {
+      // We canceled this read! @see filter_read_op
+      dout(20) << __func__ << " to_read skipping" << dendl;
+      continue;
+    }
+    rop.complete[i->first].attrs.emplace();
+    (*(rop.complete[i->first].attrs)).swap(i->second);
+  }
+  for (auto i = op.errors.begin();
+       i != op.errors.end();
+       ++i) {
+    rop.complete[i->first].errors.insert(
+      make_pair(
+	from,
+	i->second));
+    dout(20) << __func__ << " shard=" << from << " error=" << i->second << dendl;
+  }
+
+  map<pg_shard_t, set<ceph_tid_t> >::iterator siter =
+					shard_to_read_map.find(from);
+  ceph_assert(siter != shard_to_read_map.end());
+  ceph_assert(siter->second.count(op.tid));
+  siter->second.erase(op.tid);
+
+  ceph_assert(rop.in_progress.count(from));
+  rop.in_progress.erase(from);
+  note_sub_read_reply(rop, from);
+  unsigned is_complete = 0;
+  bool need_resend = false;
+  // For redundant reads check for completion as each shard comes in,
+  // or in a non-recovery read check for completion once all the shards read.
+  if (rop.do_redundant_reads || rop.in_progress.empty()) {
+    for (map<hobject_t, read_result_t>::const_iterator iter =
+        rop.complete.begin();
+      iter != rop.complete.end();
+      ++iter) {
+      set<int> have;
+      for (map<pg_shard_t, bufferlist>::const_iterator j =
+          iter->second.returned.front().get<2>().begin();
+        j != iter->second.returned.front().get<2>().end();
+        ++j) {
+        have.insert(j->first.shard);
+        dout(20) << __func__ << " have shard=" << j->first.shard << dendl;
+      }
+      map<int, vector<pair<int, int>>> dummy_minimum;
+      int err;
+      if ((err = ec_impl->minimum_to_decode(rop.want_to_read[iter->first], have, &dummy_minimum)) < 0) {
+	dout(20) << __func__ << " minimum_to_decode failed" << dendl;
+        if (rop.in_progress.empty()) {
+	  // If we don't have enough copies, try other pg_shard_ts if available.
+	  // During recovery there may be multiple osds with copies of the same shard,
+	  // so getting EIO from one may result in multiple passes through this code path.
+	  if (!rop.do_redundant_reads) {
+	    int r = send_all_remaining_reads(iter->first, rop);
+	    if (r == 0) {
+	      // We changed the rop's to_read and not incrementing is_complete
+	      need_resend = true;
+	      continue;
+	    }
+	    // Couldn't read any additional shards so handle as completed with errors
+	  }
+	  // We don't want to confuse clients / RBD with objectstore error
+	  // values in particular ENOENT.  We may have different error returns
+	  // from different shards, so we'll return minimum_to_decode() error
+	  // (usually EIO) to reader.  It is likely an error here is due to a
+	  // damaged pg.
+	  rop.complete[iter->first].r = err;
+	  ++is_complete;
+	}
+      } else {
+        ceph_assert(rop.complete[iter->first].r == 0);
+	if (!rop.complete[iter->first].errors.empty()) {
+	  if (cct->_conf->osd_read_ec_check_for_errors) {
+	    dout(10) << __func__ << ": Not ignoring errors, use one shard err=" << err << dendl;
+	    err = rop.complete[iter->first].errors.begin()->second;
+            rop.complete[iter->first].r = err;
+	  } else {
+	    get_parent()->clog_warn() << "Error(s) ignored for "
+				       << iter->first << " enough copies available";
+	    dout(10) << __func__ << " Error(s) ignored for " << iter->first
+		     << " enough copies available" << dendl;
+	    rop.complete[iter->first].errors.clear();
+	  }
+	}
+	// avoid re-read for completed object as we may send remaining reads for uncopmpleted objects
+	rop.to_read.at(iter->first).need.clear();
+	rop.to_read.at(iter->first).want_attrs = false;
+	++is_complete;
+      }
+    }
+  }
+  if (need_resend) {
+    do_read_op(rop);
+  } else if (rop.in_progress.empty() || 
+             is_complete == rop.complete.size()) {
+    dout(20) << __func__ << " Complete: " << rop << dendl;
+    rop.trace.event("ec read complete");
+    complete_read_op(rop);
+  } else {
+    dout(10) << __func__ << " readop not complete: " << rop << dendl;
+  }
+}
+
 void ECCommon::ReadPipeline::kick_reads()
 {
   while (in_progress_client_reads.size() &&
@@ -619,6 +779,151 @@ void ECCommon::ReadPipeline::kick_reads()
   }
 }
 
+void ECCommon::ReadPipeline::sub_read_latency_t::add(ceph::timespan lat)
+{
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(lat).count();
+  unsigned b = us > 0 ? std::bit_width(static_cast<uint64_t>(us)) : 0;
+  ++buckets[std::min(b, BUCKETS - 1)];
+  if (++samples >= DECAY_SAMPLES) {
+    samples = 0;
+    for (auto &n : buckets) {
+      n /= 2;
+      samples += n;
+    }
+  }
+}
+
+ceph::timespan ECCommon::ReadPipeline::sub_read_latency_t::get_percentile(
+  double pct) const
+{
+  uint64_t want = std::ceil(samples * pct);
+  uint64_t seen = 0;
+  unsigned b = 0;
+  for (; b < BUCKETS - 1; ++b) {
+    seen += buckets[b];
+    if (seen >= want)
+      break;
+  }
+  // bucket b holds latencies below 2^b us
+  return std::chrono::microseconds(1ull << b);
+}
+
+void ECCommon::ReadPipeline::note_sub_read_reply(ReadOp &rop, pg_shard_t from)
+{
+  auto p = rop.sent.find(from);
+  if (p == rop.sent.end())
+    return;
+  osd_read_latency[from.osd].add(ceph::mono_clock::now() - p->second);
+  rop.sent.erase(p);
+}
+
+ceph::timespan ECCommon::ReadPipeline::get_hedge_delay(int osd) const
+{
+  auto min_delay = cct->_conf.get_val<std::chrono::milliseconds>(
+    "osd_ec_hedged_read_min_delay");
+  auto max_delay = cct->_conf.get_val<std::chrono::milliseconds>(
+    "osd_ec_hedged_read_max_delay");
+  auto p = osd_read_latency.find(osd);
+  // too few samples to tell what slow means for this osd
+  if (p == osd_read_latency.end() || p->second.get_samples() < 32)
+    return max_delay;
+  auto delay = p->second.get_percentile(
+    cct->_conf.get_val<double>("osd_ec_hedged_read_percentile"));
+  return std::clamp<ceph::timespan>(delay, min_delay,
+				     std::max(min_delay, max_delay));
+}
+
+void ECCommon::ReadPipeline::schedule_hedge(ReadOp &rop)
+{
+  // fire when the first outstanding shard is due
+  std::optional<ceph::mono_time> due;
+  for (auto &&shard : rop.in_progress) {
+    auto p = rop.sent.find(shard);
+    if (p == rop.sent.end())
+      continue;
+    auto t = p->second + get_hedge_delay(shard.osd);
+    if (!due || t < *due)
+      due = t;
+  }
+  if (!due)
+    return;
+  auto delay = std::max<ceph::timespan>(
+    *due - ceph::mono_clock::now(), ceph::timespan::zero());
+  dout(20) << __func__ << ": tid " << rop.tid << " in " << delay << dendl;
+  get_parent()->schedule_delayed_work(
+    make_gen_lambda_context<ThreadPool::TPHandle&>(
+      [this, tid=rop.tid](ThreadPool::TPHandle&) {
+	hedge_read_op(tid);
+      }).release(),
+    delay);
+}
+
+void ECCommon::ReadPipeline::hedge_read_op(ceph_tid_t tid)
+{
+  auto i = tid_to_read_map.find(tid);
+  if (i == tid_to_read_map.end())
+    return;
+  ReadOp &rop = i->second;
+  if (!rop.hedge || rop.do_redundant_reads || rop.in_progress.empty())
+    return;
+
+  auto now = ceph::mono_clock::now();
+  bool slow = false;
+  for (auto &&shard : rop.in_progress) {
+    auto p = rop.sent.find(shard);
+    if (p != rop.sent.end() && now - p->second >= get_hedge_delay(shard.osd)) {
+      dout(10) << __func__ << ": tid " << tid << " waiting on " << shard
+	       << " for " << (now - p->second) << dendl;
+      slow = true;
+      break;
+    }
+  }
+  if (!slow) {
+    // the delays moved since this was scheduled
+    schedule_hedge(rop);
+    return;
+  }
+
+  // only hedge the objects still waiting on a shard.  do_read_op() sends
+  // whatever is left in need, so clear it for the others, whose shards
+  // have all answered.  send_all_remaining_reads() replaces the to_read
+  // entries of the pending ones with shards to read in place of those in
+  // flight: a shard can't take a second sub read of the same op.
+  std::vector<hobject_t> pending;
+  for (auto &&[hoid, req] : rop.to_read) {
+    if (req.need.empty())
+      continue;
+    bool outstanding = false;
+    for (auto &&shard : rop.obj_to_source[hoid]) {
+      if (rop.in_progress.count(shard)) {
+	outstanding = true;
+	break;
+      }
+    }
+    if (outstanding) {
+      pending.push_back(hoid);
+    } else {
+      req.need.clear();
+      req.want_attrs = false;
+    }
+  }
+  bool sent = false;
+  for (auto &&hoid : pending) {
+    if (send_all_remaining_reads(hoid, rop, rop.in_progress) == 0) {
+      sent = true;
+    } else {
+      // nothing spare to read, wait for the shards in flight
+      rop.to_read.at(hoid).need.clear();
+    }
+  }
+  // from now on complete as soon as enough shards are back
+  rop.do_redundant_reads = true;
+  if (sent) {
+    rop.trace.event("ec read hedged");
+    do_read_op(rop);
+  }
+}
+
 
 void ECCommon::RMWPipeline::start_rmw(OpRef op)
 {
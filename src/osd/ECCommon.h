@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <array>
 #include <boost/intrusive/set.hpp>
 #include <boost/intrusive/list.hpp>
 #include <fmt/format.h>
@@ -42,6 +43,7 @@ typedef void* OpRequestRef;
 typedef crimson::osd::ObjectContextRef ObjectContextRef;
 #else
 #include "common/WorkQueue.h"
+#include "common/ostream_temp.h"
 #endif
 
 #include "ECTransaction.h"
@@ -49,6 +51,7 @@ typedef crimson::osd::ObjectContextRef ObjectContextRef;
 
 //forward declaration
 struct ECSubWrite;
+struct ECSubReadReply;
 struct PGLog;
 
 // ECListener -- an interface decoupling the pipelines from
@@ -144,6 +147,16 @@ struct ECListener {
   virtual void schedule_recovery_work(
     GenContext<ThreadPool::TPHandle&> *c,
     uint64_t cost) = 0;
+
+  /**
+   * Queue c, blessed against interval changes, to run with the pg lock
+   * held once delay has elapsed
+   */
+  virtual void schedule_delayed_work(
+    GenContext<ThreadPool::TPHandle&> *c,
+    ceph::timespan delay) = 0;
+
+  virtual OstreamTemp clog_warn() = 0;
 #endif
 
   virtual epoch_t get_interval_start_epoch() const = 0;
@@ -331,6 +344,13 @@ struct ECCommon {
 
     std::set<pg_shard_t> in_progress;
 
+    // when the sub reads were sent, to sample per osd latencies and
+    // to tell when a hedged read is due
+    std::map<pg_shard_t, ceph::mono_time> sent;
+    // True if the read is hedged, i.e. the spare shards are read when
+    // one of the shards is slow to answer
+    bool hedge = false;
+
     ReadOp(
       int priority,
       ceph_tid_t tid,
@@ -385,7 +405,7 @@ struct ECCommon {
 
     void complete_read_op(ReadOp &rop);
 
-    void start_read_op(
+    ceph_tid_t start_read_op(
       int priority,
       std::map<hobject_t, std::set<int>> &want_to_read,
       std::map<hobject_t, read_request_t> &to_read,
@@ -396,14 +416,52 @@ struct ECCommon {
 
     void do_read_op(ReadOp &rop);
 
+    /// read the shards not read yet that, with those read and not in
+    /// skip, are enough to decode hoid
     int send_all_remaining_reads(
       const hobject_t &hoid,
-      ReadOp &rop);
+      ReadOp &rop,
+      const std::set<pg_shard_t> &skip = {});
 
     void on_change();
 
     void kick_reads();
 
+    void handle_sub_read_reply(
+      pg_shard_t from,
+      ECSubReadReply &op);
+
+    /**
+     * Hedged reads
+     *
+     * A hedged read is first sent to the minimal set of shards, like a
+     * regular read.  If one of them has not answered by the time most
+     * sub reads served by its osd have (osd_ec_hedged_read_percentile),
+     * the spare shards are read too and the op turns into a redundant
+     * read, completing as soon as enough shards are back to decode.
+     */
+    class sub_read_latency_t {
+      // log2 buckets of microseconds, up to ~16s
+      static constexpr unsigned BUCKETS = 24;
+      // halve the counts past this many samples to follow changes
+      static constexpr uint32_t DECAY_SAMPLES = 1024;
+      std::array<uint32_t, BUCKETS> buckets = {};
+      uint32_t samples = 0;
+    public:
+      void add(ceph::timespan lat);
+      uint32_t get_samples() const {
+        return samples;
+      }
+      /// upper bound of the latency of pct of the sampled sub reads
+      ceph::timespan get_percentile(double pct) const;
+    };
+    std::map<int, sub_read_latency_t> osd_read_latency;
+
+    void note_sub_read_reply(ReadOp &rop, pg_shard_t from);
+    ceph::timespan get_hedge_delay(int osd) const;
+    void schedule_hedge(ReadOp &rop);
+    void hedge_read_op(ceph_tid_t tid);
+
     std::map<ceph_tid_t, ReadOp> tid_to_read_map;
     std::map<pg_shard_t, std::set<ceph_tid_t> > shard_to_read_map;
     std::list<ClientAsyncReadStatus> in_progress_client_reads;
@@ -434,6 +492,7 @@ struct ECCommon {
       const std::set<int> &avail,
       const std::set<int> &want,
       const read_result_t &result,
+      const std::set<pg_shard_t> &skip,
       std::map<pg_shard_t, std::vector<std::pair<int, int>>> *to_read,
       bool for_recovery);
 
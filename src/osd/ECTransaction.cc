@@ -53,9 +53,18 @@ static void encode_and_write(
   ceph_assert(sinfo.logical_offset_is_stripe_aligned(bl.length()));
   ceph_assert(bl.length());
 
+  // appends extend the shard hashes; have them computed during the encode
+  // rather than re-reading every shard afterwards
+  std::vector<uint32_t> hashes;
+  const bool hash_in_encode = offset >= before_size &&
+    hinfo->has_chunk_hash() &&
+    want.size() == hinfo->get_chunk_hashes().size();
+  if (hash_in_encode) {
+    hashes = hinfo->get_chunk_hashes();
+  }
   map<int, bufferlist> buffers;
   int r = ECUtil::encode(
-    sinfo, ecimpl, bl, want, &buffers);
+    sinfo, ecimpl, bl, want, &buffers, hash_in_encode ? &hashes : nullptr);
   ceph_assert(r == 0);
 
   written.insert(offset, bl.length(), bl);
@@ -67,9 +76,16 @@ static void encode_and_write(
 
   if (offset >= before_size) {
     ceph_assert(offset == before_size);
-    hinfo->append(
-      sinfo.aligned_logical_offset_to_chunk_offset(offset),
-      buffers);
+    if (hash_in_encode) {
+      hinfo->append_hashed(
+	sinfo.aligned_logical_offset_to_chunk_offset(offset),
+	sinfo.aligned_logical_offset_to_chunk_offset(bl.length()),
+	std::move(hashes));
+    } else {
+      hinfo->append(
+	sinfo.aligned_logical_offset_to_chunk_offset(offset),
+	buffers);
+    }
   }
 
   for (auto &&i : *transactions) {
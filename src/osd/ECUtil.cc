@@ -125,7 +125,8 @@ int ECUtil::encode(
   ErasureCodeInterfaceRef &ec_impl,
   bufferlist &in,
   const set<int> &want,
-  map<int, bufferlist> *out) {
+  map<int, bufferlist> *out,
+  vector<uint32_t> *crcs) {
 
   uint64_t logical_size = in.length();
 
@@ -140,7 +141,20 @@ int ECUtil::encode(
     map<int, bufferlist> encoded;
     bufferlist buf;
     buf.substr_of(in, i, sinfo.get_stripe_width());
-    int r = ec_impl->encode(want, buf, &encoded);
+    int r;
+    if (crcs) {
+      // checksum each stripe unit while it is still in cache, in the
+      // same pass as the parity if the plugin can
+      r = ec_impl->encode_with_crc(want, buf, &encoded, crcs);
+      if (r == -EOPNOTSUPP) {
+	r = ec_impl->encode(want, buf, &encoded);
+	for (auto &&[shard, chunk] : encoded) {
+	  (*crcs)[shard] = chunk.crc32c((*crcs)[shard]);
+	}
+      }
+    } else {
+      r = ec_impl->encode(want, buf, &encoded);
+    }
     ceph_assert(r == 0);
     for (map<int, bufferlist>::iterator i = encoded.begin();
 	 i != encoded.end();
@@ -179,6 +193,17 @@ void ECUtil::HashInfo::append(uint64_t old_size,
   total_chunk_size += size_to_append;
 }
 
+void ECUtil::HashInfo::append_hashed(uint64_t old_size,
+				     uint64_t size_to_append,
+				     vector<uint32_t> &&new_hashes) {
+  ceph_assert(old_size == total_chunk_size);
+  if (has_chunk_hash()) {
+    ceph_assert(new_hashes.size() == cumulative_shard_hashes.size());
+    cumulative_shard_hashes = std::move(new_hashes);
+  }
+  total_chunk_size += size_to_append;
+}
+
 void ECUtil::HashInfo::encode(bufferlist &bl) const
 {
   ENCODE_START(1, 1, bl);
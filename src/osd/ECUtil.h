@@ -91,12 +91,14 @@ int decode(
   std::map<int, ceph::buffer::list> &to_decode,
   std::map<int, ceph::buffer::list*> &out);
 
+/// if crcs is given, also fold each wanted shard into crcs[shard] (crc32c)
 int encode(
   const stripe_info_t &sinfo,
   ceph::ErasureCodeInterfaceRef &ec_impl,
   ceph::buffer::list &in,
   const std::set<int> &want,
-  std::map<int, ceph::buffer::list> *out);
+  std::map<int, ceph::buffer::list> *out,
+  std::vector<uint32_t> *crcs = nullptr);
 
 class HashInfo {
   uint64_t total_chunk_size = 0;
@@ -109,6 +111,10 @@ public:
   explicit HashInfo(unsigned num_chunks) :
     cumulative_shard_hashes(num_chunks, -1) {}
   void append(uint64_t old_size, std::map<int, ceph::buffer::list> &to_append);
+  /// like append(), with the new hashes already computed by ECUtil::encode()
+  /// starting from get_chunk_hashes()
+  void append_hashed(uint64_t old_size, uint64_t size_to_append,
+                     std::vector<uint32_t> &&new_hashes);
   void clear() {
     total_chunk_size = 0;
     cumulative_shard_hashes = std::vector<uint32_t>(
@@ -119,6 +125,9 @@ public:
   void decode(ceph::buffer::list::const_iterator &bl);
   void dump(ceph::Formatter *f) const;
   static void generate_test_instances(std::list<HashInfo*>& o);
+  const std::vector<uint32_t> &get_chunk_hashes() const {
+    return cumulative_shard_hashes;
+  }
   uint32_t get_chunk_hash(int shard) const {
     ceph_assert((unsigned)shard < cumulative_shard_hashes.size());
     return cumulative_shard_hashes[shard];
@@ -10821,9 +10821,34 @@ OSDShard::OSDShard(
     scheduler(ceph::osd::scheduler::make_scheduler(
       cct, osd->whoami, osd->num_shards, id, osd->store->is_rotational(),
       osd->store->get_type(), osd_op_queue, osd_op_queue_cut_off, osd->monc)),
-    context_queue(sdata_wait_lock, sdata_cond)
+    context_queue(sdata_wait_lock, sdata_cond),
+    ready_batch(cct->_conf.get_val<uint64_t>("osd_op_ready_queue_batch")),
+    ready_steal_shards(cct->_conf.get_val<bool>("osd_op_ready_queue_steal_shards"))
 {
   dout(0) << "using op scheduler " << *scheduler << dendl;
+  if (ready_batch > 1) {
+    int threads = std::max(1, osd->get_num_op_threads() / (int)osd->num_shards);
+    ready_queue = std::make_unique<OSDShardReadyQueue>(threads, ready_batch);
+    dout(0) << "using " << threads << " ready queues, batch " << ready_batch
+	    << dendl;
+  }
+}
+
+void OSDShard::push_ready(unsigned thread, spg_t token)
+{
+  ready_queue->push(thread, token);
+}
+
+bool OSDShard::pop_ready(unsigned thread, spg_t *token, bool *stolen)
+{
+  OSDShardReadyQueue::entry_t e;
+  if (!ready_queue || !ready_queue->pop(thread, &e, stolen)) {
+    return false;
+  }
+  osd->logger->tinc(l_osd_op_ready_residency_lat,
+		    ceph::mono_clock::now() - e.stamp);
+  *token = e.token;
+  return true;
 }
 
 
@@ -10860,8 +10885,10 @@ void OSD::ShardedOpWQ::_add_slot_waiter(
 void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 {
   uint32_t shard_index = thread_index % osd->num_shards;
-  auto& sdata = osd->shards[shard_index];
+  OSDShard *sdata = osd->shards[shard_index];
   ceph_assert(sdata);
+  // our position among the threads of this shard
+  uint32_t shard_thread = thread_index / osd->num_shards;
 
   // If all threads of shards do oncommits, there is a out-of-order
   // problem.  So we choose the thread which has the smallest
@@ -10869,10 +10896,32 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   // callback.
   bool is_smallest_thread_index = thread_index < osd->num_shards;
 
+  // items already dequeued by us or a sibling go first
+  if (sdata->ready_batch > 1) {
+    spg_t token;
+    bool stolen = false;
+    if (sdata->pop_ready(shard_thread, &token, &stolen)) {
+      if (stolen) {
+	osd->logger->inc(l_osd_op_ready_stolen);
+      }
+      _process_ready(sdata, token, is_smallest_thread_index, hb);
+      return;
+    }
+  }
+
   // peek at spg_t
   sdata->shard_lock.lock();
-  if (sdata->scheduler->empty() &&
+  if (sdata->scheduler->empty() && !sdata->has_ready() &&
       (!is_smallest_thread_index || sdata->context_queue.empty())) {
+    if (sdata->ready_batch > 1 && sdata->ready_steal_shards &&
+	std::any_of(osd->shards.begin(), osd->shards.end(),
+		    [](auto s) { return s->has_ready(); })) {
+      // help another shard instead of going idle.  drop our own shard_lock
+      // first; we never hold two of them at once.
+      sdata->shard_lock.unlock();
+      _steal_ready(shard_index, shard_thread, hb);
+      return;
+    }
     std::unique_lock wait_lock{sdata->sdata_wait_lock};
     if (is_smallest_thread_index && !sdata->context_queue.empty()) {
       // we raced with a context_queue addition, don't wait
@@ -10988,6 +11037,96 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   dout(20) << __func__ << " " << slot->to_process.back()
 	   << " queued" << dendl;
 
+  if (sdata->ready_batch > 1) {
+    _dequeue_ready(sdata, shard_thread);
+  }
+
+  _process_slot(sdata, token, slot, oncommits, hb);
+}
+
+void OSD::ShardedOpWQ::_dequeue_ready(OSDShard *sdata, uint32_t shard_thread)
+{
+  ceph_assert(ceph_mutex_is_locked_by_me(sdata->shard_lock));
+  // anything not runnable yet stays in the scheduler for a waiting thread
+  std::vector<OpSchedulerItem> items;
+  items.reserve(sdata->ready_batch - 1);
+  unsigned n = sdata->scheduler->dequeue_batch(sdata->ready_batch - 1, items);
+  for (auto& item : items) {
+    const auto token = item.get_ordering_token();
+    auto r = sdata->pg_slots.emplace(token, nullptr);
+    if (r.second) {
+      r.first->second = make_unique<OSDShardPGSlot>();
+    }
+    dout(20) << __func__ << " " << item << " queued, ready" << dendl;
+    r.first->second->to_process.push_back(std::move(item));
+    sdata->push_ready(shard_thread, token);
+  }
+  if (n) {
+    osd->logger->inc(l_osd_op_ready_batched, n);
+    // wake idle siblings so they can steal
+    std::lock_guard l{sdata->sdata_wait_lock};
+    sdata->sdata_cond.notify_all();
+  }
+}
+
+void OSD::ShardedOpWQ::_process_ready(
+  OSDShard *sdata,
+  spg_t token,
+  bool take_oncommits,
+  heartbeat_handle_d *hb)
+{
+  list<Context *> oncommits;
+  sdata->shard_lock.lock();
+  if (take_oncommits) {
+    sdata->context_queue.move_to(oncommits);
+  }
+  if (osd->is_stopping()) {
+    sdata->shard_lock.unlock();
+    for (auto c : oncommits) {
+      dout(10) << __func__ << " discarding in-flight oncommit " << c << dendl;
+      delete c;
+    }
+    return;    // OSD shutdown, discard.
+  }
+  auto p = sdata->pg_slots.find(token);
+  if (p == sdata->pg_slots.end() || p->second->to_process.empty()) {
+    // the slot went away, or its items were requeued by _wake_pg_slot or
+    // already run through another entry
+    dout(20) << __func__ << " " << token << " nothing queued" << dendl;
+    sdata->shard_lock.unlock();
+    handle_oncommits(oncommits);
+    return;
+  }
+  _process_slot(sdata, token, p->second.get(), oncommits, hb);
+}
+
+bool OSD::ShardedOpWQ::_steal_ready(
+  uint32_t shard_index,
+  uint32_t shard_thread,
+  heartbeat_handle_d *hb)
+{
+  for (uint32_t i = 1; i < osd->num_shards; ++i) {
+    OSDShard *victim = osd->shards[(shard_index + i) % osd->num_shards];
+    spg_t token;
+    bool stolen = false;
+    if (victim->pop_ready(shard_thread, &token, &stolen)) {
+      dout(20) << __func__ << " " << token << " from shard "
+	       << victim->shard_id << dendl;
+      osd->logger->inc(l_osd_op_ready_stolen_shard);
+      _process_ready(victim, token, false, hb);
+      return true;
+    }
+  }
+  return false;
+}
+
+void OSD::ShardedOpWQ::_process_slot(
+  OSDShard *sdata,
+  spg_t token,
+  OSDShardPGSlot *slot,
+  list<Context*>& oncommits,
+  heartbeat_handle_d *hb)
+{
  retry_pg:
   PGRef pg = slot->pg;
 
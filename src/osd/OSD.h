@@ -39,6 +39,7 @@
 #include "Session.h"
 
 #include "osd/scheduler/OpScheduler.h"
+#include "osd/OSDShardReadyQueue.h"
 
 #include <atomic>
 #include <map>
@@ -1009,6 +1010,22 @@ struct OSDShard {
 
   ContextQueue context_queue;
 
+  /// max items a worker dequeues per shard_lock acquisition; 0 disables
+  /// the ready queues (see OSDShardReadyQueue)
+  const unsigned ready_batch;
+  /// idle workers may steal ready items from other shards
+  const bool ready_steal_shards;
+  /// set when ready_batch > 1
+  std::unique_ptr<OSDShardReadyQueue> ready_queue;
+
+  bool has_ready() const {
+    return ready_queue && ready_queue->has_ready();
+  }
+  /// note an item the caller just put on token's to_process; shard_lock held
+  void push_ready(unsigned thread, spg_t token);
+  /// take an entry from thread's own ready queue, else from a sibling's
+  bool pop_ready(unsigned thread, spg_t *token, bool *stolen);
+
   void _attach_pg(OSDShardPGSlot *slot, PG *pg);
   void _detach_pg(OSDShardPGSlot *slot);
 
@@ -1561,6 +1578,31 @@ protected:
     /// try to do some work
     void _process(uint32_t thread_index, ceph::heartbeat_handle_d *hb) override;
 
+    /// run the next item of slot; called with sdata->shard_lock held,
+    /// returns with it released
+    void _process_slot(
+      OSDShard *sdata,
+      spg_t token,
+      OSDShardPGSlot *slot,
+      std::list<Context*>& oncommits,
+      ceph::heartbeat_handle_d *hb);
+
+    /// dequeue up to ready_batch - 1 more items onto our ready queue
+    void _dequeue_ready(OSDShard *sdata, uint32_t shard_thread);
+
+    /// run the item behind a ready queue entry
+    void _process_ready(
+      OSDShard *sdata,
+      spg_t token,
+      bool take_oncommits,
+      ceph::heartbeat_handle_d *hb);
+
+    /// run one ready item of some other shard, if there is any
+    bool _steal_ready(
+      uint32_t shard_index,
+      uint32_t shard_thread,
+      ceph::heartbeat_handle_d *hb);
+
     void stop_for_fast_shutdown();
 
     /// enqueue a new item
@@ -1608,6 +1650,9 @@ protected:
       auto &&sdata = osd->shards[shard_index];
       ceph_assert(sdata);
       std::lock_guard l(sdata->shard_lock);
+      if (sdata->has_ready()) {
+	return false;
+      }
       if (thread_index < osd->num_shards) {
 	return sdata->scheduler->empty() && sdata->context_queue.empty();
       } else {
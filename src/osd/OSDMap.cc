@@ -37,6 +37,7 @@
 
 #include "crush/CrushTreeDumper.h"
 #include "common/Clock.h"
+#include "common/Thread.h"
 #include "mon/PGMap.h"
 #include "common/pick_address.h"
 
@@ -5515,6 +5516,86 @@ int OSDMap::calc_desired_primary_distribution_osdsize_opt(
   return 0;
 
 }
+/// A fixed set of threads calc_pg_upmaps() fans read-only work out to:
+/// mapping pgs and evaluating candidate remaps.  run() hands out indices
+/// [0, n) to the workers and the calling thread, and returns once all of
+/// them are processed.  With a single thread everything runs inline.
+class OSDMap::UpmapWorkers {
+  std::vector<std::thread> threads;
+  ceph::mutex lock = ceph::make_mutex("OSDMap::UpmapWorkers::lock");
+  ceph::condition_variable cond;
+  std::function<void(size_t)> fn;
+  size_t num_items = 0;
+  std::atomic<size_t> next_item = 0;
+  uint64_t generation = 0;
+  unsigned finished = 0;
+  bool stopping = false;
+
+  void drain() {
+    for (size_t i = next_item++; i < num_items; i = next_item++) {
+      fn(i);
+    }
+  }
+  void worker() {
+    uint64_t seen = 0;
+    std::unique_lock l(lock);
+    while (true) {
+      cond.wait(l, [&] { return stopping || generation != seen; });
+      if (stopping) {
+	return;
+      }
+      seen = generation;
+      l.unlock();
+      drain();
+      l.lock();
+      if (++finished == threads.size()) {
+	cond.notify_all();
+      }
+    }
+  }
+
+public:
+  explicit UpmapWorkers(unsigned num_threads) {
+    for (unsigned i = 1; i < num_threads; ++i) {
+      threads.push_back(make_named_thread("upmap_calc",
+					  &UpmapWorkers::worker, this));
+    }
+  }
+  ~UpmapWorkers() {
+    {
+      std::lock_guard l(lock);
+      stopping = true;
+    }
+    cond.notify_all();
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+  unsigned size() const {
+    return threads.size() + 1;
+  }
+  void run(size_t n, std::function<void(size_t)> f) {
+    if (threads.empty() || n < 2) {
+      for (size_t i = 0; i < n; ++i) {
+	f(i);
+      }
+      return;
+    }
+    {
+      std::lock_guard l(lock);
+      fn = std::move(f);
+      num_items = n;
+      next_item = 0;
+      finished = 0;
+      ++generation;
+    }
+    cond.notify_all();
+    drain();
+    std::unique_lock l(lock);
+    cond.wait(l, [this] { return finished == threads.size(); });
+  }
+};
+
 int OSDMap::calc_pg_upmaps(
   CephContext *cct,
   uint32_t max_deviation,
@@ -5524,6 +5605,8 @@ int OSDMap::calc_pg_upmaps(
   std::random_device::result_type *p_seed)
 {
   ldout(cct, 10) << __func__ << " pools " << only_pools << dendl;
+  UpmapWorkers workers(
+    std::max<uint64_t>(1, cct->_conf.get_val<uint64_t>("osd_calc_pg_upmaps_threads")));
   OSDMap tmp_osd_map;
   // Can't be less than 1 pg
   if (max_deviation < 1)
@@ -5540,7 +5623,7 @@ int OSDMap::calc_pg_upmaps(
     return 0;
   }
 
-  osd_weight_total = build_pool_pgs_info(cct, only_pools, tmp_osd_map, 
+  osd_weight_total = build_pool_pgs_info(cct, only_pools, tmp_osd_map, workers,
                                          total_pgs, pgs_by_osd, osd_weight);
   if (osd_weight_total == 0) {
     lderr(cct) << __func__ << " abort due to osd_weight_total == 0" << dendl;
@@ -5571,6 +5654,57 @@ int OSDMap::calc_pg_upmaps(
     cct->_conf.get_val<bool>("osd_calc_pg_upmaps_aggressively_fast");
   auto local_fallback_retries =
     cct->_conf.get_val<uint64_t>("osd_calc_pg_upmaps_local_fallback_retries");
+
+  // Candidate remaps only modify the few osds named in their upmap items.
+  // Rather than copying pgs_by_osd for every attempt, keep a working copy
+  // in sync and only copy the touched osds in whichever direction the
+  // attempt went.
+  auto temp_pgs_by_osd = pgs_by_osd;
+  auto touched_osds = [&tmp_osd_map](
+    const set<pg_t>& to_unmap,
+    const map<pg_t, mempool::osdmap::vector<pair<int32_t,int32_t>>>& to_upmap) {
+    set<int> osds;
+    auto add_items = [&osds](const auto& items) {
+      for (auto& [from, to] : items) {
+	osds.insert(from);
+	osds.insert(to);
+      }
+    };
+    for (auto& pg : to_unmap) {
+      if (auto p = tmp_osd_map.pg_upmap_items.find(pg);
+	  p != tmp_osd_map.pg_upmap_items.end()) {
+	add_items(p->second);
+      }
+    }
+    for (auto& [pg, items] : to_upmap) {
+      add_items(items);
+      if (auto p = tmp_osd_map.pg_upmap_items.find(pg);
+	  p != tmp_osd_map.pg_upmap_items.end()) {
+	add_items(p->second);
+      }
+    }
+    return osds;
+  };
+  auto copy_osds = [](const set<int>& osds,
+		      const map<int,set<pg_t>>& from,
+		      map<int,set<pg_t>>& to) {
+    for (auto osd : osds) {
+      if (auto p = from.find(osd); p != from.end()) {
+	to[osd] = p->second;
+      } else {
+	to.erase(osd);
+      }
+    }
+  };
+
+  // outcome of trying to upmap one pg away from an overfull osd
+  struct upmap_attempt_t {
+    int pos = -1;
+    size_t pg_pool_size = 0;
+    vector<int> orig, out;
+    set<int> existing;
+    mempool::osdmap::vector<pair<int32_t,int32_t>> new_upmap_items;
+  };
     
   while (max--) {
     ldout(cct, 30) << "Top of loop #" << max+1 << dendl;
@@ -5609,7 +5743,6 @@ int OSDMap::calc_pg_upmaps(
 
     set<pg_t> to_unmap;
     map<pg_t, mempool::osdmap::vector<pair<int32_t,int32_t>>> to_upmap;
-    auto temp_pgs_by_osd = pgs_by_osd;
     // always start with fullest, break if we find any changes to make
     for (auto p = deviation_osd.rbegin(); p != deviation_osd.rend(); ++p) {
       if (skip_overfull && !underfull.empty()) {
@@ -5662,64 +5795,82 @@ int OSDMap::calc_pg_upmaps(
 	goto test_change;
 
       // try upmap
-      for (auto pg : pgs) {
-        auto temp_it = tmp_osd_map.pg_upmap.find(pg);
-        if (temp_it != tmp_osd_map.pg_upmap.end()) {
-          // leave pg_upmap alone
-          // it must be specified by admin since balancer does not
-          // support pg_upmap yet
-	  ldout(cct, 10) << " " << pg << " already has pg_upmap "
-                         << temp_it->second << ", skipping"
-                         << dendl;
-	  continue;
-	}
-        auto pg_pool_size = tmp_osd_map.get_pg_pool_size(pg);
-        mempool::osdmap::vector<pair<int32_t,int32_t>> new_upmap_items;
-        set<int> existing;
-        auto it = tmp_osd_map.pg_upmap_items.find(pg);
-        if (it != tmp_osd_map.pg_upmap_items.end()) {
-	  auto& um_items = it->second;
-          if (um_items.size() >= (size_t)pg_pool_size) {
-            ldout(cct, 10) << " " << pg << " already has full-size pg_upmap_items "
-                           << um_items << ", skipping"
-                           << dendl;
-            continue;
-          } else {
-            ldout(cct, 10) << " " << pg << " already has pg_upmap_items "
-                           << um_items
+      {
+        // Evaluating a pg only reads tmp_osd_map and the deviation tables,
+        // so with several workers we evaluate a window of pgs at once and
+        // then take the first one that worked, exactly as the serial loop
+        // would have.
+        auto try_upmap = [&](pg_t pg, upmap_attempt_t *a) {
+          auto temp_it = tmp_osd_map.pg_upmap.find(pg);
+          if (temp_it != tmp_osd_map.pg_upmap.end()) {
+            // leave pg_upmap alone
+            // it must be specified by admin since balancer does not
+            // support pg_upmap yet
+	    ldout(cct, 10) << " " << pg << " already has pg_upmap "
+                           << temp_it->second << ", skipping"
                            << dendl;
-            new_upmap_items = um_items;
-            // build existing too (for dedup)
-            for (auto [um_from, um_to] : um_items) {
-              existing.insert(um_from);
-              existing.insert(um_to);
-            }
+	    return;
 	  }
-          // fall through
-          // to see if we can append more remapping pairs
-	}
-	ldout(cct, 10) << " trying " << pg << dendl;
-        vector<int> raw, orig, out;
-        tmp_osd_map.pg_to_raw_upmap(pg, &raw, &orig); // including existing upmaps too
-	if (!try_pg_upmap(cct, pg, overfull, underfull, more_underfull, &orig, &out)) {
-	  continue;
-	}
-	ldout(cct, 10) << " " << pg << " " << orig << " -> " << out << dendl;
-	if (orig.size() != out.size()) {
-	  continue;
-	}
-	ceph_assert(orig != out);
-	int pos = find_best_remap(cct, orig, out, existing, osd_deviation);
-	if (pos != -1) {
-          // append new remapping pairs slowly
-          // This way we can make sure that each tiny change will
-          // definitely make distribution of PGs converging to
-          // the perfect status.
-	  add_remap_pair(cct, orig[pos], out[pos], pg, (size_t)pg_pool_size, 
-	  		 osd, existing, temp_pgs_by_osd,
-			 new_upmap_items, to_upmap);
-          goto test_change;
-	}
+          a->pg_pool_size = tmp_osd_map.get_pg_pool_size(pg);
+          auto it = tmp_osd_map.pg_upmap_items.find(pg);
+          if (it != tmp_osd_map.pg_upmap_items.end()) {
+	    auto& um_items = it->second;
+            if (um_items.size() >= a->pg_pool_size) {
+              ldout(cct, 10) << " " << pg << " already has full-size pg_upmap_items "
+                             << um_items << ", skipping"
+                             << dendl;
+              return;
+            } else {
+              ldout(cct, 10) << " " << pg << " already has pg_upmap_items "
+                             << um_items
+                             << dendl;
+              a->new_upmap_items = um_items;
+              // build existing too (for dedup)
+              for (auto [um_from, um_to] : um_items) {
+                a->existing.insert(um_from);
+                a->existing.insert(um_to);
+              }
+	    }
+            // fall through
+            // to see if we can append more remapping pairs
+	  }
+	  ldout(cct, 10) << " trying " << pg << dendl;
+          vector<int> raw;
+          tmp_osd_map.pg_to_raw_upmap(pg, &raw, &a->orig); // including existing upmaps too
+	  if (!try_pg_upmap(cct, pg, overfull, underfull, more_underfull,
+			    &a->orig, &a->out)) {
+	    return;
+	  }
+	  ldout(cct, 10) << " " << pg << " " << a->orig << " -> " << a->out << dendl;
+	  if (a->orig.size() != a->out.size()) {
+	    return;
+	  }
+	  ceph_assert(a->orig != a->out);
+	  a->pos = find_best_remap(cct, a->orig, a->out, a->existing, osd_deviation);
+        };
+
+        size_t window = workers.size() > 1 ? workers.size() * 8 : 1;
+        vector<upmap_attempt_t> attempts;
+        for (size_t begin = 0; begin < pgs.size(); begin += window) {
+          size_t n = std::min(window, pgs.size() - begin);
+          attempts.assign(n, upmap_attempt_t());
+          workers.run(n, [&](size_t i) {
+            try_upmap(pgs[begin + i], &attempts[i]);
+          });
+          for (size_t i = 0; i < n; ++i) {
+            auto& a = attempts[i];
+	    if (a.pos != -1) {
+              // append new remapping pairs slowly
+              // This way we can make sure that each tiny change will
+              // definitely make distribution of PGs converging to
+              // the perfect status.
+	      add_remap_pair(cct, a.orig[a.pos], a.out[a.pos], pgs[begin + i],
+			     a.pg_pool_size, osd, a.existing, temp_pgs_by_osd,
+			     a.new_upmap_items, to_upmap);
+              goto test_change;
+	    }
+          }
+        }
       }
       if (fast_aggressive) {
 	if (prev_n_changes == n_changes) {  // no changes for prev OSD
@@ -5735,6 +5886,10 @@ int OSDMap::calc_pg_upmaps(
     ceph_assert(!(to_unmap.size() || to_upmap.size()));
     ldout(cct, 10) << " failed to find any changes for overfull osds"
                    << dendl;
+    {
+    // without shuffling, the candidates only depend on to_skip and the
+    // upmap items, neither of which change while we walk the underfull osds
+    std::optional<candidates_t> unshuffled_candidates;
     for (auto& [deviation, osd] : deviation_osd) {
       if (std::find(underfull.begin(), underfull.end(), osd) ==
                     underfull.end())
@@ -5752,13 +5907,21 @@ int OSDMap::calc_pg_upmaps(
         break;
       }
       // look for remaps we can un-remap
-      candidates_t candidates = build_candidates(cct, tmp_osd_map, to_skip,
+      candidates_t shuffled_candidates;
+      if (aggressive) {
+        shuffled_candidates = build_candidates(cct, tmp_osd_map, to_skip,
+      					       only_pools, aggressive, p_seed);
+      } else if (!unshuffled_candidates) {
+        unshuffled_candidates = build_candidates(cct, tmp_osd_map, to_skip,
       						 only_pools, aggressive, p_seed);
-      if (try_drop_remap_underfull(cct, candidates, osd, temp_pgs_by_osd,
-          to_unmap, to_upmap)) {
+      }
+      if (try_drop_remap_underfull(cct,
+				   aggressive ? shuffled_candidates : *unshuffled_candidates,
+				   osd, temp_pgs_by_osd, to_unmap, to_upmap)) {
 	goto test_change;
       }
     }
+    }
 
     ceph_assert(!(to_unmap.size() || to_upmap.size()));
     ldout(cct, 10) << " failed to find any changes for underfull osds"
@@ -5790,6 +5953,8 @@ int OSDMap::calc_pg_upmaps(
 					      temp_deviation_osd, new_stddev);
     ldout(cct, 10) << " stddev " << stddev << " -> " << new_stddev << dendl;
     if (new_stddev >= stddev) {
+      // roll the working copy back to match pgs_by_osd
+      copy_osds(touched_osds(to_unmap, to_upmap), pgs_by_osd, temp_pgs_by_osd);
       if (!aggressive) {
         ldout(cct, 10) << " break because stddev is not decreasing"
                        << " and aggressive mode is not enabled"
@@ -5820,9 +5985,9 @@ int OSDMap::calc_pg_upmaps(
     // ready to go
     ceph_assert(new_stddev < stddev);
     stddev = new_stddev;
-    pgs_by_osd = temp_pgs_by_osd;
-    osd_deviation = temp_osd_deviation;
-    deviation_osd = temp_deviation_osd;
+    copy_osds(touched_osds(to_unmap, to_upmap), temp_pgs_by_osd, pgs_by_osd);
+    osd_deviation = std::move(temp_osd_deviation);
+    deviation_osd = std::move(temp_deviation_osd);
     n_changes++;
 
 
@@ -5915,6 +6080,7 @@ float OSDMap::build_pool_pgs_info (
   CephContext *cct,
   const std::set<int64_t>& only_pools,        ///< [optional] restrict to pool
   const OSDMap& tmp_osd_map,
+  UpmapWorkers& workers,
   int& total_pgs,
   map<int,set<pg_t>>& pgs_by_osd,
   map<int,float>& osds_weight)
@@ -5928,10 +6094,20 @@ float OSDMap::build_pool_pgs_info (
   for (auto& [pid, pdata] : pools) {
     if (!only_pools.empty() && !only_pools.count(pid))
       continue;
-    for (unsigned ps = 0; ps < pdata.get_pg_num(); ++ps) {
+    // map the pgs in parallel chunks, then index them in pg order
+    const unsigned pgs_per_chunk = 1024;
+    unsigned pg_num = pdata.get_pg_num();
+    vector<vector<int>> ups(pg_num);
+    workers.run((pg_num + pgs_per_chunk - 1) / pgs_per_chunk, [&](size_t c) {
+      unsigned end = std::min<unsigned>(pg_num, (c + 1) * pgs_per_chunk);
+      for (unsigned ps = c * pgs_per_chunk; ps < end; ++ps) {
+        tmp_osd_map.pg_to_up_acting_osds(pg_t(ps, pid), &ups[ps],
+                                         nullptr, nullptr, nullptr);
+      }
+    });
+    for (unsigned ps = 0; ps < pg_num; ++ps) {
       pg_t pg(ps, pid);
-      vector<int> up;
-      tmp_osd_map.pg_to_up_acting_osds(pg, &up, nullptr, nullptr, nullptr);
+      auto& up = ups[ps];
       ldout(cct, 20) << __func__ << " " << pg << " up " << up << dendl;
       for (auto osd : up) {
         if (osd != CRUSH_ITEM_NONE)
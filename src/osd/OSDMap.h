@@ -674,6 +674,7 @@ private:
   uint32_t crush_version = 1;
 
   friend class OSDMonitor;
+  friend class OSDMapMapping;
 
  public:
   OSDMap() : epoch(0), 
@@ -1534,6 +1535,8 @@ public:
 
 private: // Bunch of internal functions used only by calc_pg_upmaps (result of code refactoring)
 
+  class UpmapWorkers;
+
   float get_osds_weight(
     CephContext *cct,
     const OSDMap& tmp_osd_map,
@@ -1545,6 +1548,7 @@ private: // Bunch of internal functions used only by calc_pg_upmaps (result of c
     CephContext *cct,
     const std::set<int64_t>& pools,        ///< [optional] restrict to pool
     const OSDMap& tmp_osd_map,
+    UpmapWorkers& workers,
     int& total_pgs,
     std::map<int, std::set<pg_t>>& pgs_by_osd,
     std::map<int,float>& osds_weight
@@ -54,21 +54,265 @@ void OSDMapMapping::update(const OSDMap& osdmap)
   //_dump();  // for debugging
 }
 
+void OSDMapMapping::update_dirty(const OSDMap& osdmap)
+{
+  vector<pg_t> pgs;
+  if (!_get_dirty_pgs(osdmap, &pgs)) {
+    update(osdmap);
+    return;
+  }
+  _start(osdmap, &pgs);
+  for (auto& pgid : pgs) {
+    _update_range(osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
+  }
+  _finish(osdmap);
+}
+
 void OSDMapMapping::update(const OSDMap& osdmap, pg_t pgid)
 {
   _update_range(osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
 }
 
-void OSDMapMapping::_build_rmap(const OSDMap& osdmap)
+std::unique_ptr<OSDMapMapping::MappingJob> OSDMapMapping::start_update(
+  const OSDMap& osdmap,
+  ParallelPGMapper& mapper,
+  unsigned pgs_per_item)
 {
-  acting_rmap.resize(osdmap.get_max_osd());
-  //up_rmap.resize(osdmap.get_max_osd());
-  for (auto& v : acting_rmap) {
-    v.resize(0);
+  vector<pg_t> pgs;
+  bool full = !_get_dirty_pgs(osdmap, &pgs);
+  std::unique_ptr<MappingJob> job(
+    new MappingJob(&osdmap, this, full ? nullptr : &pgs));
+  if (full) {
+    mapper.queue(job.get(), pgs_per_item, {});
+  } else if (!pgs.empty()) {
+    mapper.queue(job.get(), pgs_per_item, pgs);
+  } else {
+    // nothing can have moved; just catch up to this epoch
+    job->finish = ceph_clock_now();
+    job->complete();
+  }
+  return job;
+}
+
+void OSDMapMapping::_note_rmap_pgs(
+  const rmap_t& rmap,
+  const std::set<int>& osds,
+  epoch_t e)
+{
+  for (auto osd : osds) {
+    if (osd < 0 || osd >= (int)rmap.size()) {
+      continue;
+    }
+    for (auto& pgid : rmap[osd]) {
+      dirty_pgs[pgid] = e;
+    }
+  }
+}
+
+// Find the pgs whose last computed mapping involves one of @osds.  With
+// @include_degraded, also take every pg whose up set is short: a down or
+// nonexistent osd is filtered out of up but is still in the raw crush
+// mapping, so it can reappear there without being mentioned anywhere.
+// Called with dirty_lock held.
+void OSDMapMapping::_note_osd_pgs(
+  const OSDMap& prev,
+  const std::set<int>& osds,
+  bool include_degraded,
+  epoch_t e)
+{
+  // the reverse maps reflect the last completed job.  whatever is still
+  // dirty was remapped since, so we can't tell whether it involves these
+  // osds now: keep it dirty until this epoch is mapped as well
+  for (auto& [pgid, pe] : dirty_pgs) {
+    pe = e;
+  }
+  for (auto& [poolid, pe] : dirty_pools) {
+    pe = e;
+  }
+
+  _note_rmap_pgs(acting_rmap, osds, e);
+  _note_rmap_pgs(up_rmap, osds, e);
+  if (include_degraded) {
+    for (auto& pgid : degraded_pgs) {
+      dirty_pgs[pgid] = e;
+    }
+  }
+
+  // explicit mappings that name one of the osds may start or stop being
+  // honored: upmap targets are ignored when marked out, temp mappings
+  // filter osds that are down.
+  auto mentions = [&osds](const auto& v) {
+    for (auto osd : v) {
+      if (osds.count(osd)) {
+	return true;
+      }
+    }
+    return false;
+  };
+  for (const auto& [pgid, v] : *prev.pg_temp) {
+    if (mentions(v)) {
+      dirty_pgs[pgid] = e;
+    }
+  }
+  for (auto& [pgid, osd] : *prev.primary_temp) {
+    if (osds.count(osd)) {
+      dirty_pgs[pgid] = e;
+    }
+  }
+  for (auto& [pgid, v] : prev.pg_upmap) {
+    if (mentions(v)) {
+      dirty_pgs[pgid] = e;
+    }
+  }
+  for (auto& [pgid, items] : prev.pg_upmap_items) {
+    for (auto& [from, to] : items) {
+      if (osds.count(from) || osds.count(to)) {
+	dirty_pgs[pgid] = e;
+	break;
+      }
+    }
+  }
+  for (auto& [pgid, osd] : prev.pg_upmap_primaries) {
+    if (osds.count(osd)) {
+      dirty_pgs[pgid] = e;
+    }
+  }
+}
+
+void OSDMapMapping::note_incremental(
+  const OSDMap& prev,
+  const OSDMap::Incremental& inc)
+{
+  std::lock_guard l(dirty_lock);
+  epoch_t e = inc.epoch;
+  bool in_sequence = std::max(noted_epoch, epoch) + 1 == e;
+  noted_epoch = e;
+  if (dirty_all || !in_sequence) {
+    // the table may not reflect prev, so we can't reason from it
+    _mark_all_dirty(e);
+    return;
+  }
+  if (inc.fullmap.length() ||
+      inc.crush.length() ||
+      inc.new_max_osd >= 0) {
+    _mark_all_dirty(e);
+    return;
+  }
+
+  // osds whose weight went up can be picked by crush for any pg
+  std::set<int> osds;
+  bool any_state_change = false;
+  for (auto& [osd, w] : inc.new_weight) {
+    if (osd >= prev.get_max_osd() || w > prev.get_weight(osd)) {
+      _mark_all_dirty(e);
+      return;
+    }
+    osds.insert(osd);
+  }
+  for (auto& [osd, state] : inc.new_state) {
+    // a 0 state is interpreted as CEPH_OSD_UP, see apply_incremental
+    if (state == 0 || (state & (CEPH_OSD_UP | CEPH_OSD_EXISTS))) {
+      osds.insert(osd);
+      any_state_change = true;
+    }
+  }
+  for (auto& [osd, addrs] : inc.new_up_client) {
+    osds.insert(osd);
+    any_state_change = true;
+  }
+  for (auto& [osd, aff] : inc.new_primary_affinity) {
+    osds.insert(osd);
+  }
+
+  for (auto& [poolid, pool] : inc.new_pools) {
+    dirty_pools[poolid] = e;
+  }
+  auto note_pg = [this, e](pg_t pgid) {
+    dirty_pgs[pgid] = e;
+  };
+  for (auto& [pgid, v] : inc.new_pg_temp) {
+    note_pg(pgid);
+  }
+  for (auto& [pgid, osd] : inc.new_primary_temp) {
+    note_pg(pgid);
+  }
+  for (auto& [pgid, v] : inc.new_pg_upmap) {
+    note_pg(pgid);
+  }
+  for (auto& [pgid, v] : inc.new_pg_upmap_items) {
+    note_pg(pgid);
   }
-  //for (auto& v : up_rmap) {
-  //  v.resize(0);
-  //}
+  for (auto& [pgid, osd] : inc.new_pg_upmap_primary) {
+    note_pg(pgid);
+  }
+  for (auto& pgid : inc.old_pg_upmap) {
+    note_pg(pgid);
+  }
+  for (auto& pgid : inc.old_pg_upmap_items) {
+    note_pg(pgid);
+  }
+  for (auto& pgid : inc.old_pg_upmap_primary) {
+    note_pg(pgid);
+  }
+
+  if (!osds.empty()) {
+    _note_osd_pgs(prev, osds, any_state_change || !inc.new_weight.empty(), e);
+  }
+}
+
+// Fill @pgs with every pg that must be recomputed to bring the table up to
+// @osdmap, or return false if that takes a full recompute.
+bool OSDMapMapping::_get_dirty_pgs(const OSDMap& osdmap, vector<pg_t> *pgs)
+{
+  std::lock_guard l(dirty_lock);
+  if (dirty_all ||
+      (osdmap.get_epoch() != noted_epoch && osdmap.get_epoch() != epoch)) {
+    return false;
+  }
+  std::set<int64_t> whole_pools;
+  for (auto& [poolid, pool] : osdmap.get_pools()) {
+    auto p = pools.find(poolid);
+    if (dirty_pools.count(poolid) ||
+	p == pools.end() ||
+	p->second.pg_num != pool.get_pg_num() ||
+	p->second.size != pool.get_size()) {
+      whole_pools.insert(poolid);
+      for (unsigned ps = 0; ps < pool.get_pg_num(); ++ps) {
+	pgs->push_back(pg_t(ps, poolid));
+      }
+    }
+  }
+  for (auto& [pgid, e] : dirty_pgs) {
+    auto pool = osdmap.get_pg_pool(pgid.pool());
+    if (!pool ||
+	whole_pools.count(pgid.pool()) ||
+	pgid.ps() >= pool->get_pg_num()) {
+      continue;
+    }
+    pgs->push_back(pgid);
+  }
+  return true;
+}
+
+// called with dirty_lock held
+void OSDMapMapping::_clear_dirty(epoch_t e)
+{
+  epoch = e;
+  if (dirty_all && dirty_all_epoch <= e) {
+    dirty_all = false;
+  }
+  std::erase_if(dirty_pgs, [e](const auto& p) { return p.second <= e; });
+  std::erase_if(dirty_pools, [e](const auto& p) { return p.second <= e; });
+}
+
+void OSDMapMapping::_build_rmap(
+  const OSDMap& osdmap,
+  rmap_t *acting,
+  rmap_t *up,
+  mempool::osdmap_mapping::vector<pg_t> *degraded)
+{
+  acting->resize(osdmap.get_max_osd());
+  up->resize(osdmap.get_max_osd());
   for (auto& p : pools) {
     pg_t pgid(0, p.first);
     for (unsigned ps = 0; ps < p.second.pg_num; ++ps) {
@@ -76,20 +320,136 @@ void OSDMapMapping::_build_rmap(const OSDMap& osdmap)
       int32_t *row = &p.second.table[p.second.row_size() * ps];
       for (int i = 0; i < row[2]; ++i) {
 	if (row[4 + i] != CRUSH_ITEM_NONE) {
-	  acting_rmap[row[4 + i]].push_back(pgid);
+	  (*acting)[row[4 + i]].push_back(pgid);
+	}
+      }
+      bool is_degraded = row[3] < (int32_t)p.second.size;
+      for (int i = 0; i < row[3]; ++i) {
+	if (row[4 + p.second.size + i] != CRUSH_ITEM_NONE) {
+	  (*up)[row[4 + p.second.size + i]].push_back(pgid);
+	} else {
+	  is_degraded = true;
+	}
+      }
+      if (is_degraded) {
+	degraded->push_back(pgid);
+      }
+    }
+  }
+}
+
+void OSDMapMapping::_start(const OSDMap& osdmap, const vector<pg_t> *dirty)
+{
+  old_rows.clear();
+  rmap_incremental = dirty && !rmap_stale;
+  rmap_stale = true;
+  if (rmap_incremental) {
+    auto save = [this](const PoolMapping& pm, pg_t pgid) {
+      auto& r = old_rows[pgid];
+      pm.get(pgid.ps(), &r.up, nullptr, &r.acting, nullptr);
+    };
+    for (auto& [poolid, pm] : pools) {
+      auto pool = osdmap.get_pg_pool(poolid);
+      if (!pool ||
+	  pool->get_pg_num() != pm.pg_num ||
+	  pool->get_size() != pm.size) {
+	// _init_mappings() is about to drop this table
+	for (unsigned ps = 0; ps < pm.pg_num; ++ps) {
+	  save(pm, pg_t(ps, poolid));
 	}
       }
-      //for (int i = 0; i < row[3]; ++i) {
-      //up_rmap[row[4 + p.second.size + i]].push_back(pgid);
-      //}
+    }
+    for (auto& pgid : *dirty) {
+      if (old_rows.count(pgid)) {
+	continue;
+      }
+      auto p = pools.find(pgid.pool());
+      if (p != pools.end() && pgid.ps() < p->second.pg_num) {
+	save(p->second, pgid);
+      } else {
+	// new pg, in no reverse map yet
+	old_rows[pgid];
+      }
+    }
+  }
+  _init_mappings(osdmap);
+}
+
+// Move the pgs saved by _start() from the osds they mapped to before to
+// the ones they map to now.  The reverse maps are unordered, so a pg is
+// unlinked by swapping it with the last entry.  Called with dirty_lock
+// held.
+void OSDMapMapping::_patch_rmap(const OSDMap& osdmap)
+{
+  acting_rmap.resize(osdmap.get_max_osd());
+  up_rmap.resize(osdmap.get_max_osd());
+  auto unlink = [](rmap_t& rmap, int osd, pg_t pgid) {
+    if (osd < 0 || osd >= (int)rmap.size()) {
+      return;
+    }
+    auto& pgs = rmap[osd];
+    auto p = std::find(pgs.begin(), pgs.end(), pgid);
+    if (p != pgs.end()) {
+      *p = pgs.back();
+      pgs.pop_back();
+    }
+  };
+  std::erase_if(degraded_pgs, [this](pg_t pgid) {
+    return old_rows.count(pgid);
+  });
+  vector<int> up, acting;
+  for (auto& [pgid, old] : old_rows) {
+    for (auto osd : old.acting) {
+      unlink(acting_rmap, osd, pgid);
+    }
+    for (auto osd : old.up) {
+      unlink(up_rmap, osd, pgid);
+    }
+    auto p = pools.find(pgid.pool());
+    if (p == pools.end() || pgid.ps() >= p->second.pg_num) {
+      continue;
+    }
+    p->second.get(pgid.ps(), &up, nullptr, &acting, nullptr);
+    for (auto osd : acting) {
+      if (osd != CRUSH_ITEM_NONE) {
+	acting_rmap[osd].push_back(pgid);
+      }
+    }
+    bool is_degraded = up.size() < p->second.size;
+    for (auto osd : up) {
+      if (osd != CRUSH_ITEM_NONE) {
+	up_rmap[osd].push_back(pgid);
+      } else {
+	is_degraded = true;
+      }
+    }
+    if (is_degraded) {
+      degraded_pgs.push_back(pgid);
     }
   }
+  old_rows.clear();
 }
 
 void OSDMapMapping::_finish(const OSDMap& osdmap)
 {
-  _build_rmap(osdmap);
-  epoch = osdmap.get_epoch();
+  rmap_stale = false;
+  if (rmap_incremental) {
+    // only the pgs this job recomputed can have moved
+    std::lock_guard l(dirty_lock);
+    _patch_rmap(osdmap);
+    _clear_dirty(osdmap.get_epoch());
+    return;
+  }
+  // build the reverse maps outside the lock; note_incremental() only
+  // ever sees a complete set
+  rmap_t acting, up;
+  mempool::osdmap_mapping::vector<pg_t> degraded;
+  _build_rmap(osdmap, &acting, &up, &degraded);
+  std::lock_guard l(dirty_lock);
+  acting_rmap.swap(acting);
+  up_rmap.swap(up);
+  degraded_pgs.swap(degraded);
+  _clear_dirty(osdmap.get_epoch());
 }
 
 void OSDMapMapping::_dump()
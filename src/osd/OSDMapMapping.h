@@ -9,11 +9,10 @@
 #include <map>
 
 #include "osd/osd_types.h"
+#include "osd/OSDMap.h"
 #include "common/WorkQueue.h"
 #include "common/Cond.h"
 
-class OSDMap;
-
 /// work queue to perform work on batches of pgids on multiple CPUs
 class ParallelPGMapper {
 public:
@@ -249,24 +248,71 @@ private:
     }
   };
 
+  using rmap_t = mempool::osdmap_mapping::vector<
+    mempool::osdmap_mapping::vector<pg_t>>;
+
   mempool::osdmap_mapping::map<int64_t,PoolMapping> pools;
-  mempool::osdmap_mapping::vector<
-    mempool::osdmap_mapping::vector<pg_t>> acting_rmap;  // osd -> pg
-  //unused: mempool::osdmap_mapping::vector<std::vector<pg_t>> up_rmap;  // osd -> pg
+  rmap_t acting_rmap;  // osd -> pg
+  rmap_t up_rmap;      // osd -> pg
+  /// pgs whose up set is short or has holes
+  mempool::osdmap_mapping::vector<pg_t> degraded_pgs;
   epoch_t epoch = 0;
   uint64_t num_pgs = 0;
 
+  /// protects the dirty tracking below, which is updated by
+  /// note_incremental() and cleared by a completing MappingJob, and the
+  /// reverse maps above, which note_incremental() reads while a MappingJob
+  /// may be swapping in new ones
+  ceph::mutex dirty_lock = ceph::make_mutex("OSDMapMapping::dirty_lock");
+  /// pgs and whole pools that may map differently than our table says,
+  /// each tagged with the epoch that may have remapped it
+  mempool::osdmap_mapping::map<pg_t,epoch_t> dirty_pgs;
+  mempool::osdmap_mapping::map<int64_t,epoch_t> dirty_pools;
+  /// everything needs recomputing, up to and including dirty_all_epoch
+  bool dirty_all = true;
+  epoch_t dirty_all_epoch = 0;
+  /// the last epoch passed to note_incremental()
+  epoch_t noted_epoch = 0;
+
+  /// the rows an incremental MappingJob is about to overwrite, so that
+  /// _finish() can patch the reverse maps instead of rebuilding them
+  struct old_row_t {
+    std::vector<int> acting, up;
+  };
+  mempool::osdmap_mapping::map<pg_t,old_row_t> old_rows;
+  bool rmap_incremental = false;
+  /// a job was started but never finished, so the table has rows the
+  /// reverse maps don't reflect
+  bool rmap_stale = false;
+
+  void _mark_all_dirty(epoch_t e) {
+    dirty_all = true;
+    dirty_all_epoch = std::max(dirty_all_epoch, e);
+    dirty_pgs.clear();
+    dirty_pools.clear();
+  }
+  void _note_osd_pgs(const OSDMap& prev,
+		     const std::set<int>& osds,
+		     bool include_degraded,
+		     epoch_t e);
+  void _note_rmap_pgs(const rmap_t& rmap, const std::set<int>& osds, epoch_t e);
+  bool _get_dirty_pgs(const OSDMap& osdmap, std::vector<pg_t> *pgs);
+  void _clear_dirty(epoch_t e);
+
   void _init_mappings(const OSDMap& osdmap);
   void _update_range(
     const OSDMap& map,
     int64_t pool,
     unsigned pg_begin, unsigned pg_end);
 
-  void _build_rmap(const OSDMap& osdmap);
+  void _build_rmap(const OSDMap& osdmap,
+		   rmap_t *acting,
+		   rmap_t *up,
+		   mempool::osdmap_mapping::vector<pg_t> *degraded);
+  void _patch_rmap(const OSDMap& osdmap);
 
-  void _start(const OSDMap& osdmap) {
-    _init_mappings(osdmap);
-  }
+  /// @param dirty the only pgs that will be recomputed, or nullptr for all
+  void _start(const OSDMap& osdmap, const std::vector<pg_t> *dirty = nullptr);
   void _finish(const OSDMap& osdmap);
 
   void _dump();
@@ -275,11 +321,16 @@ private:
 
   struct MappingJob : public ParallelPGMapper::Job {
     OSDMapMapping *mapping;
-    MappingJob(const OSDMap *osdmap, OSDMapMapping *m)
+    MappingJob(const OSDMap *osdmap, OSDMapMapping *m,
+	       const std::vector<pg_t> *dirty = nullptr)
       : Job(osdmap), mapping(m) {
-      mapping->_start(*osdmap);
+      mapping->_start(*osdmap, dirty);
+    }
+    void process(const std::vector<pg_t>& pgs) override {
+      for (auto& pgid : pgs) {
+	mapping->_update_range(*osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
+      }
     }
-    void process(const std::vector<pg_t>& pgs) override {}
     void process(int64_t pool, unsigned ps_begin, unsigned ps_end) override {
       mapping->_update_range(*osdmap, pool, ps_begin, ps_end);
     }
@@ -290,6 +341,8 @@ private:
   friend class OSDMapTest;
   // for testing only
   void update(const OSDMap& map);
+  /// like update(), but only recompute what note_incremental() flagged
+  void update_dirty(const OSDMap& map);
 
 public:
   void get(pg_t pgid,
@@ -332,14 +385,28 @@ public:
 
   void update(const OSDMap& map, pg_t pgid);
 
+  /**
+   * record which pgs the incremental may remap
+   *
+   * Must be called with the map @inc applies to, before it is applied, for
+   * every epoch in sequence.  The next start_update() then only recomputes
+   * the pgs and pools that could have changed since the mapping was last
+   * completed, instead of every pg in the map.  Changes we can't reason
+   * about cheaply (a new crush map, max_osd, osds being marked in) fall back
+   * to a full recompute.
+   */
+  void note_incremental(const OSDMap& prev, const OSDMap::Incremental& inc);
+
+  /// forget the incremental state; the next update recomputes everything
+  void mark_all_dirty(epoch_t e) {
+    std::lock_guard l(dirty_lock);
+    _mark_all_dirty(e);
+  }
+
   std::unique_ptr<MappingJob> start_update(
     const OSDMap& map,
     ParallelPGMapper& mapper,
-    unsigned pgs_per_item) {
-    std::unique_ptr<MappingJob> job(new MappingJob(&map, this));
-    mapper.queue(job.get(), pgs_per_item, {});
-    return job;
-  }
+    unsigned pgs_per_item);
 
   epoch_t get_epoch() const {
     return epoch;
@@ -0,0 +1,87 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <boost/lockfree/queue.hpp>
+
+#include "common/ceph_time.h"
+#include "osd/osd_types.h"
+
+/**
+ * OSDShardReadyQueue
+ *
+ * With osd_op_ready_queue_batch set, a worker dequeues several items from
+ * the scheduler under one shard_lock acquisition.  Each item is appended to
+ * its slot's to_process, exactly as a single dequeue would, so per-pg order
+ * and the scheduler's accounting are unchanged.  For every such item the
+ * worker records the slot here; an entry is a promise to run the next item
+ * of that slot.  The owning worker consumes its entries without contending
+ * on the scheduler, and idle workers of this or another shard steal them.
+ *
+ * There is one lock-free queue per worker thread of the shard.
+ */
+class OSDShardReadyQueue {
+public:
+  struct entry_t {
+    spg_t token;
+    ceph::mono_time stamp;   ///< when the item was dequeued, for residency
+  };
+
+  OSDShardReadyQueue(unsigned threads, size_t reserve) {
+    for (unsigned i = 0; i < threads; ++i) {
+      queues.push_back(std::make_unique<boost::lockfree::queue<entry_t>>(reserve));
+    }
+  }
+
+  /// may be true briefly while an entry is being pushed; never false while
+  /// an entry can be popped
+  bool has_ready() const {
+    return num_ready.load(std::memory_order_acquire) > 0;
+  }
+  unsigned get_num_ready() const {
+    return num_ready.load(std::memory_order_acquire);
+  }
+
+  void push(unsigned thread, spg_t token) {
+    // count the entry before it's visible, so a thief that pops it right
+    // away can't take num_ready below the number of entries
+    num_ready.fetch_add(1, std::memory_order_release);
+    queues[thread % queues.size()]->push({token, ceph::mono_clock::now()});
+  }
+
+  /// take an entry from thread's own queue, else from a sibling's
+  bool pop(unsigned thread, entry_t *e, bool *stolen) {
+    if (!has_ready()) {
+      return false;
+    }
+    for (unsigned i = 0; i < queues.size(); ++i) {
+      auto& q = queues[(thread + i) % queues.size()];
+      if (q->pop(*e)) {
+	num_ready.fetch_sub(1, std::memory_order_release);
+	*stolen = i > 0;
+	return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  std::vector<std::unique_ptr<boost::lockfree::queue<entry_t>>> queues;
+  /// entries across queues, counted before push and after pop, so it is
+  /// never less than the number of entries that can be popped
+  std::atomic<unsigned> num_ready = 0;
+};
@@ -22,6 +22,7 @@
 #include "osd_types.h"
 #include "os/ObjectStore.h"
 #include <list>
+#include <boost/unordered/unordered_flat_set.hpp>
 
 #ifdef WITH_SEASTAR
 #include <seastar/core/future.hh>
@@ -140,16 +141,87 @@ struct PGLog : DoutPrefixProvider {
   };
   using LogEntryHandlerRef = std::unique_ptr<LogEntryHandler>;
 
+  /**
+   * log_index_t - open addressing index of pointers into the log
+   *
+   * The key is read from the indexed entry instead of being copied
+   * into the index, so an indexed entry costs a pointer plus a byte of
+   * metadata in a flat table, and indexing or trimming it does not
+   * allocate once the table has grown to the size of the log.  Entries
+   * must be unindexed before they go away.
+   */
+  template <typename T, auto Key>
+  class log_index_t {
+    using key_t = std::remove_cvref_t<decltype(std::declval<const T&>().*Key)>;
+    struct hasher {
+      using is_transparent = void;
+      size_t operator()(const key_t &k) const {
+	return std::hash<key_t>()(k);
+      }
+      size_t operator()(const T *e) const {
+	return (*this)(e->*Key);
+      }
+    };
+    struct key_equal {
+      using is_transparent = void;
+      bool operator()(const T *a, const T *b) const {
+	return a->*Key == b->*Key;
+      }
+      bool operator()(const key_t &k, const T *e) const {
+	return k == e->*Key;
+      }
+      bool operator()(const T *e, const key_t &k) const {
+	return e->*Key == k;
+      }
+    };
+    boost::unordered_flat_set<T*, hasher, key_equal,
+			      mempool::osd_pglog::pool_allocator<T*>> entries;
+
+  public:
+    size_t size() const {
+      return entries.size();
+    }
+    bool empty() const {
+      return entries.empty();
+    }
+    size_t count(const key_t &k) const {
+      return entries.count(k);
+    }
+    /// @return the entry indexed under k, or nullptr
+    T *find(const key_t &k) const {
+      auto p = entries.find(k);
+      return p == entries.end() ? nullptr : *p;
+    }
+    /// index e, replacing any entry with the same key
+    void insert_or_assign(T *e) {
+      auto [p, inserted] = entries.insert(e);
+      if (!inserted && *p != e) {
+	entries.erase(p);
+	entries.insert(e);
+      }
+    }
+    void erase(const key_t &k) {
+      entries.erase(k);
+    }
+    void clear() {
+      entries.clear();
+    }
+    void reserve(size_t n) {
+      entries.reserve(n);
+    }
+  };
+
 public:
   /**
    * IndexLog - adds in-memory index of the log, by oid.
    * plus some methods to manipulate it all.
    */
   struct IndexedLog : public pg_log_t {
-    mutable ceph::unordered_map<hobject_t,pg_log_entry_t*> objects;  // ptrs into log.  be careful!
-    mutable ceph::unordered_map<osd_reqid_t,pg_log_entry_t*> caller_ops;
+    // ptrs into log.  be careful!
+    mutable log_index_t<pg_log_entry_t, &pg_log_entry_t::soid> objects;
+    mutable log_index_t<pg_log_entry_t, &pg_log_entry_t::reqid> caller_ops;
     mutable ceph::unordered_multimap<osd_reqid_t,pg_log_entry_t*> extra_caller_ops;
-    mutable ceph::unordered_map<osd_reqid_t,pg_log_dup_t*> dup_index;
+    mutable log_index_t<pg_log_dup_t, &pg_log_dup_t::reqid> dup_index;
 
     // recovery pointers
     std::list<pg_log_entry_t>::iterator complete_to; // not inclusive of referenced item
@@ -349,12 +421,11 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_CALLER_OPS)) {
         index_caller_ops();
       }
-      auto p = caller_ops.find(r);
-      if (p != caller_ops.end()) {
-	*version = p->second->version;
-	*user_version = p->second->user_version;
-	*return_code = p->second->return_code;
-	*op_returns = p->second->op_returns;
+      if (auto e = caller_ops.find(r); e) {
+	*version = e->version;
+	*user_version = e->user_version;
+	*return_code = e->return_code;
+	*op_returns = e->op_returns;
 	return true;
       }
 
@@ -363,7 +434,7 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS)) {
         index_extra_caller_ops();
       }
-      p = extra_caller_ops.find(r);
+      auto p = extra_caller_ops.find(r);
       if (p != extra_caller_ops.end()) {
 	uint32_t idx = 0;
 	for (auto i = p->second->extra_reqids.begin();
@@ -389,12 +460,11 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_DUPS)) {
         index_dups();
       }
-      auto q = dup_index.find(r);
-      if (q != dup_index.end()) {
-	*version = q->second->version;
-	*user_version = q->second->user_version;
-	*return_code = q->second->return_code;
-	*op_returns = q->second->op_returns;
+      if (auto d = dup_index.find(r); d) {
+	*version = d->version;
+	*user_version = d->user_version;
+	*return_code = d->return_code;
+	*op_returns = d->op_returns;
 	return true;
       }
 
@@ -450,16 +520,23 @@ public:
       // IndexedLog (and indirectly through assignment operator)
       if (!to_index) return;
 
-      if (to_index & PGLOG_INDEXED_OBJECTS)
+      // size the indexes for the whole log up front; they keep their
+      // capacity as entries are added and trimmed
+      if (to_index & PGLOG_INDEXED_OBJECTS) {
 	objects.clear();
-      if (to_index & PGLOG_INDEXED_CALLER_OPS)
+	objects.reserve(log.size());
+      }
+      if (to_index & PGLOG_INDEXED_CALLER_OPS) {
 	caller_ops.clear();
+	caller_ops.reserve(log.size());
+      }
       if (to_index & PGLOG_INDEXED_EXTRA_CALLER_OPS)
 	extra_caller_ops.clear();
       if (to_index & PGLOG_INDEXED_DUPS) {
 	dup_index.clear();
+	dup_index.reserve(dups.size());
 	for (auto& i : dups) {
-	  dup_index[i.reqid] = const_cast<pg_log_dup_t*>(&i);
+	  dup_index.insert_or_assign(const_cast<pg_log_dup_t*>(&i));
 	}
       }
 
@@ -472,13 +549,13 @@ public:
 	for (auto i = log.begin(); i != log.end(); ++i) {
 	  if (to_index & PGLOG_INDEXED_OBJECTS) {
 	    if (i->object_is_indexed()) {
-	      objects[i->soid] = const_cast<pg_log_entry_t*>(&(*i));
+	      objects.insert_or_assign(const_cast<pg_log_entry_t*>(&(*i)));
 	    }
 	  }
 
 	  if (to_index & PGLOG_INDEXED_CALLER_OPS) {
 	    if (i->reqid_is_indexed()) {
-	      caller_ops[i->reqid] = const_cast<pg_log_entry_t*>(&(*i));
+	      caller_ops.insert_or_assign(const_cast<pg_log_entry_t*>(&(*i)));
 	    }
 	  }
 
@@ -514,14 +591,14 @@ public:
 
     void index(pg_log_entry_t& e) {
       if ((indexed_data & PGLOG_INDEXED_OBJECTS) && e.object_is_indexed()) {
-        if (objects.count(e.soid) == 0 ||
-            objects[e.soid]->version < e.version)
-          objects[e.soid] = &e;
+        auto p = objects.find(e.soid);
+        if (!p || p->version < e.version)
+          objects.insert_or_assign(&e);
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
 	// divergent merge_log indexes new before unindexing old
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &e;
+	  caller_ops.insert_or_assign(&e);
         }
       }
       if (indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS) {
@@ -544,16 +621,15 @@ public:
     void unindex(const pg_log_entry_t& e) {
       // NOTE: this only works if we remove from the _tail_ of the log!
       if (indexed_data & PGLOG_INDEXED_OBJECTS) {
-	auto it = objects.find(e.soid);
-        if (it != objects.end() && it->second->version == e.version)
-          objects.erase(it);
+	auto p = objects.find(e.soid);
+        if (p && p->version == e.version)
+          objects.erase(e.soid);
       }
       if (e.reqid_is_indexed()) {
         if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
-	  auto it = caller_ops.find(e.reqid);
 	  // divergent merge_log indexes new before unindexing old
-          if (it != caller_ops.end() && it->second == &e)
-            caller_ops.erase(it);
+          if (caller_ops.find(e.reqid) == &e)
+            caller_ops.erase(e.reqid);
         }
       }
       if (indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS) {
@@ -574,16 +650,13 @@ public:
 
     void index(pg_log_dup_t& e) {
       if (indexed_data & PGLOG_INDEXED_DUPS) {
-	dup_index[e.reqid] = &e;
+	dup_index.insert_or_assign(&e);
       }
     }
 
     void unindex(const pg_log_dup_t& e) {
       if (indexed_data & PGLOG_INDEXED_DUPS) {
-	auto i = dup_index.find(e.reqid);
-	if (i != dup_index.end()) {
-	  dup_index.erase(i);
-	}
+	dup_index.erase(e.reqid);
       }
     }
 
@@ -609,11 +682,11 @@ public:
 
       // to our index
       if ((indexed_data & PGLOG_INDEXED_OBJECTS) && e.object_is_indexed()) {
-        objects[e.soid] = &(log.back());
+        objects.insert_or_assign(&(log.back()));
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &(log.back());
+	  caller_ops.insert_or_assign(&(log.back()));
         }
       }
 
@@ -1058,20 +1131,20 @@ protected:
 		       << " last_divergent_update: " << last_divergent_update
 		       << dendl;
 
-    auto objiter = log.objects.find(hoid);
-    if (objiter != log.objects.end() &&
-	objiter->second->version >= first_divergent_update) {
+    auto objentry = log.objects.find(hoid);
+    if (objentry &&
+	objentry->version >= first_divergent_update) {
       /// Case 1)
       ldpp_dout(dpp, 10) << __func__ << ": more recent entry found: "
-			 << *objiter->second << ", already merged" << dendl;
+			 << *objentry << ", already merged" << dendl;
 
-      ceph_assert(objiter->second->version > last_divergent_update);
+      ceph_assert(objentry->version > last_divergent_update);
 
       // ensure missing has been updated appropriately
-      if (objiter->second->is_update() ||
-	  (missing.may_include_deletes && objiter->second->is_delete())) {
+      if (objentry->is_update() ||
+	  (missing.may_include_deletes && objentry->is_delete())) {
 	ceph_assert(missing.is_missing(hoid) &&
-	       missing.get_items().at(hoid).need == objiter->second->version);
+	       missing.get_items().at(hoid).need == objentry->version);
       } else {
 	ceph_assert(!missing.is_missing(hoid));
       }
@@ -417,7 +417,7 @@ void PrimaryLogPG::on_local_recover(
   if (!is_delete && recovery_state.get_pg_log().get_missing().is_missing(recovery_info.soid) &&
       recovery_state.get_pg_log().get_missing().get_items().find(recovery_info.soid)->second.need > recovery_info.version) {
     ceph_assert(is_primary());
-    const pg_log_entry_t *latest = recovery_state.get_pg_log().get_log().objects.find(recovery_info.soid)->second;
+    const pg_log_entry_t *latest = recovery_state.get_pg_log().get_log().objects.find(recovery_info.soid);
     if (latest->op == pg_log_entry_t::LOST_REVERT &&
 	latest->reverting_to == recovery_info.version) {
       dout(10) << " got old revert version " << recovery_info.version
@@ -533,6 +533,22 @@ void PrimaryLogPG::schedule_recovery_work(
     recovery_state.get_recovery_op_priority());
 }
 
+void PrimaryLogPG::schedule_delayed_work(
+  GenContext<ThreadPool::TPHandle&> *c,
+  ceph::timespan delay)
+{
+  PGRef pg = this;
+  auto o = osd;
+  // the recovery context runs with the pg lock already held
+  auto blessed = bless_unlocked_gencontext(c);
+  osd->mono_timer.add_event(
+    delay,
+    [pg, o, blessed]() {
+      // latency sensitive and cheap: skip the background queues
+      o->queue_recovery_context(pg.get(), blessed, 0, CEPH_MSG_PRIO_HIGH);
+    });
+}
+
 void PrimaryLogPG::replica_clear_repop_obc(
   const vector<pg_log_entry_t> &logv,
   ObjectStore::Transaction &t)
@@ -11756,10 +11772,10 @@ void PrimaryLogPG::populate_obc_watchers(ObjectContextRef obc)
   auto it_objects = recovery_state.get_pg_log().get_log().objects.find(obc->obs.oi.soid);
   ceph_assert((recovering.count(obc->obs.oi.soid) ||
 	  !is_missing_object(obc->obs.oi.soid)) ||
-	 (it_objects != recovery_state.get_pg_log().get_log().objects.end() && // or this is a revert... see recover_primary()
-	  it_objects->second->op ==
+	 (it_objects && // or this is a revert... see recover_primary()
+	  it_objects->op ==
 	    pg_log_entry_t::LOST_REVERT &&
-	  it_objects->second->reverting_to ==
+	  it_objects->reverting_to ==
 	    obc->obs.oi.version));
 
   dout(10) << "populate_obc_watchers " << obc->obs.oi.soid << dendl;
@@ -11881,8 +11897,8 @@ ObjectContextRef PrimaryLogPG::get_object_context(
   ceph_assert(
     attrs || !recovery_state.get_pg_log().get_missing().is_missing(soid) ||
     // or this is a revert... see recover_primary()
-    (it_objects != recovery_state.get_pg_log().get_log().objects.end() &&
-      it_objects->second->op ==
+    (it_objects &&
+      it_objects->op ==
       pg_log_entry_t::LOST_REVERT));
   ObjectContextRef obc = object_contexts.lookup(soid);
   osd->logger->inc(l_osd_object_ctx_cache_total);
@@ -13443,8 +13459,8 @@ uint64_t PrimaryLogPG::recover_primary(uint64_t max, ThreadPool::TPHandle &handl
     version_t v = p->first;
 
     auto it_objects = recovery_state.get_pg_log().get_log().objects.find(p->second);
-    if (it_objects != recovery_state.get_pg_log().get_log().objects.end()) {
-      latest = it_objects->second;
+    if (it_objects) {
+      latest = it_objects;
       ceph_assert(latest->is_update() || latest->is_delete());
       soid = latest->soid;
     } else {
@@ -564,6 +564,10 @@ public:
     GenContext<ThreadPool::TPHandle&> *c,
     uint64_t cost) override;
 
+  void schedule_delayed_work(
+    GenContext<ThreadPool::TPHandle&> *c,
+    ceph::timespan delay) override;
+
   pg_shard_t whoami_shard() const override {
     return pg_whoami;
   }
@@ -133,6 +133,19 @@ PerfCounters *build_osd_logger(CephContext *cct) {
   osd_plb.add_time_avg(l_osd_op_before_dequeue_op_lat, "op_before_dequeue_op_lat",
     "Latency of IO before calling dequeue_op(already dequeued and get PG lock)"); // client io before dequeue_op latency
 
+  osd_plb.add_u64_counter(
+    l_osd_op_ready_batched, "op_ready_batched",
+    "Items dequeued ahead onto a worker's ready queue");
+  osd_plb.add_u64_counter(
+    l_osd_op_ready_stolen, "op_ready_stolen",
+    "Ready items run by another worker of the same shard");
+  osd_plb.add_u64_counter(
+    l_osd_op_ready_stolen_shard, "op_ready_stolen_shard",
+    "Ready items run by a worker of another shard");
+  osd_plb.add_time_avg(
+    l_osd_op_ready_residency_lat, "op_ready_residency_lat",
+    "Time items spent on a worker's ready queue");
+
   osd_plb.add_u64_counter(
     l_osd_sop, "subop", "Suboperations");
   osd_plb.add_u64_counter(
@@ -43,6 +43,11 @@ enum {
   l_osd_op_before_queue_op_lat,
   l_osd_op_before_dequeue_op_lat,
 
+  l_osd_op_ready_batched,
+  l_osd_op_ready_stolen,
+  l_osd_op_ready_stolen_shard,
+  l_osd_op_ready_residency_lat,
+
   l_osd_sop,
   l_osd_sop_inb,
   l_osd_sop_lat,
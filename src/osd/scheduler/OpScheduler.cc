@@ -47,6 +47,22 @@ OpSchedulerRef make_scheduler(
   }
 }
 
+unsigned OpScheduler::dequeue_batch(
+  unsigned max, std::vector<OpSchedulerItem> &out)
+{
+  unsigned n = 0;
+  while (n < max && !empty()) {
+    WorkItem work_item = dequeue();
+    auto item = std::get_if<OpSchedulerItem>(&work_item);
+    if (!item) {
+      break;
+    }
+    out.push_back(std::move(*item));
+    ++n;
+  }
+  return n;
+}
+
 std::ostream &operator<<(std::ostream &lhs, const OpScheduler &rhs) {
   rhs.print(lhs);
   return lhs;
@@ -16,6 +16,7 @@
 
 #include <ostream>
 #include <variant>
+#include <vector>
 
 #include "common/ceph_context.h"
 #include "common/OpQueue.h"
@@ -46,6 +47,12 @@ public:
   // Return next op to be processed
   virtual WorkItem dequeue() = 0;
 
+  // Move up to max ops that can be processed now to out, in the order
+  // dequeue() would have returned them.  Stops early if the queue runs
+  // empty or the next op is not ready yet.  Returns the number of ops
+  // added to out.
+  virtual unsigned dequeue_batch(unsigned max, std::vector<OpSchedulerItem> &out);
+
   // Dump formatted representation for the queue
   virtual void dump(ceph::Formatter &f) const = 0;
 
@@ -448,20 +448,24 @@ void mClockScheduler::enqueue_high(unsigned priority,
   }
 }
 
+OpSchedulerItem mClockScheduler::dequeue_high()
+{
+  auto iter = high_priority.begin();
+  // invariant: high_priority entries are never empty
+  assert(!iter->second.empty());
+  OpSchedulerItem ret{std::move(iter->second.back())};
+  iter->second.pop_back();
+  if (iter->second.empty()) {
+    // maintain invariant, high priority entries are never empty
+    high_priority.erase(iter);
+  }
+  return ret;
+}
+
 WorkItem mClockScheduler::dequeue()
 {
   if (!high_priority.empty()) {
-    auto iter = high_priority.begin();
-    // invariant: high_priority entries are never empty
-    assert(!iter->second.empty());
-    WorkItem ret{std::move(iter->second.back())};
-    iter->second.pop_back();
-    if (iter->second.empty()) {
-      // maintain invariant, high priority entries are never empty
-      high_priority.erase(iter);
-    }
-    ceph_assert(std::get_if<OpSchedulerItem>(&ret));
-    return ret;
+    return dequeue_high();
   } else {
     mclock_queue_t::PullReq result = scheduler.pull_request();
     if (result.is_future()) {
@@ -479,6 +483,34 @@ WorkItem mClockScheduler::dequeue()
   }
 }
 
+unsigned mClockScheduler::dequeue_batch(
+  unsigned max, std::vector<OpSchedulerItem> &out)
+{
+  unsigned n = 0;
+  while (n < max && !high_priority.empty()) {
+    out.push_back(dequeue_high());
+    ++n;
+  }
+  if (n == max || scheduler.empty()) {
+    return n;
+  }
+  // Pull the rest of the batch against a single timestamp rather than
+  // reading the clock for every op.  The tags are compared with a time no
+  // later than dequeue() would have used, so an op that is ready here is
+  // ready there too and reservations and limits are honoured as before.
+  const auto now = crimson::dmclock::get_time();
+  while (n < max && !scheduler.empty()) {
+    mclock_queue_t::PullReq result = scheduler.pull_request(now);
+    if (!result.is_retn()) {
+      break;
+    }
+    out.push_back(std::move(*result.get_retn().request));
+    ++n;
+  }
+  dout(20) << __func__ << " dequeued " << n << " of max " << max << dendl;
+  return n;
+}
+
 std::string mClockScheduler::display_queues() const
 {
   std::ostringstream out;
@@ -237,6 +237,9 @@ public:
   // Return an op to be dispatch
   WorkItem dequeue() final;
 
+  // Return up to max ops to be dispatched, see dequeue_batch() in OpScheduler
+  unsigned dequeue_batch(unsigned max, std::vector<OpSchedulerItem> &out) final;
+
   // Returns if the queue is empty
   bool empty() const final {
     return scheduler.empty() && high_priority.empty();
@@ -264,6 +267,9 @@ public:
 private:
   // Enqueue the op to the high priority queue
   void enqueue_high(unsigned prio, OpSchedulerItem &&item, bool front = false);
+
+  // Dequeue the next op from the (non-empty) high priority queue
+  OpSchedulerItem dequeue_high();
 };
 
 }
@@ -0,0 +1,136 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#include <algorithm>
+
+#include "cls/rgw/cls_rgw_const.h"
+
+#include "rgw_bucket_list_merge.h"
+
+namespace rgw::bucket_list {
+
+ShardMerge::ShardMerge(ShardReader& reader,
+		       std::vector<rgw_cls_list_ret>&& results,
+		       size_t low_water)
+  : reader(reader), low_water(low_water), shards(results.size())
+{
+  for (size_t i = 0; i < shards.size(); ++i) {
+    shards[i].result = std::move(results[i]);
+    shards[i].cursor = shards[i].result.dir.m.begin();
+  }
+  heap.reserve(shards.size());
+  matched.reserve(shards.size());
+  for (size_t i = 0; i < shards.size(); ++i) {
+    if (!shards[i].at_end()) {
+      heap.push_back(i);
+    }
+  }
+  std::make_heap(heap.begin(), heap.end(),
+		 [this] (size_t a, size_t b) { return greater(a, b); });
+}
+
+ShardMerge::~ShardMerge()
+{
+  // the page may be full before a read ahead is needed; leave it to
+  // finish on its own
+  for (size_t i = 0; i < shards.size(); ++i) {
+    if (shards[i].reading) {
+      reader.cancel(i);
+    }
+  }
+}
+
+bool ShardMerge::greater(size_t a, size_t b) const
+{
+  int c = shards[a].name().compare(shards[b].name());
+  return c > 0 || (c == 0 && a > b);
+}
+
+// replace a drained, truncated shard's chunk with its next one, reading
+// it now if it was not read ahead
+int ShardMerge::refill(size_t idx)
+{
+  Shard& s = shards[idx];
+  if (!s.reading) {
+    int r = reader.start(idx, s.result.marker);
+    if (r < 0) {
+      return r;
+    }
+    ++nreads;
+  }
+  s.reading = false;
+  rgw_cls_list_ret next;
+  int r = reader.finish(idx, &next);
+  // an empty but truncated chunk just moves the marker forward
+  if (r < 0 && r != RGWBIAdvanceAndRetryError) {
+    return r;
+  }
+  if (next.is_truncated && !(s.result.marker < next.marker)) {
+    // reading on from the same marker would return the same chunk; stop
+    // the page here, the next one starts after the last entry returned
+    s.stuck = true;
+    return 0;
+  }
+  retired.push_back(std::move(s.result));
+  s.result = std::move(next);
+  s.cursor = s.result.dir.m.begin();
+  return 0;
+}
+
+int ShardMerge::advance(bool want_more, bool* stopped)
+{
+  auto cmp = [this] (size_t a, size_t b) { return greater(a, b); };
+  *stopped = false;
+
+  // pull every shard positioned at this name before advancing any of
+  // them, since advancing (and refilling) invalidates name
+  matched.clear();
+  const std::string& name = this->name();
+  while (!heap.empty() && shards[heap.front()].name() == name) {
+    std::pop_heap(heap.begin(), heap.end(), cmp);
+    matched.push_back(heap.back());
+    heap.pop_back();
+  }
+
+  for (auto idx : matched) {
+    Shard& s = shards[idx];
+    ++s.cursor;
+    while (s.at_end() && s.can_continue()) {
+      int r = refill(idx);
+      if (r < 0) {
+	return r;
+      }
+    }
+    if (s.at_end() && s.result.is_truncated) {
+      // we cannot be certain that none of the next entries comes from
+      // this shard; S3 and swift allow returning fewer than requested
+      *stopped = true;
+      return 0;
+    }
+    if (!s.at_end()) {
+      heap.push_back(idx);
+      std::push_heap(heap.begin(), heap.end(), cmp);
+    }
+    if (want_more && !s.reading && s.can_continue() &&
+	s.remaining() < low_water) {
+      // a failed read ahead is retried when the shard drains
+      if (reader.start(idx, s.result.marker) == 0) {
+	s.reading = true;
+	++nreads;
+      }
+    }
+  }
+  return 0;
+}
+
+bool ShardMerge::is_truncated() const
+{
+  for (auto& s : shards) {
+    if (!s.at_end() || s.result.is_truncated) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace rgw::bucket_list
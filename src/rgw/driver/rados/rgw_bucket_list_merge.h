@@ -0,0 +1,111 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#pragma once
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include "cls/rgw/cls_rgw_ops.h"
+
+namespace rgw::bucket_list {
+
+/// Reads the chunks of the index shards a ShardMerge is merging.  At most
+/// one read per shard is outstanding.
+class ShardReader {
+ public:
+  virtual ~ShardReader() = default;
+  /// start reading the chunk of shard @idx that follows @marker
+  virtual int start(size_t idx, const cls_rgw_obj_key& marker) = 0;
+  /// wait for the read started on shard @idx and move its result out
+  virtual int finish(size_t idx, rgw_cls_list_ret* result) = 0;
+  /// give up on the read started on shard @idx without waiting for it
+  virtual void cancel(size_t idx) = 0;
+};
+
+/// Merges the sorted listings of several bucket index shards into one
+/// ordered stream for cls_bucket_list_ordered().  A truncated shard that
+/// runs dry is continued from the marker its osd returned, and its next
+/// chunk is read ahead once fewer than low_water of its entries are left.
+/// Entries stay valid until the ShardMerge is destroyed.
+class ShardMerge {
+  struct Shard {
+    rgw_cls_list_ret result;
+    decltype(result.dir.m)::iterator cursor;
+    /// the osd returned a truncated chunk without moving the marker
+    bool stuck = false;
+    /// the next chunk is being read ahead
+    bool reading = false;
+
+    const std::string& name() const {
+      return cursor->first;
+    }
+    bool at_end() const {
+      return cursor == result.dir.m.end();
+    }
+    size_t remaining() const {
+      return result.dir.m.end() - cursor;
+    }
+    // a truncated shard can only be continued if the osd told us where
+    // it stopped; older osds do not return a marker
+    bool can_continue() const {
+      return result.is_truncated && !result.marker.empty() && !stuck;
+    }
+  };
+
+  ShardReader& reader;
+  const size_t low_water;
+  std::vector<Shard> shards;
+  /// min-heap of indexes into shards, ordered by their current entry
+  std::vector<size_t> heap;
+  std::vector<size_t> matched;
+  /// chunks we have moved past, whose entries may still be referenced
+  std::list<rgw_cls_list_ret> retired;
+  uint32_t nreads = 0;
+
+  bool greater(size_t a, size_t b) const;
+  int refill(size_t idx);
+
+ public:
+  /// @param results the first chunk of each shard; the index of a shard
+  ///                in it identifies it to the reader and to callers
+  ShardMerge(ShardReader& reader,
+	     std::vector<rgw_cls_list_ret>&& results,
+	     size_t low_water);
+  ~ShardMerge();
+
+  ShardMerge(const ShardMerge&) = delete;
+  ShardMerge& operator=(const ShardMerge&) = delete;
+
+  bool empty() const {
+    return heap.empty();
+  }
+  /// the shard holding the next entry in order
+  size_t top() const {
+    return heap.front();
+  }
+  const std::string& name() const {
+    return shards[top()].name();
+  }
+  rgw_bucket_dir_entry& entry() {
+    return shards[top()].cursor->second;
+  }
+
+  /// Move every shard positioned at the current name past it, reading
+  /// further chunks as needed.  Sets @stopped when a truncated shard ran
+  /// dry that can't be continued: later entries might belong to it, so
+  /// the page has to end here.  With @want_more, shards that are running
+  /// low read their next chunk ahead.
+  int advance(bool want_more, bool* stopped);
+
+  /// whether any shard has entries left, here or on its osd
+  bool is_truncated() const;
+
+  /// the chunks read beyond the first one of each shard
+  uint32_t reads() const {
+    return nreads;
+  }
+};
+
+} // namespace rgw::bucket_list
@@ -0,0 +1,319 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#include "rgw_obj_data_cache.h"
+
+#include <algorithm>
+#include <bit>
+
+#include "common/ceph_context.h"
+#include "common/dout.h"
+#include "common/perf_counters.h"
+#include "rgw_perf_counters.h"
+
+#define dout_subsys ceph_subsys_rgw
+#undef dout_prefix
+#define dout_prefix *_dout << "rgw obj data cache: "
+
+RGWObjDataCache::FrequencySketch::FrequencySketch(uint64_t width)
+{
+  width = std::bit_ceil(std::max<uint64_t>(width, 64));
+  table.resize(width * depth);
+  mask = width - 1;
+  // age the counters after ~10 accesses per counter, so the sketch tracks
+  // recent popularity rather than all time counts
+  sample_size = width * 10;
+}
+
+size_t RGWObjDataCache::FrequencySketch::index(uint64_t hash, unsigned row) const
+{
+  static constexpr std::array<uint64_t, depth> seeds = {
+    0xc3a5c85c97cb3127ull, 0xb492b66fbe98f273ull,
+    0x9ae16a3b2f90404full, 0xcbf29ce484222325ull,
+  };
+  uint64_t h = (hash + seeds[row]) * seeds[row];
+  h ^= h >> 32;
+  return row * (mask + 1) + (h & mask);
+}
+
+void RGWObjDataCache::FrequencySketch::increment(uint64_t hash)
+{
+  for (unsigned row = 0; row < depth; ++row) {
+    auto& c = table[index(hash, row)];
+    if (c < max_count) {
+      ++c;
+    }
+  }
+  if (++additions >= sample_size) {
+    reset();
+  }
+}
+
+unsigned RGWObjDataCache::FrequencySketch::estimate(uint64_t hash) const
+{
+  unsigned count = max_count;
+  for (unsigned row = 0; row < depth; ++row) {
+    count = std::min<unsigned>(count, table[index(hash, row)]);
+  }
+  return count;
+}
+
+void RGWObjDataCache::FrequencySketch::reset()
+{
+  for (auto& c : table) {
+    c >>= 1;
+  }
+  additions /= 2;
+}
+
+RGWObjDataCache::RGWObjDataCache(CephContext *cct, uint64_t max_bytes,
+                                 uint64_t max_obj_size,
+                                 ceph::timespan head_ttl)
+  : cct(cct), max_obj_size(max_obj_size), head_ttl(head_ttl)
+{
+  const uint64_t shard_bytes = max_bytes / num_shards;
+  // size the sketch for the number of entries the shard can hold when the
+  // objects are a quarter of the maximum size
+  const uint64_t shard_entries =
+      shard_bytes / std::max<uint64_t>(max_obj_size / 4, 1);
+  for (auto& shard : shards) {
+    shard.max_bytes = shard_bytes;
+    shard.sketch.emplace(std::min<uint64_t>(shard_entries, 1 << 20));
+  }
+
+  PerfCountersBuilder pcb(cct, "rgw_obj_data_cache",
+                          l_rgw_obj_cache_first, l_rgw_obj_cache_last);
+  pcb.set_prio_default(PerfCountersBuilder::PRIO_USEFUL);
+  pcb.add_u64_counter(l_rgw_obj_cache_hit, "hit", "Object data cache hits");
+  pcb.add_u64_counter(l_rgw_obj_cache_miss, "miss", "Object data cache misses");
+  pcb.add_u64_counter(l_rgw_obj_cache_stale, "stale",
+                      "Entries dropped because the object was rewritten");
+  pcb.add_u64_counter(l_rgw_obj_cache_admit, "admit", "Objects admitted");
+  pcb.add_u64_counter(l_rgw_obj_cache_reject, "reject",
+                      "Objects rejected by the admission filter");
+  pcb.add_u64_counter(l_rgw_obj_cache_evict, "evict", "Entries evicted");
+  pcb.add_u64_counter(l_rgw_obj_cache_invalidate, "invalidate",
+                      "Entries invalidated by writes and deletes");
+  pcb.add_u64_counter(l_rgw_obj_cache_head_hit, "head_hit",
+                      "Reads that took the head state from the cache");
+  pcb.add_u64_counter(l_rgw_obj_cache_head_revalidate, "head_revalidate",
+                      "Reads that had to read the head state again");
+  pcb.add_u64(l_rgw_obj_cache_bytes, "bytes",
+              "Bytes of object data and head state cached",
+              NULL, 0, unit_t(UNIT_BYTES));
+  pcb.add_u64(l_rgw_obj_cache_entries, "entries", "Objects cached");
+  counters = pcb.create_perf_counters();
+  cct->get_perfcounters_collection()->add(counters);
+}
+
+RGWObjDataCache::~RGWObjDataCache()
+{
+  cct->get_perfcounters_collection()->remove(counters);
+  delete counters;
+}
+
+std::string RGWObjDataCache::make_key(std::string_view bucket_key,
+                                      std::string_view obj_oid)
+{
+  std::string key;
+  key.reserve(bucket_key.size() + 1 + obj_oid.size());
+  key.append(bucket_key);
+  key.push_back('\0'); // can't appear in bucket names
+  key.append(obj_oid);
+  return key;
+}
+
+bool RGWObjDataCache::contains(const std::string& key)
+{
+  const uint64_t hash = std::hash<std::string>{}(key);
+  Shard& shard = shard_of(hash);
+  std::lock_guard l{shard.lock};
+  return shard.entries.contains(key);
+}
+
+bool RGWObjDataCache::get(const std::string& key, const Version& version,
+                          bufferlist& bl)
+{
+  const uint64_t hash = std::hash<std::string>{}(key);
+  Shard& shard = shard_of(hash);
+  std::lock_guard l{shard.lock};
+
+  shard.sketch->increment(hash);
+
+  auto iter = shard.entries.find(key);
+  if (iter == shard.entries.end()) {
+    counters->inc(l_rgw_obj_cache_miss);
+    return false;
+  }
+  Entry& entry = iter->second;
+  if (!(entry.version == version)) {
+    ldout(cct, 20) << "dropping stale entry, cached tag=" << entry.version.tag
+        << " current tag=" << version.tag << dendl;
+    erase(shard, iter);
+    counters->inc(l_rgw_obj_cache_stale);
+    counters->inc(l_rgw_obj_cache_miss);
+    return false;
+  }
+
+  shard.lru.splice(shard.lru.begin(), shard.lru, entry.lru_iter);
+  bl = entry.data;
+  counters->inc(l_rgw_obj_cache_hit);
+  return true;
+}
+
+static uint64_t head_charge(const RGWObjDataCache::Head& head)
+{
+  uint64_t bytes = sizeof(head);
+  for (const auto& [name, value] : head.attrs) {
+    bytes += name.size() + value.length();
+  }
+  return bytes;
+}
+
+// whether both stats show the same write, with the same attributes
+static bool same_head(const RGWObjDataCache::Head& a,
+                      const RGWObjDataCache::Head& b)
+{
+  return a.size == b.size && a.mtime == b.mtime && a.attrs == b.attrs;
+}
+
+void RGWObjDataCache::put(const std::string& key, Version version,
+                          bufferlist&& bl, std::optional<Head> head)
+{
+  if (bl.length() > max_obj_size) {
+    return;
+  }
+  const uint64_t len = bl.length() + (head ? head_charge(*head) : 0);
+  const uint64_t hash = std::hash<std::string>{}(key);
+  Shard& shard = shard_of(hash);
+  if (len > shard.max_bytes) {
+    return;
+  }
+  // keep entries contiguous so that senders can use them without copying
+  bl.rebuild();
+
+  std::lock_guard l{shard.lock};
+
+  // an object that is already resident gets its data replaced without
+  // going through admission again
+  bool resident = false;
+  if (auto iter = shard.entries.find(key); iter != shard.entries.end()) {
+    erase(shard, iter);
+    resident = true;
+  }
+  const unsigned frequency = shard.sketch->estimate(hash);
+  while (shard.bytes + len > shard.max_bytes) {
+    auto victim = shard.entries.find(shard.lru.back());
+    if (!resident && frequency <= shard.sketch->estimate(victim->second.hash)) {
+      ldout(cct, 20) << "rejecting " << key << " frequency=" << frequency
+          << dendl;
+      counters->inc(l_rgw_obj_cache_reject);
+      return;
+    }
+    erase(shard, victim);
+    counters->inc(l_rgw_obj_cache_evict);
+  }
+
+  shard.lru.push_front(key);
+  Entry& entry = shard.entries[key];
+  entry.version = std::move(version);
+  entry.data = std::move(bl);
+  entry.head = std::move(head);
+  entry.charge = len;
+  entry.hash = hash;
+  entry.lru_iter = shard.lru.begin();
+  shard.bytes += len;
+
+  counters->inc(l_rgw_obj_cache_admit);
+  counters->inc(l_rgw_obj_cache_bytes, len);
+  counters->inc(l_rgw_obj_cache_entries);
+}
+
+void RGWObjDataCache::invalidate(const std::string& key)
+{
+  const uint64_t hash = std::hash<std::string>{}(key);
+  Shard& shard = shard_of(hash);
+  std::lock_guard l{shard.lock};
+
+  auto iter = shard.entries.find(key);
+  if (iter != shard.entries.end()) {
+    erase(shard, iter);
+    counters->inc(l_rgw_obj_cache_invalidate);
+  }
+}
+
+RGWObjDataCache::HeadLookup
+RGWObjDataCache::get_head(const std::string& key, Head* head, bufferlist* data)
+{
+  const uint64_t hash = std::hash<std::string>{}(key);
+  Shard& shard = shard_of(hash);
+  std::lock_guard l{shard.lock};
+
+  auto iter = shard.entries.find(key);
+  if (iter == shard.entries.end() || !iter->second.head) {
+    return HeadLookup::none;
+  }
+  const Entry& entry = iter->second;
+  if (ceph::coarse_mono_clock::now() - entry.head->stamp >= head_ttl) {
+    counters->inc(l_rgw_obj_cache_head_revalidate);
+    return HeadLookup::stale;
+  }
+  *head = *entry.head;
+  if (entry.head->size == entry.data.length()) {
+    *data = entry.data;
+  }
+  counters->inc(l_rgw_obj_cache_head_hit);
+  return HeadLookup::fresh;
+}
+
+void RGWObjDataCache::revalidate_head(const std::string& key, const Head& head)
+{
+  const uint64_t hash = std::hash<std::string>{}(key);
+  Shard& shard = shard_of(hash);
+  std::lock_guard l{shard.lock};
+
+  auto iter = shard.entries.find(key);
+  if (iter == shard.entries.end() || !iter->second.head) {
+    return;
+  }
+  Entry& entry = iter->second;
+  if (!same_head(*entry.head, head)) {
+    ldout(cct, 20) << "dropping entry with changed head" << dendl;
+    erase(shard, iter);
+    counters->inc(l_rgw_obj_cache_stale);
+    return;
+  }
+  entry.head->epoch = head.epoch;
+  entry.head->stamp = head.stamp;
+}
+
+void RGWObjDataCache::erase(Shard& shard,
+                            std::unordered_map<std::string, Entry>::iterator iter)
+{
+  const uint64_t len = iter->second.charge;
+  shard.bytes -= len;
+  shard.lru.erase(iter->second.lru_iter);
+  shard.entries.erase(iter);
+  counters->dec(l_rgw_obj_cache_bytes, len);
+  counters->dec(l_rgw_obj_cache_entries);
+}
+
+uint64_t RGWObjDataCache::get_size() const
+{
+  uint64_t bytes = 0;
+  for (auto& shard : shards) {
+    std::lock_guard l{shard.lock};
+    bytes += shard.bytes;
+  }
+  return bytes;
+}
+
+uint64_t RGWObjDataCache::get_num_entries() const
+{
+  uint64_t count = 0;
+  for (auto& shard : shards) {
+    std::lock_guard l{shard.lock};
+    count += shard.entries.size();
+  }
+  return count;
+}
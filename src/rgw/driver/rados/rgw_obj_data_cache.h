@@ -0,0 +1,140 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#pragma once
+
+#include <array>
+#include <list>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "include/buffer.h"
+#include "include/common_fwd.h"
+#include "common/ceph_mutex.h"
+#include "common/ceph_time.h"
+
+/*
+ * In-memory read-through cache for the data of small objects.
+ *
+ * Entries are keyed by bucket and object key (including the version
+ * instance), and remember the write they were filled from. Local writes and
+ * deletes drop the entry when they complete the bucket index update.
+ *
+ * An entry can also hold the state of the object's head as read from
+ * RADOS. For head_ttl after that read, a GET takes the head state from the
+ * cache too and doesn't touch RADOS at all; a write through another gateway
+ * can go unnoticed for that long. Once the head state is older, the GET
+ * reads the head's attributes again, which renews the entry if they haven't
+ * changed and drops it if they have.
+ *
+ * Admission is TinyLFU-like: once a shard is full, a new object only
+ * displaces the least recently used entry if a count-min sketch of recent
+ * accesses says it's requested more often.
+ */
+class RGWObjDataCache {
+public:
+  // identifies the object write whose data is cached
+  struct Version {
+    std::string tag; // RGW_ATTR_ID_TAG, unique per write
+    std::string etag;
+    uint64_t size = 0;
+    ceph::real_time mtime;
+
+    bool operator==(const Version&) const = default;
+  };
+
+  // the state of the object's head, as returned by a stat of it
+  struct Head {
+    uint64_t size = 0; // of the head object, not of the whole object
+    ceph::real_time mtime;
+    uint64_t epoch = 0;
+    std::map<std::string, bufferlist> attrs;
+    // when it was read from RADOS
+    ceph::coarse_mono_time stamp;
+  };
+
+  enum class HeadLookup {
+    none,  // not cached
+    stale, // cached, but read more than head_ttl ago
+    fresh,
+  };
+
+  RGWObjDataCache(CephContext *cct, uint64_t max_bytes, uint64_t max_obj_size,
+                  ceph::timespan head_ttl = ceph::timespan::zero());
+  ~RGWObjDataCache();
+
+  static std::string make_key(std::string_view bucket_key,
+                              std::string_view obj_oid);
+
+  uint64_t get_max_obj_size() const { return max_obj_size; }
+
+  // does the cache hold any version of this object?
+  bool contains(const std::string& key);
+  // on hit, share the cached data into bl. an entry for another version is
+  // dropped and counts as a miss
+  bool get(const std::string& key, const Version& version, bufferlist& bl);
+  void put(const std::string& key, Version version, bufferlist&& bl,
+           std::optional<Head> head = std::nullopt);
+  void invalidate(const std::string& key);
+
+  // when fresh, copy out the cached head state, and the object's data if
+  // it's all stored in the head
+  HeadLookup get_head(const std::string& key, Head* head, bufferlist* data);
+  // the head was read again after get_head() found it stale. keep the entry
+  // if the attributes are unchanged, otherwise drop it
+  void revalidate_head(const std::string& key, const Head& head);
+
+  uint64_t get_size() const;
+  uint64_t get_num_entries() const;
+
+private:
+  // 4-bit count-min sketch with periodic aging, as in TinyLFU
+  class FrequencySketch {
+    static constexpr unsigned depth = 4;
+    static constexpr uint8_t max_count = 15;
+    std::vector<uint8_t> table;
+    uint64_t mask;
+    uint64_t additions = 0;
+    uint64_t sample_size;
+
+    size_t index(uint64_t hash, unsigned row) const;
+  public:
+    explicit FrequencySketch(uint64_t width);
+    void increment(uint64_t hash);
+    unsigned estimate(uint64_t hash) const;
+    void reset();
+  };
+
+  struct Entry {
+    Version version;
+    bufferlist data;
+    std::optional<Head> head;
+    uint64_t charge; // data and head bytes
+    uint64_t hash;
+    std::list<std::string>::iterator lru_iter;
+  };
+
+  struct Shard {
+    mutable ceph::mutex lock = ceph::make_mutex("RGWObjDataCache::Shard");
+    std::unordered_map<std::string, Entry> entries;
+    std::list<std::string> lru; // most recently used first
+    uint64_t bytes = 0;
+    uint64_t max_bytes = 0;
+    std::optional<FrequencySketch> sketch;
+  };
+
+  static constexpr size_t num_shards = 16;
+
+  CephContext *cct;
+  const uint64_t max_obj_size;
+  const ceph::timespan head_ttl;
+  std::array<Shard, num_shards> shards;
+  PerfCounters *counters = nullptr;
+
+  Shard& shard_of(uint64_t hash) { return shards[hash % num_shards]; }
+  void erase(Shard& shard, std::unordered_map<std::string, Entry>::iterator iter);
+};
@@ -21,6 +21,7 @@
 #include "common/Formatter.h"
 #include "common/Throttle.h"
 #include "common/BackTrace.h"
+#include "common/async/completion.h"
 
 #include "rgw_sal.h"
 #include "rgw_zone.h"
@@ -50,6 +51,7 @@
 #include "rgw_worker.h"
 #include "rgw_notify.h"
 #include "rgw_http_errors.h"
+#include "rgw_bucket_list_merge.h"
 
 #undef fork // fails to compile RGWPeriod::fork() below
 
@@ -89,6 +91,7 @@
 #include "compressor/Compressor.h"
 
 #include "rgw_d3n_datacache.h"
+#include "rgw_obj_data_cache.h"
 
 #ifdef WITH_LTTNG
 #define TRACEPOINT_DEFINE
@@ -1085,6 +1088,7 @@ void RGWRados::finalize()
   delete topic_cache;
   if (d3n_data_cache)
     delete d3n_data_cache;
+  delete obj_data_cache;
 
   if (reshard_wait.get()) {
     reshard_wait->stop();
@@ -1133,6 +1137,15 @@ int RGWRados::init_rados()
     d3n_data_cache->init(cct);
   }
 
+  const auto obj_data_cache_size =
+      cct->_conf.get_val<Option::size_t>("rgw_obj_data_cache_size");
+  if (obj_data_cache_size > 0) {
+    obj_data_cache = new RGWObjDataCache(cct, obj_data_cache_size,
+        cct->_conf.get_val<Option::size_t>("rgw_obj_data_cache_max_obj_size"),
+        std::chrono::seconds(
+            cct->_conf.get_val<uint64_t>("rgw_obj_data_cache_ttl")));
+  }
+
   return ret;
 }
 
@@ -5992,8 +6005,22 @@ int RGWRados::get_obj_state_impl(const DoutPrefixProvider *dpp, RGWObjectCtx *oc
 
   int r = -ENOENT;
 
-  if (!assume_noent) {
-    r = RGWRados::raw_obj_stat(dpp, raw_obj, &s->size, &s->mtime, &s->epoch, &s->attrset, (s->prefetch_data ? &s->data : NULL), NULL, y);
+  // a GET of a small object may find the head's state, and its data, in
+  // the object data cache
+  auto cached = RGWObjDataCache::HeadLookup::none;
+  if (!assume_noent && s->prefetch_data && obj_data_cache) {
+    cached = obj_data_cache_get_head(dpp, bucket_info, obj, sm);
+  }
+
+  if (cached == RGWObjDataCache::HeadLookup::fresh) {
+    r = 0;
+  } else if (!assume_noent) {
+    // the cached data is still good if the head hasn't changed, so only
+    // read its attributes
+    const bool read_data =
+        s->prefetch_data && cached == RGWObjDataCache::HeadLookup::none;
+    sm->head_stamp = ceph::coarse_mono_clock::now();
+    r = RGWRados::raw_obj_stat(dpp, raw_obj, &s->size, &s->mtime, &s->epoch, &s->attrset, (read_data ? &s->data : NULL), NULL, y);
   }
 
   if (r == -ENOENT) {
@@ -6029,6 +6056,16 @@ int RGWRados::get_obj_state_impl(const DoutPrefixProvider *dpp, RGWObjectCtx *oc
     }
   }
 
+  if (cached == RGWObjDataCache::HeadLookup::stale) {
+    RGWObjDataCache::Head head;
+    head.size = s->size;
+    head.mtime = s->mtime;
+    head.epoch = s->epoch;
+    head.attrs = s->attrset;
+    head.stamp = sm->head_stamp;
+    obj_data_cache->revalidate_head(obj_data_cache_key(bucket_info, obj), head);
+  }
+
   iter = s->attrset.find(RGW_ATTR_COMPRESSION);
   const bool compressed = (iter != s->attrset.end());
   if (compressed) {
@@ -6929,10 +6966,11 @@ int RGWRados::Bucket::UpdateIndex::complete(const DoutPrefixProvider *dpp, int64
                                             bool appendable,
                                             bool log_op)
 {
+  RGWRados *store = target->get_store();
+  store->obj_data_cache_invalidate(target->bucket_info, obj);
   if (blind) {
     return 0;
   }
-  RGWRados *store = target->get_store();
   BucketShard *bs = nullptr;
 
   int ret = get_bucket_shard(&bs, dpp, y);
@@ -6981,10 +7019,11 @@ int RGWRados::Bucket::UpdateIndex::complete_del(const DoutPrefixProvider *dpp,
                                                 optional_yield y,
                                                 bool log_op)
 {
+  RGWRados *store = target->get_store();
+  store->obj_data_cache_invalidate(target->bucket_info, obj);
   if (blind) {
     return 0;
   }
-  RGWRados *store = target->get_store();
   BucketShard *bs = nullptr;
 
   int ret = get_bucket_shard(&bs, dpp, y);
@@ -7260,6 +7299,90 @@ int RGWRados::get_obj_iterate_cb(const DoutPrefixProvider *dpp,
   return d->flush(std::move(completed));
 }
 
+/* passes object data through to the client while collecting a copy of it
+ * for the object data cache */
+class ObjDataCacheFillCB : public RGWGetDataCB {
+  RGWGetDataCB *next;
+public:
+  bufferlist data;
+
+  explicit ObjDataCacheFillCB(RGWGetDataCB *next) : next(next) {}
+
+  int handle_data(bufferlist& bl, off_t bl_ofs, off_t bl_len) override {
+    bufferlist part;
+    part.substr_of(bl, bl_ofs, bl_len);
+    data.claim_append(part);
+    return next->handle_data(bl, bl_ofs, bl_len);
+  }
+};
+
+static bool obj_data_cacheable(const RGWObjState *astate, uint64_t max_obj_size)
+{
+  // the cache holds the data as stored, which is only what the client sees
+  // when it's neither compressed nor encrypted
+  return astate->exists &&
+      astate->size > 0 && astate->size <= max_obj_size &&
+      astate->size == astate->accounted_size &&
+      astate->obj_tag.length() > 0 &&
+      !astate->attrset.contains(RGW_ATTR_COMPRESSION) &&
+      !astate->attrset.contains(RGW_ATTR_CRYPT_MODE);
+}
+
+static RGWObjDataCache::Version obj_data_cache_version(const RGWObjState *astate)
+{
+  RGWObjDataCache::Version version;
+  version.tag = astate->obj_tag.to_str();
+  if (auto i = astate->attrset.find(RGW_ATTR_ETAG); i != astate->attrset.end()) {
+    version.etag = i->second.to_str();
+  }
+  version.size = astate->size;
+  version.mtime = astate->mtime;
+  return version;
+}
+
+std::string RGWRados::obj_data_cache_key(const RGWBucketInfo& bucket_info,
+                                         const rgw_obj& obj)
+{
+  return RGWObjDataCache::make_key(bucket_info.bucket.get_key(),
+                                   obj.key.get_oid());
+}
+
+void RGWRados::obj_data_cache_invalidate(const RGWBucketInfo& bucket_info,
+                                         const rgw_obj& obj)
+{
+  if (obj_data_cache) {
+    obj_data_cache->invalidate(obj_data_cache_key(bucket_info, obj));
+    if (!obj.key.instance.empty()) {
+      // a new version may change what a GET without versionId returns
+      rgw_obj current = obj;
+      current.key.instance.clear();
+      obj_data_cache->invalidate(obj_data_cache_key(bucket_info, current));
+    }
+  }
+}
+
+RGWObjDataCache::HeadLookup RGWRados::obj_data_cache_get_head(
+    const DoutPrefixProvider *dpp, const RGWBucketInfo& bucket_info,
+    const rgw_obj& obj, RGWObjStateManifest *sm)
+{
+  RGWObjState *s = &sm->state;
+  RGWObjDataCache::Head head;
+  bufferlist data;
+  const auto found = obj_data_cache->get_head(
+      obj_data_cache_key(bucket_info, obj), &head, &data);
+  if (found == RGWObjDataCache::HeadLookup::fresh) {
+    ldpp_dout(dpp, 20) << "took head state of " << obj
+        << " from object data cache" << dendl;
+    s->size = head.size;
+    s->mtime = head.mtime;
+    s->epoch = head.epoch;
+    s->attrset = std::move(head.attrs);
+    s->data = std::move(data);
+    sm->head_stamp = head.stamp;
+  }
+  return found;
+}
+
 int RGWRados::Object::Read::iterate(const DoutPrefixProvider *dpp, int64_t ofs, int64_t end, RGWGetDataCB *cb,
                                     optional_yield y)
 {
@@ -7268,6 +7391,47 @@ int RGWRados::Object::Read::iterate(const DoutPrefixProvider *dpp, int64_t ofs,
   const uint64_t chunk_size = cct->_conf->rgw_get_obj_max_req_size;
   const uint64_t window_size = cct->_conf->rgw_get_obj_window_size;
 
+  RGWObjDataCache *cache = store->obj_data_cache;
+  std::string cache_key;
+  RGWObjDataCache::Version cache_version;
+  std::optional<RGWObjDataCache::Head> cache_head;
+  std::optional<ObjDataCacheFillCB> fill;
+  if (cache && !params.part_num) {
+    RGWObjStateManifest *sm = nullptr;
+    int r = store->get_obj_state(dpp, &source->get_ctx(), source->get_bucket_info(),
+                                 state.obj, &sm, false, y);
+    if (r < 0) {
+      return r;
+    }
+    const RGWObjState *astate = &sm->state;
+    if (obj_data_cacheable(astate, cache->get_max_obj_size())) {
+      cache_key = obj_data_cache_key(source->get_bucket_info(), source->get_obj());
+      cache_version = obj_data_cache_version(astate);
+      if (state.obj == source->get_obj() && !astate->is_olh) {
+        // later GETs can skip the head if it's cached along with the data,
+        // except when the head is an olh that points at another object
+        cache_head.emplace();
+        cache_head->size = sm->manifest ? sm->manifest->get_head_size()
+                                        : astate->size;
+        cache_head->mtime = astate->mtime;
+        cache_head->epoch = astate->epoch;
+        cache_head->attrs = astate->attrset;
+        cache_head->stamp = sm->head_stamp;
+      }
+
+      bufferlist bl;
+      if (cache->get(cache_key, cache_version, bl)) {
+        ldpp_dout(dpp, 20) << "serving " << state.obj
+            << " from object data cache" << dendl;
+        return cb->handle_data(bl, ofs, end - ofs + 1);
+      }
+      if (ofs == 0 && end + 1 == static_cast<int64_t>(astate->size)) {
+        fill.emplace(cb);
+        cb = &*fill;
+      }
+    }
+  }
+
   auto aio = rgw::make_throttle(window_size, y);
   get_obj_data data(store, cb, &*aio, ofs, y);
 
@@ -7279,7 +7443,15 @@ int RGWRados::Object::Read::iterate(const DoutPrefixProvider *dpp, int64_t ofs,
     return r;
   }
 
-  return data.drain();
+  r = data.drain();
+  if (r < 0) {
+    return r;
+  }
+  if (fill && fill->data.length() == cache_version.size) {
+    cache->put(cache_key, std::move(cache_version), std::move(fill->data),
+               std::move(cache_head));
+  }
+  return 0;
 }
 
 int RGWRados::iterate_obj(const DoutPrefixProvider *dpp, RGWObjectCtx& obj_ctx,
@@ -9388,6 +9560,127 @@ uint32_t RGWRados::calc_ordered_bucket_list_per_shard(uint32_t num_entries,
 }
 
 
+namespace {
+
+// reads the next chunks of the bucket index shards being merged by
+// cls_bucket_list_ordered(); a read started ahead is detached rather
+// than waited for if the page fills up before it is needed
+class RadosShardReader : public rgw::bucket_list::ShardReader {
+  using Waiter = ceph::async::Completion<void(boost::system::error_code)>;
+
+  // shared between the reader and the completion callback, so a read
+  // can outlive the listing that started it
+  struct Read {
+    librados::IoCtx ioctx;
+    librados::AioCompletion* c = nullptr;
+    ceph::mutex mutex = ceph::make_mutex("RadosShardReader::Read");
+    ceph::condition_variable cond;
+    std::unique_ptr<Waiter> waiter;
+    bool done = false;
+    int ret = 0;
+    rgw_cls_list_ret result;
+  };
+
+  const DoutPrefixProvider* dpp;
+  librados::IoCtx& ioctx;
+  const std::vector<std::pair<int, std::string>>& shards;
+  const std::string& prefix;
+  const std::string& delimiter;
+  const uint32_t num_entries;
+  const bool list_versions;
+  optional_yield y;
+  std::vector<std::shared_ptr<Read>> reads;
+
+  static void complete(librados::completion_t, void* arg) {
+    auto holder = static_cast<std::shared_ptr<Read>*>(arg);
+    auto& read = **holder;
+    {
+      std::lock_guard l{read.mutex};
+      read.done = true;
+      read.ret = read.c->get_return_value();
+      read.c->release();
+      read.c = nullptr;
+      if (read.waiter) {
+	ceph::async::post(std::move(read.waiter), boost::system::error_code{});
+      } else {
+	read.cond.notify_all();
+      }
+    }
+    delete holder;
+  }
+
+ public:
+  RadosShardReader(const DoutPrefixProvider* dpp,
+		   librados::IoCtx& ioctx,
+		   const std::vector<std::pair<int, std::string>>& shards,
+		   const std::string& prefix,
+		   const std::string& delimiter,
+		   uint32_t num_entries,
+		   bool list_versions,
+		   optional_yield y)
+    : dpp(dpp), ioctx(ioctx), shards(shards), prefix(prefix),
+      delimiter(delimiter), num_entries(num_entries),
+      list_versions(list_versions), y(y), reads(shards.size())
+  {}
+
+  int start(size_t idx, const cls_rgw_obj_key& marker) override {
+    auto read = std::make_shared<Read>();
+    read->ioctx.dup(ioctx);
+    librados::ObjectReadOperation op;
+    cls_rgw_bucket_list_op(op, marker, prefix, delimiter, num_entries,
+			   list_versions, &read->result);
+    auto holder = new std::shared_ptr<Read>(read);
+    read->c = librados::Rados::aio_create_completion(holder, complete);
+    int ret = read->ioctx.aio_operate(shards[idx].second, read->c, &op,
+				      nullptr);
+    if (ret < 0) {
+      read->c->release();
+      delete holder;
+      ldpp_dout(dpp, 5) << __func__ << ": failed to read shard " <<
+	shards[idx].first << ", r=" << ret << dendl;
+      return ret;
+    }
+    reads[idx] = std::move(read);
+    return 0;
+  }
+
+  int finish(size_t idx, rgw_cls_list_ret* result) override {
+    auto read = std::move(reads[idx]);
+    std::unique_lock l{read->mutex};
+    if (!read->done) {
+      if (y) {
+	// yield the coroutine until the completion callback posts us
+	using namespace boost::asio;
+	boost::system::error_code ec;
+	auto token = y.get_yield_context()[ec];
+	async_completion<spawn::yield_context,
+			 void(boost::system::error_code)> init(token);
+	read->waiter = Waiter::create(y.get_io_context().get_executor(),
+				      std::move(init.completion_handler));
+	l.unlock();
+	init.result.get();
+	l.lock();
+      } else {
+	// work on asio threads should be asynchronous, so warn when they block
+	if (is_asio_thread) {
+	  ldpp_dout(dpp, 20) << "WARNING: blocking librados call" << dendl;
+	}
+	read->cond.wait(l, [&read] { return read->done; });
+      }
+    }
+    *result = std::move(read->result);
+    return read->ret;
+  }
+
+  void cancel(size_t idx) override {
+    // the completion callback holds its own reference to the read
+    reads[idx].reset();
+  }
+}; // RadosShardReader
+
+} // anonymous namespace
+
+
 int RGWRados::cls_bucket_list_ordered(const DoutPrefixProvider *dpp,
                                       RGWBucketInfo& bucket_info,
                                       const rgw::bucket_index_layout_generation& idx_layout,
@@ -9489,61 +9782,14 @@ int RGWRados::cls_bucket_list_ordered(const DoutPrefixProvider *dpp,
     return r;
   }
 
-  // to manage the iterators through each shard's list results
-  struct ShardTracker {
-    const size_t shard_idx;
-    rgw_cls_list_ret& result;
-    const std::string& oid_name;
-    RGWRados::ent_map_t::iterator cursor;
-    RGWRados::ent_map_t::iterator end;
-
-    // manages an iterator through a shard and provides other
-    // accessors
-    ShardTracker(size_t _shard_idx,
-		 rgw_cls_list_ret& _result,
-		 const std::string& _oid_name):
-      shard_idx(_shard_idx),
-      result(_result),
-      oid_name(_oid_name),
-      cursor(_result.dir.m.begin()),
-      end(_result.dir.m.end())
-    {}
-
-    inline const std::string& entry_name() const {
-      return cursor->first;
-    }
-    rgw_bucket_dir_entry& dir_entry() const {
-      return cursor->second;
-    }
-    inline bool is_truncated() const {
-      return result.is_truncated;
-    }
-    inline ShardTracker& advance() {
-      ++cursor;
-      // return a self-reference to allow for chaining of calls, such
-      // as x.advance().at_end()
-      return *this;
-    }
-    inline bool at_end() const {
-      return cursor == end;
-    }
-  }; // ShardTracker
-
-  // add the next unique candidate, or return false if we reach the end
-  auto next_candidate = [] (CephContext *cct, ShardTracker& t,
-                            std::multimap<std::string, size_t>& candidates,
-                            size_t tracker_idx) {
-    if (!t.at_end()) {
-      candidates.emplace(t.entry_name(), tracker_idx);
-    }
-    return;
-  };
-
-  // one tracker per shard requested (may not be all shards)
-  std::vector<ShardTracker> results_trackers;
-  results_trackers.reserve(shard_list_results.size());
+  // the shard id and oid of each shard requested (may not be all shards),
+  // in the order the merge knows them
+  std::vector<std::pair<int, std::string>> shards;
+  std::vector<rgw_cls_list_ret> results;
+  shards.reserve(shard_list_results.size());
+  results.reserve(shard_list_results.size());
   for (auto& r : shard_list_results) {
-    results_trackers.emplace_back(r.first, r.second, shard_oids[r.first]);
+    shards.emplace_back(r.first, shard_oids[r.first]);
 
     // if any *one* shard's result is truncated, the entire result is
     // truncated
@@ -9552,41 +9798,33 @@ int RGWRados::cls_bucket_list_ordered(const DoutPrefixProvider *dpp,
     // unless *all* are shards are cls_filtered, the entire result is
     // not filtered
     *cls_filtered = *cls_filtered && r.second.cls_filtered;
-  }
 
-  // create a map to track the next candidate entry from ShardTracker
-  // (key=candidate, value=index into results_trackers); as we consume
-  // entries from shards, we replace them with the next entries in the
-  // shards until we run out
-  std::multimap<std::string, size_t> candidates;
-  size_t tracker_idx = 0;
-  std::vector<size_t> vidx;
-  vidx.reserve(shard_list_results.size());
-  for (auto& t : results_trackers) {
-    // it's important that the values in the map refer to the index
-    // into the results_trackers vector, which may not be the same
-    // as the shard number (i.e., when not all shards are requested)
-    next_candidate(cct, t, candidates, tracker_idx);
-    ++tracker_idx;
+    results.push_back(std::move(r.second));
   }
 
+  RadosShardReader reader(dpp, ioctx, shards, prefix, delimiter,
+			  num_entries_per_shard, list_versions, y);
+  // a shard with less than a quarter of a chunk left reads its next one
+  // ahead, so it is usually there by the time the shard drains
+  rgw::bucket_list::ShardMerge merge(reader, std::move(results),
+				     std::max(num_entries_per_shard / 4, 1u));
+
   rgw_bucket_dir_entry*
     last_entry_visited = nullptr; // to set last_entry (marker)
   std::map<std::string, bufferlist> updates;
   uint32_t count = 0;
-  while (count < num_entries && !candidates.empty()) {
+  while (count < num_entries && !merge.empty()) {
     r = 0;
-    // select the next entry in lexical order (first key in map);
-    // again tracker_idx is not necessarily shard number, but is index
-    // into results_trackers vector
-    tracker_idx = candidates.begin()->second;
-    auto& tracker = results_trackers.at(tracker_idx);
+    // select the next entry in lexical order; note the index of a shard
+    // in the merge is not necessarily the shard number (i.e., when not
+    // all shards are requested)
+    const auto& [shard_idx, oid_name] = shards[merge.top()];
 
-    const std::string& name = tracker.entry_name();
-    rgw_bucket_dir_entry& dirent = tracker.dir_entry();
+    const std::string& name = merge.name();
+    rgw_bucket_dir_entry& dirent = merge.entry();
 
     ldpp_dout(dpp, 20) << __func__ << ": currently processing " <<
-      dirent.key << " from shard " << tracker.shard_idx << dendl;
+      dirent.key << " from shard " << shard_idx << dendl;
 
     const bool force_check =
       force_check_filter && force_check_filter(dirent.key.name);
@@ -9605,7 +9843,7 @@ int RGWRados::cls_bucket_list_ordered(const DoutPrefixProvider *dpp,
 	" calling check_disk_state bucket=" << bucket_info.bucket <<
 	" entry=" << dirent.key << dendl_bitx;
       r = check_disk_state(dpp, sub_ctx, bucket_info, dirent, dirent,
-			   updates[tracker.oid_name], y);
+			   updates[oid_name], y);
       if (r < 0 && r != -ENOENT) {
 	ldpp_dout(dpp, 0) << __func__ <<
 	  ": check_disk_state for \"" << dirent.key <<
@@ -9635,31 +9873,20 @@ int RGWRados::cls_bucket_list_ordered(const DoutPrefixProvider *dpp,
     } else {
       ldpp_dout(dpp, 10) << __func__ << ": skipping " <<
 	dirent.key.name << "[" << dirent.key.instance << "]" << dendl;
-      last_entry_visited = &tracker.dir_entry();
+      last_entry_visited = &dirent;
     }
 
-    // refresh the candidates map
-    vidx.clear();
+    // instead of stopping the page when a truncated shard runs dry,
+    // continue that one shard from its marker
     bool need_to_stop = false;
-    auto range = candidates.equal_range(name);
-    for (auto i = range.first; i != range.second; ++i) {
-      vidx.push_back(i->second);
-    } 
-    candidates.erase(range.first, range.second);
-    for (auto idx : vidx) {
-      auto& tracker_match = results_trackers.at(idx);
-      tracker_match.advance();
-      next_candidate(cct, tracker_match, candidates, idx);
-      if (tracker_match.at_end() && tracker_match.is_truncated()) {
-        need_to_stop = true;
-        break;
-      }
+    r = merge.advance(count < num_entries, &need_to_stop);
+    if (r < 0) {
+      ldpp_dout(dpp, 0) << "ERROR: " << __func__ <<
+	": failed to continue listing " << bucket_info.bucket <<
+	", r=" << r << dendl;
+      return r;
     }
     if (need_to_stop) {
-      // once we exhaust one shard that is truncated, we need to stop,
-      // as we cannot be certain that one of the next entries needs to
-      // come from that shard; S3 and swift protocols allow returning
-      // fewer than what was requested
       ldpp_dout(dpp, 10) << __func__ <<
 	": stopped accumulating results at count=" << count <<
 	", dirent=\"" << dirent_key <<
@@ -9668,6 +9895,9 @@ int RGWRados::cls_bucket_list_ordered(const DoutPrefixProvider *dpp,
     }
   } // while we haven't provided requested # of result entries
 
+  ldpp_dout(dpp, 10) << __func__ << ": read " << merge.reads() <<
+    " additional shard chunk(s) to fill " << count << " entries" << dendl;
+
   // suggest updates if there are any
   for (auto& miter : updates) {
     if (miter.second.length()) {
@@ -9686,13 +9916,7 @@ int RGWRados::cls_bucket_list_ordered(const DoutPrefixProvider *dpp,
 
   // determine truncation by checking if all the returned entries are
   // consumed or not
-  *is_truncated = false;
-  for (const auto& t : results_trackers) {
-    if (!t.at_end() || t.is_truncated()) {
-      *is_truncated = true;
-      break;
-    }
-  }
+  *is_truncated = merge.is_truncated();
 
   ldpp_dout(dpp, 20) << __func__ <<
     ": returning, count=" << count << ", is_truncated=" << *is_truncated <<
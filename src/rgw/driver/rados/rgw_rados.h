@@ -40,6 +40,7 @@
 #include "rgw_sal_fwd.h"
 #include "rgw_pubsub.h"
 #include "rgw_tools.h"
+#include "rgw_obj_data_cache.h"
 
 struct D3nDataCache;
 
@@ -184,6 +185,9 @@ public:
 struct RGWObjStateManifest {
   RGWObjState state;
   std::optional<RGWObjManifest> manifest;
+  // when the state was read from the head object; a state taken from the
+  // object data cache keeps the time of the read that filled it
+  ceph::coarse_mono_time head_stamp;
 };
 
 class RGWObjectCtx {
@@ -1094,6 +1098,15 @@ public:
   };
 
   D3nDataCache* d3n_data_cache{nullptr};
+  RGWObjDataCache* obj_data_cache{nullptr};
+
+  static std::string obj_data_cache_key(const RGWBucketInfo& bucket_info,
+                                        const rgw_obj& obj);
+  void obj_data_cache_invalidate(const RGWBucketInfo& bucket_info,
+                                 const rgw_obj& obj);
+  RGWObjDataCache::HeadLookup obj_data_cache_get_head(
+      const DoutPrefixProvider *dpp, const RGWBucketInfo& bucket_info,
+      const rgw_obj& obj, RGWObjStateManifest *sm);
 
   int rewrite_obj(RGWBucketInfo& dest_bucket_info, const rgw_obj& obj, const DoutPrefixProvider *dpp, optional_yield y);
   int reindex_obj(rgw::sal::Driver* driver,
@@ -27,6 +27,7 @@ extern "C" {
 #include "common/errno.h"
 #include "common/safe_io.h"
 #include "common/fault_injector.h"
+#include "common/perf_counters_collection.h"
 
 #include "include/util.h"
 
@@ -365,6 +366,7 @@ void usage()
   cout << "                                       bilog trim\n";
   cout << "                                       bilog status\n";
   cout << "   --max-entries=<entries>           max entries for listing operations\n";
+  cout << "   --bench                           with bucket list, time each page instead of listing entries\n";
   cout << "   --metadata-key=<key>              key to retrieve metadata from with metadata get\n";
   cout << "   --remote=<remote>                 zone or zonegroup id of remote gateway\n";
   cout << "   --period=<id>                     period id\n";
@@ -1113,6 +1115,21 @@ log_type get_log_type(const string& type_str) {
   return static_cast<log_type>(0xff);
 }
 
+// cls method calls sent so far by this process, which while listing a
+// bucket are the round trips to its index shards
+static uint64_t get_osdop_calls()
+{
+  uint64_t calls = 0;
+  g_ceph_context->get_perfcounters_collection()->with_counters(
+    [&calls] (const PerfCountersCollectionImpl::CounterMap& by_path) {
+      auto i = by_path.find("objecter.osdop_call");
+      if (i != by_path.end()) {
+	calls = i->second.data->u64;
+      }
+    });
+  return calls;
+}
+
 static void show_user_info(RGWUserInfo& info, Formatter *formatter)
 {
   encode_json("user_info", info, formatter);
@@ -3447,6 +3464,7 @@ int main(int argc, const char **argv)
   bool have_max_read_bytes = false;
   int include_all = false;
   int allow_unordered = false;
+  int bench = false;
 
   int sync_stats = false;
   int reset_stats = false;
@@ -3816,6 +3834,8 @@ int main(int argc, const char **argv)
      // do nothing
     } else if (ceph_argparse_binary_flag(args, i, &allow_unordered, NULL, "--allow-unordered", (char*)NULL)) {
      // do nothing
+    } else if (ceph_argparse_binary_flag(args, i, &bench, NULL, "--bench", (char*)NULL)) {
+     // do nothing
     } else if (ceph_argparse_binary_flag(args, i, &extra_info, NULL, "--extra-info", (char*)NULL)) {
      // do nothing
     } else if (ceph_argparse_binary_flag(args, i, &bypass_gc, NULL, "--bypass-gc", (char*)NULL)) {
@@ -7049,7 +7069,12 @@ int main(int argc, const char **argv)
         cerr << "ERROR: could not init bucket: " << cpp_strerror(-ret) << std::endl;
         return -ret;
       }
-      formatter->open_array_section("entries");
+      if (bench) {
+	formatter->open_object_section("bench");
+	formatter->open_array_section("pages");
+      } else {
+	formatter->open_array_section("entries");
+      }
 
       int count = 0;
 
@@ -7076,14 +7101,24 @@ int main(int argc, const char **argv)
       params.list_versions = true;
       params.allow_unordered = bool(allow_unordered);
 
+      // --bench: per page round trips and latency
+      int pages = 0;
+      uint64_t total_calls = 0;
+      uint64_t max_calls = 0;
+      ceph::timespan total_lat = ceph::timespan::zero();
+      ceph::timespan max_lat = ceph::timespan::zero();
+
       do {
         const int remaining = max_entries - count;
+	const uint64_t calls_before = bench ? get_osdop_calls() : 0;
+	const auto start = ceph::mono_clock::now();
 	ret = bucket->list(dpp(), params, std::min(remaining, paginate_size), results,
 			   null_yield);
         if (ret < 0) {
           cerr << "ERROR: driver->list_objects(): " << cpp_strerror(-ret) << std::endl;
           return -ret;
         }
+	const auto lat = ceph::mono_clock::now() - start;
 	ldpp_dout(dpp(), 20) << "INFO: " << __func__ <<
 	  ": list() returned without error; results.objs.sizie()=" <<
 	  results.objs.size() << "results.is_truncated=" << results.is_truncated << ", marker=" <<
@@ -7091,13 +7126,46 @@ int main(int argc, const char **argv)
 
         count += results.objs.size();
 
-        for (const auto& entry : results.objs) {
-          encode_json("entry", entry, formatter.get());
-        }
+	if (bench) {
+	  const uint64_t calls = get_osdop_calls() - calls_before;
+	  ++pages;
+	  total_calls += calls;
+	  max_calls = std::max(max_calls, calls);
+	  total_lat += lat;
+	  max_lat = std::max(max_lat, lat);
+
+	  formatter->open_object_section("page");
+	  encode_json("entries", results.objs.size(), formatter.get());
+	  encode_json("round_trips", calls, formatter.get());
+	  encode_json("latency_ms",
+		      std::chrono::duration<double, std::milli>(lat).count(),
+		      formatter.get());
+	  formatter->close_section();
+	} else {
+	  for (const auto& entry : results.objs) {
+	    encode_json("entry", entry, formatter.get());
+	  }
+	}
         formatter->flush(cout);
       } while (results.is_truncated && count < max_entries);
       ldpp_dout(dpp(), 20) << "INFO: " << __func__ << ": done" << dendl;
 
+      if (bench) {
+	formatter->close_section(); // pages
+	const double total_ms =
+	  std::chrono::duration<double, std::milli>(total_lat).count();
+	encode_json("num_pages", pages, formatter.get());
+	encode_json("num_entries", count, formatter.get());
+	encode_json("round_trips", total_calls, formatter.get());
+	encode_json("avg_round_trips_per_page",
+		    pages ? double(total_calls) / pages : 0.0, formatter.get());
+	encode_json("max_round_trips_per_page", max_calls, formatter.get());
+	encode_json("avg_latency_ms", pages ? total_ms / pages : 0.0,
+		    formatter.get());
+	encode_json("max_latency_ms",
+		    std::chrono::duration<double, std::milli>(max_lat).count(),
+		    formatter.get());
+      }
       formatter->close_section();
       formatter->flush(cout);
     } /* have bucket_name */
@@ -453,6 +453,12 @@ int rgw::AppMain::init_frontends2(RGWLib* rgwlib)
       dpp->get_cct(), *implicit_tenant_context, env.driver);
   env.ratelimiting = ratelimiter.get();
 
+  if (const auto threads = g_conf().get_val<uint64_t>("rgw_put_obj_pipeline_threads");
+      threads > 0) {
+    put_pipeline_pool.emplace(threads);
+    env.put_pipeline = &put_pipeline_pool->get_io_context();
+  }
+
   int fe_count = 0;
   for (multimap<string, RGWFrontendConfig *>::iterator fiter = fe_map.begin();
        fiter != fe_map.end(); ++fiter, ++fe_count) {
@@ -615,6 +621,9 @@ void rgw::AppMain::shutdown(std::function<void(void)> finalize_async_signals)
   // Do this before closing storage so requests don't try to call into
   // closed storage.
   context_pool->finish();
+  if (put_pipeline_pool) {
+    put_pipeline_pool->finish();
+  }
 
   cfgstore.reset(); // deletes
   DriverManager::close_storage(env.driver);
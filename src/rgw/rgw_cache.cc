@@ -3,27 +3,67 @@
 
 #include "rgw_cache.h"
 #include "rgw_perf_counters.h"
+#include "common/perf_counters.h"
+#include "common/perf_counters_key.h"
 
 #include <errno.h>
+#include <algorithm>
 
 #define dout_subsys ceph_subsys_rgw
 
 using namespace std;
 
+void ObjectCache::set_ctx(CephContext *_cct)
+{
+  cct = _cct;
+  expiry = std::chrono::seconds(cct->_conf.get_val<uint64_t>(
+					      "rgw_cache_expiry_interval"));
+
+  const auto num_shards = std::max<uint64_t>(
+      1, cct->_conf.get_val<uint64_t>("rgw_cache_shards"));
+  const uint64_t lru_size = std::max<int64_t>(cct->_conf->rgw_cache_lru_size, 0);
+  shards.reserve(num_shards);
+  for (uint64_t i = 0; i < num_shards; ++i) {
+    auto shard = std::make_unique<Shard>();
+    // round up so the shards together hold at least rgw_cache_lru_size
+    shard->max_entries = std::max<uint64_t>(
+        1, (lru_size + num_shards - 1) / num_shards);
+
+    const std::string key = ceph::perf_counters::key_create(
+        "rgw_cache", {{"shard", std::to_string(i)}});
+    PerfCountersBuilder pcb(cct, key, l_rgw_cache_shard_first,
+                            l_rgw_cache_shard_last);
+    pcb.set_prio_default(PerfCountersBuilder::PRIO_USEFUL);
+    pcb.add_u64_counter(l_rgw_cache_shard_hit, "cache_hit", "Cache hits");
+    pcb.add_u64_counter(l_rgw_cache_shard_miss, "cache_miss", "Cache miss");
+    pcb.add_u64_counter(l_rgw_cache_shard_evict, "cache_evict",
+                        "Entries evicted to make room for new ones");
+    pcb.add_u64(l_rgw_cache_shard_entries, "cache_entries", "Cached entries");
+    shard->counters = pcb.create_perf_counters();
+    cct->get_perfcounters_collection()->add(shard->counters);
+
+    shards.push_back(std::move(shard));
+  }
+}
+
 int ObjectCache::get(const DoutPrefixProvider *dpp, const string& name, ObjectCacheInfo& info, uint32_t mask, rgw_cache_entry_info *cache_info)
 {
+  if (shards.empty()) {
+    return -ENOENT;
+  }
+  Shard& shard = shard_of(name);
 
-  std::shared_lock rl{lock};
-  std::unique_lock wl{lock, std::defer_lock}; // may be promoted to write lock
+  std::shared_lock rl{shard.lock};
   if (!enabled) {
     return -ENOENT;
   }
-  auto iter = cache_map.find(name);
-  if (iter == cache_map.end()) {
+  auto iter = shard.cache_map.find(name);
+  if (iter == shard.cache_map.end()) {
     ldpp_dout(dpp, 10) << "cache get: name=" << name << " : miss" << dendl;
     if (perfcounter) {
       perfcounter->inc(l_rgw_cache_miss);
     }
+    shard.counters->inc(l_rgw_cache_shard_miss);
     return -ENOENT;
   }
 
@@ -31,47 +71,36 @@ int ObjectCache::get(const DoutPrefixProvider *dpp, const string& name, ObjectCa
        (ceph::coarse_mono_clock::now() - iter->second.info.time_added) > expiry) {
     ldpp_dout(dpp, 10) << "cache get: name=" << name << " : expiry miss" << dendl;
     rl.unlock();
-    wl.lock(); // write lock for expiration
+    std::unique_lock wl{shard.lock}; // write lock for expiration
     // check that wasn't already removed by other thread
-    iter = cache_map.find(name);
-    if (iter != cache_map.end()) {
+    iter = shard.cache_map.find(name);
+    if (iter != shard.cache_map.end()) {
       for (auto &kv : iter->second.chained_entries)
         kv.first->invalidate(kv.second);
-      remove_lru(name, iter->second.lru_iter);
-      cache_map.erase(iter);
+      remove_lru(shard, iter->second.lru_iter);
+      shard.cache_map.erase(iter);
+      shard.counters->set(l_rgw_cache_shard_entries, shard.cache_map.size());
     }
     if (perfcounter) {
       perfcounter->inc(l_rgw_cache_miss);
     }
+    shard.counters->inc(l_rgw_cache_shard_miss);
     return -ENOENT;
   }
 
   ObjectCacheEntry *entry = &iter->second;
 
-  if (lru_counter - entry->lru_promotion_ts > lru_window) {
-    ldpp_dout(dpp, 20) << "cache get: touching lru, lru_counter=" << lru_counter
-                   << " promotion_ts=" << entry->lru_promotion_ts << dendl;
-    rl.unlock();
-    wl.lock(); // write lock for touch_lru()
-    /* need to redo this because entry might have dropped off the cache */
-    iter = cache_map.find(name);
-    if (iter == cache_map.end()) {
-      ldpp_dout(dpp, 10) << "lost race! cache get: name=" << name << " : miss" << dendl;
-      if(perfcounter) perfcounter->inc(l_rgw_cache_miss);
-      return -ENOENT;
-    }
-
-    entry = &iter->second;
-    /* check again, we might have lost a race here */
-    if (lru_counter - entry->lru_promotion_ts > lru_window) {
-      touch_lru(dpp, name, *entry, iter->second.lru_iter);
-    }
+  // CLOCK promotion: only mark the entry, the hand clears it on its next
+  // sweep. Skip the store when it's already set to keep the line shared.
+  if (!entry->referenced.load(std::memory_order_relaxed)) {
+    entry->referenced.store(true, std::memory_order_relaxed);
   }
 
-  ObjectCacheInfo& src = iter->second.info;
+  ObjectCacheInfo& src = entry->info;
   if(src.status == -ENOENT) {
     ldpp_dout(dpp, 10) << "cache get: name=" << name << " : hit (negative entry)" << dendl;
     if (perfcounter) perfcounter->inc(l_rgw_cache_hit);
+    shard.counters->inc(l_rgw_cache_shard_hit);
     return -ENODATA;
   }
   if ((src.flags & mask) != mask) {
@@ -79,6 +108,7 @@ int ObjectCache::get(const DoutPrefixProvider *dpp, const string& name, ObjectCa
                    << std::hex << mask << ", cached=0x" << src.flags
                    << std::dec << ")" << dendl;
     if(perfcounter) perfcounter->inc(l_rgw_cache_miss);
+    shard.counters->inc(l_rgw_cache_shard_miss);
     return -ENOENT;
   }
   ldpp_dout(dpp, 10) << "cache get: name=" << name << " : hit (requested=0x"
@@ -91,6 +121,7 @@ int ObjectCache::get(const DoutPrefixProvider *dpp, const string& name, ObjectCa
     cache_info->gen = entry->gen;
   }
   if(perfcounter) perfcounter->inc(l_rgw_cache_hit);
+  shard.counters->inc(l_rgw_cache_shard_hit);
 
   return 0;
 }
@@ -99,7 +130,24 @@ bool ObjectCache::chain_cache_entry(const DoutPrefixProvider *dpp,
                                     std::initializer_list<rgw_cache_entry_info*> cache_info_entries,
 				    RGWChainedCache::Entry *chained_entry)
 {
-  std::unique_lock l{lock};
+  if (shards.empty()) {
+    return false;
+  }
+
+  /* the entries may live in different shards; take their locks in index
+   * order, as lock_all() does, so concurrent callers can't deadlock */
+  std::vector<size_t> locked;
+  locked.reserve(cache_info_entries.size());
+  for (auto cache_info : cache_info_entries) {
+    locked.push_back(shard_index(cache_info->cache_locator));
+  }
+  std::sort(locked.begin(), locked.end());
+  locked.erase(std::unique(locked.begin(), locked.end()), locked.end());
+  std::vector<std::unique_lock<ceph::shared_mutex>> locks;
+  locks.reserve(locked.size());
+  for (auto i : locked) {
+    locks.emplace_back(shards[i]->lock);
+  }
 
   if (!enabled) {
     return false;
@@ -111,6 +159,7 @@ bool ObjectCache::chain_cache_entry(const DoutPrefixProvider *dpp,
   for (auto cache_info : cache_info_entries) {
     ldpp_dout(dpp, 10) << "chain_cache_entry: cache_locator="
 		   << cache_info->cache_locator << dendl;
+    auto& cache_map = shard_of(cache_info->cache_locator).cache_map;
     auto iter = cache_map.find(cache_info->cache_locator);
     if (iter == cache_map.end()) {
       ldpp_dout(dpp, 20) << "chain_cache_entry: couldn't find cache locator" << dendl;
@@ -141,7 +190,12 @@ bool ObjectCache::chain_cache_entry(const DoutPrefixProvider *dpp,
 
 void ObjectCache::put(const DoutPrefixProvider *dpp, const string& name, ObjectCacheInfo& info, rgw_cache_entry_info *cache_info)
 {
-  std::unique_lock l{lock};
+  if (shards.empty()) {
+    return;
+  }
+  Shard& shard = shard_of(name);
+
+  std::unique_lock l{shard.lock};
 
   if (!enabled) {
     return;
@@ -150,11 +204,11 @@ void ObjectCache::put(const DoutPrefixProvider *dpp, const string& name, ObjectC
   ldpp_dout(dpp, 10) << "cache put: name=" << name << " info.flags=0x"
                  << std::hex << info.flags << std::dec << dendl;
 
-  auto [iter, inserted] = cache_map.emplace(name, ObjectCacheEntry{});
+  auto [iter, inserted] = shard.cache_map.try_emplace(name);
   ObjectCacheEntry& entry = iter->second;
   entry.info.time_added = ceph::coarse_mono_clock::now();
   if (inserted) {
-    entry.lru_iter = lru.end();
+    entry.lru_iter = shard.lru.end();
   }
   ObjectCacheInfo& target = entry.info;
 
@@ -163,7 +217,11 @@ void ObjectCache::put(const DoutPrefixProvider *dpp, const string& name, ObjectC
   entry.chained_entries.clear();
   entry.gen++;
 
-  touch_lru(dpp, name, entry, entry.lru_iter);
+  if (entry.lru_iter == shard.lru.end()) {
+    insert_lru(dpp, shard, name, entry);
+  } else {
+    entry.referenced.store(true, std::memory_order_relaxed);
+  }
 
   target.status = info.status;
 
@@ -218,14 +276,19 @@ void ObjectCache::put(const DoutPrefixProvider *dpp, const string& name, ObjectC
 // negative lookup. It must only invalidate.
 bool ObjectCache::invalidate_remove(const DoutPrefixProvider *dpp, const string& name)
 {
-  std::unique_lock l{lock};
+  if (shards.empty()) {
+    return false;
+  }
+  Shard& shard = shard_of(name);
+
+  std::unique_lock l{shard.lock};
 
   if (!enabled) {
     return false;
   }
 
-  auto iter = cache_map.find(name);
-  if (iter == cache_map.end())
+  auto iter = shard.cache_map.find(name);
+  if (iter == shard.cache_map.end())
     return false;
 
   ldpp_dout(dpp, 10) << "removing " << name << " from cache" << dendl;
@@ -235,60 +298,63 @@ bool ObjectCache::invalidate_remove(const DoutPrefixProvider *dpp, const string&
     kv.first->invalidate(kv.second);
   }
 
-  remove_lru(name, iter->second.lru_iter);
-  cache_map.erase(iter);
+  remove_lru(shard, iter->second.lru_iter);
+  shard.cache_map.erase(iter);
+  shard.counters->set(l_rgw_cache_shard_entries, shard.cache_map.size());
   return true;
 }
 
-void ObjectCache::touch_lru(const DoutPrefixProvider *dpp, const string& name, ObjectCacheEntry& entry,
-			    std::list<string>::iterator& lru_iter)
+void ObjectCache::insert_lru(const DoutPrefixProvider *dpp, Shard& shard,
+			     const string& name, ObjectCacheEntry& entry)
 {
-  while (lru_size > (size_t)cct->_conf->rgw_cache_lru_size) {
-    auto iter = lru.begin();
-    if ((*iter).compare(name) == 0) {
-      /*
-       * if the entry we're touching happens to be at the lru end, don't remove it,
-       * lru shrinking can wait for next time
-       */
-      break;
+  while (!shard.lru.empty() && shard.lru.size() >= shard.max_entries) {
+    evict_lru(shard);
+  }
+
+  // new entries go just behind the hand, so they get a full sweep of the
+  // ring before they're considered for eviction
+  entry.lru_iter = shard.lru.insert(shard.hand, name);
+  entry.referenced.store(false, std::memory_order_relaxed);
+  shard.counters->set(l_rgw_cache_shard_entries, shard.cache_map.size());
+  ldpp_dout(dpp, 10) << "adding " << name << " to cache LRU" << dendl;
+}
+
+void ObjectCache::evict_lru(Shard& shard)
+{
+  for (;;) {
+    if (shard.hand == shard.lru.end()) {
+      shard.hand = shard.lru.begin();
     }
-    auto map_iter = cache_map.find(*iter);
-    ldout(cct, 10) << "removing entry: name=" << *iter << " from cache LRU" << dendl;
-    if (map_iter != cache_map.end()) {
+    auto map_iter = shard.cache_map.find(*shard.hand);
+    if (map_iter != shard.cache_map.end()) {
       ObjectCacheEntry& entry = map_iter->second;
+      if (entry.referenced.exchange(false, std::memory_order_relaxed)) {
+        ++shard.hand; // second chance
+        continue;
+      }
+      ldout(cct, 10) << "removing entry: name=" << *shard.hand
+                     << " from cache LRU" << dendl;
       invalidate_lru(entry);
-      cache_map.erase(map_iter);
+      shard.cache_map.erase(map_iter);
+      shard.counters->inc(l_rgw_cache_shard_evict);
     }
-    lru.pop_front();
-    lru_size--;
-  }
-
-  if (lru_iter == lru.end()) {
-    lru.push_back(name);
-    lru_size++;
-    lru_iter--;
-    ldpp_dout(dpp, 10) << "adding " << name << " to cache LRU end" << dendl;
-  } else {
-    ldpp_dout(dpp, 10) << "moving " << name << " to cache LRU end" << dendl;
-    lru.erase(lru_iter);
-    lru.push_back(name);
-    lru_iter = lru.end();
-    --lru_iter;
+    shard.hand = shard.lru.erase(shard.hand);
+    return;
   }
-
-  lru_counter++;
-  entry.lru_promotion_ts = lru_counter;
 }
 
-void ObjectCache::remove_lru(const string& name,
+void ObjectCache::remove_lru(Shard& shard,
 			     std::list<string>::iterator& lru_iter)
 {
-  if (lru_iter == lru.end())
+  if (lru_iter == shard.lru.end())
     return;
 
-  lru.erase(lru_iter);
-  lru_size--;
-  lru_iter = lru.end();
+  if (lru_iter == shard.hand) {
+    shard.hand = shard.lru.erase(lru_iter);
+  } else {
+    shard.lru.erase(lru_iter);
+  }
+  lru_iter = shard.lru.end();
 }
 
 void ObjectCache::invalidate_lru(ObjectCacheEntry& entry)
@@ -300,9 +366,19 @@ void ObjectCache::invalidate_lru(ObjectCacheEntry& entry)
   }
 }
 
+std::vector<std::unique_lock<ceph::shared_mutex>> ObjectCache::lock_all()
+{
+  std::vector<std::unique_lock<ceph::shared_mutex>> locks;
+  locks.reserve(shards.size());
+  for (auto& shard : shards) {
+    locks.emplace_back(shard->lock);
+  }
+  return locks;
+}
+
 void ObjectCache::set_enabled(bool status)
 {
-  std::unique_lock l{lock};
+  auto locks = lock_all();
 
   enabled = status;
 
@@ -313,32 +389,33 @@ void ObjectCache::set_enabled(bool status)
 
 void ObjectCache::invalidate_all()
 {
-  std::unique_lock l{lock};
+  auto locks = lock_all();
 
   do_invalidate_all();
 }
 
 void ObjectCache::do_invalidate_all()
 {
-  cache_map.clear();
-  lru.clear();
-
-  lru_size = 0;
-  lru_counter = 0;
-  lru_window = 0;
+  for (auto& shard : shards) {
+    shard->cache_map.clear();
+    shard->lru.clear();
+    shard->hand = shard->lru.end();
+    shard->counters->set(l_rgw_cache_shard_entries, 0);
+  }
 
+  std::lock_guard l{chained_lock};
   for (auto& cache : chained_cache) {
     cache->invalidate_all();
   }
 }
 
 void ObjectCache::chain_cache(RGWChainedCache *cache) {
-  std::unique_lock l{lock};
+  std::lock_guard l{chained_lock};
   chained_cache.push_back(cache);
 }
 
 void ObjectCache::unchain_cache(RGWChainedCache *cache) {
-  std::unique_lock l{lock};
+  std::lock_guard l{chained_lock};
 
   auto iter = chained_cache.begin();
   for (; iter != chained_cache.end(); ++iter) {
@@ -355,6 +432,10 @@ ObjectCache::~ObjectCache()
   for (auto cache : chained_cache) {
     cache->unregistered();
   }
+  for (auto& shard : shards) {
+    cct->get_perfcounters_collection()->remove(shard->counters);
+    delete shard->counters;
+  }
 }
 
 void ObjectMetaInfo::generate_test_instances(list<ObjectMetaInfo*>& o)
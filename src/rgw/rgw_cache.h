@@ -3,8 +3,10 @@
 
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include "include/types.h"
 #include "include/utime.h"
@@ -151,36 +153,57 @@ public:
 struct ObjectCacheEntry {
   ObjectCacheInfo info;
   std::list<std::string>::iterator lru_iter;
-  uint64_t lru_promotion_ts;
+  // CLOCK reference bit; set on hits with only the shard lock held shared
+  std::atomic<bool> referenced = false;
   uint64_t gen;
   std::vector<std::pair<RGWChainedCache *, std::string> > chained_entries;
 
-  ObjectCacheEntry() : lru_promotion_ts(0), gen(0) {}
+  ObjectCacheEntry() : gen(0) {}
 };
 
 class ObjectCache {
-  std::unordered_map<std::string, ObjectCacheEntry> cache_map;
-  std::list<std::string> lru;
-  unsigned long lru_size;
-  unsigned long lru_counter;
-  unsigned long lru_window;
-  ceph::shared_mutex lock = ceph::make_shared_mutex("ObjectCache");
+  /* The cache is split into lock-striped shards, selected by a hash of the
+   * entry name. Each shard keeps its entries on a CLOCK ring: hits only mark
+   * the entry as referenced, and the hand sweeps the ring on insertion to
+   * find an unreferenced victim, so lookups never need the write lock. */
+  struct Shard {
+    std::unordered_map<std::string, ObjectCacheEntry> cache_map;
+    std::list<std::string> lru;
+    std::list<std::string>::iterator hand = lru.end();
+    size_t max_entries = 0;
+    ceph::shared_mutex lock = ceph::make_shared_mutex("ObjectCache::Shard");
+    PerfCounters *counters = nullptr;
+  };
+  std::vector<std::unique_ptr<Shard>> shards;
   CephContext *cct;
 
+  ceph::mutex chained_lock = ceph::make_mutex("ObjectCache::chained");
   std::vector<RGWChainedCache *> chained_cache;
 
   bool enabled;
   ceph::timespan expiry;
 
-  void touch_lru(const DoutPrefixProvider *dpp, const std::string& name, ObjectCacheEntry& entry,
-		 std::list<std::string>::iterator& lru_iter);
-  void remove_lru(const std::string& name, std::list<std::string>::iterator& lru_iter);
+  size_t shard_index(const std::string& name) const {
+    if (shards.size() == 1) {
+      return 0;
+    }
+    return std::hash<std::string>{}(name) % shards.size();
+  }
+  Shard& shard_of(const std::string& name) {
+    return *shards[shard_index(name)];
+  }
+
+  void insert_lru(const DoutPrefixProvider *dpp, Shard& shard,
+                  const std::string& name, ObjectCacheEntry& entry);
+  void evict_lru(Shard& shard);
+  void remove_lru(Shard& shard, std::list<std::string>::iterator& lru_iter);
   void invalidate_lru(ObjectCacheEntry& entry);
 
+  std::vector<std::unique_lock<ceph::shared_mutex>> lock_all();
   void do_invalidate_all();
 
 public:
-  ObjectCache() : lru_size(0), lru_counter(0), lru_window(0), cct(NULL), enabled(false) { }
+  ObjectCache() : cct(NULL), enabled(false) { }
   ~ObjectCache();
   int get(const DoutPrefixProvider *dpp, const std::string& name, ObjectCacheInfo& bl, uint32_t mask, rgw_cache_entry_info *cache_info);
   std::optional<ObjectCacheInfo> get(const DoutPrefixProvider *dpp, const std::string& name) {
@@ -191,10 +214,13 @@ public:
 
   template<typename F>
   void for_each(const F& f) {
-    std::shared_lock l{lock};
-    if (enabled) {
+    for (auto& shard : shards) {
+      std::shared_lock l{shard->lock};
+      if (!enabled) {
+        return;
+      }
       auto now  = ceph::coarse_mono_clock::now();
-      for (const auto& [name, entry] : cache_map) {
+      for (const auto& [name, entry] : shard->cache_map) {
         if (expiry.count() && (now - entry.info.time_added) < expiry) {
           f(name, entry);
         }
@@ -204,12 +230,7 @@ public:
 
   void put(const DoutPrefixProvider *dpp, const std::string& name, ObjectCacheInfo& bl, rgw_cache_entry_info *cache_info);
   bool invalidate_remove(const DoutPrefixProvider *dpp, const std::string& name);
-  void set_ctx(CephContext *_cct) {
-    cct = _cct;
-    lru_window = cct->_conf->rgw_cache_lru_size / 2;
-    expiry = std::chrono::seconds(cct->_conf.get_val<uint64_t>(
-						"rgw_cache_expiry_interval"));
-  }
+  void set_ctx(CephContext *_cct);
   bool chain_cache_entry(const DoutPrefixProvider *dpp,
                          std::initializer_list<rgw_cache_entry_info*> cache_info_entries,
 			 RGWChainedCache::Entry *chained_entry);
@@ -86,6 +86,7 @@ class AppMain {
   RGWProcessEnv env;
   void need_context_pool();
   std::optional<ceph::async::io_context_pool> context_pool;
+  std::optional<ceph::async::io_context_pool> put_pipeline_pool;
 public:
   AppMain(const DoutPrefixProvider* dpp);
   ~AppMain();
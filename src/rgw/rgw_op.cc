@@ -4341,6 +4341,15 @@ void RGWPutObj::execute(optional_yield y)
   std::unique_ptr<rgw::sal::DataProcessor> encrypt;
   std::unique_ptr<rgw::sal::DataProcessor> run_lua;
 
+  // hash, compress and encrypt on the put pipeline's workers, if enabled.
+  // declared after the filters it runs, so it is destroyed first
+  std::optional<rgw::putobj::OffloadProcessor> offload;
+  if (s->penv.put_pipeline && s->yield) {
+    offload.emplace(*s->penv.put_pipeline, s->yield, filter,
+                    need_calc_md5 ? &hash : nullptr);
+    filter = offload->get_output();
+  }
+
   if (!append) { // compression and encryption only apply to full object uploads
     op_ret = get_encrypt_filter(&encrypt, filter);
     if (op_ret < 0) {
@@ -4368,6 +4377,12 @@ void RGWPutObj::execute(optional_yield y)
     if (torrent = get_torrent_filter(filter); torrent) {
       filter = &*torrent;
     }
+  }
+  if (offload) {
+    offload->set_next(filter);
+    filter = &*offload;
+  }
+  if (!append) {
     // run lua script before data is compressed and encrypted - last filter runs first
     op_ret = get_lua_filter(&run_lua, filter);
     if (op_ret < 0) {
@@ -4401,7 +4416,7 @@ void RGWPutObj::execute(optional_yield y)
       break;
     }
 
-    if (need_calc_md5) {
+    if (need_calc_md5 && !offload) {
       hash.Update((const unsigned char *)data.c_str(), data.length());
     }
 
@@ -92,6 +92,35 @@ enum {
   l_rgw_topic_last
 };
 
+enum {
+  l_rgw_cache_shard_first = 18000,
+
+  l_rgw_cache_shard_hit,
+  l_rgw_cache_shard_miss,
+  l_rgw_cache_shard_evict,
+  l_rgw_cache_shard_entries,
+
+  l_rgw_cache_shard_last
+};
+
+enum {
+  l_rgw_obj_cache_first = 19000,
+
+  l_rgw_obj_cache_hit,
+  l_rgw_obj_cache_miss,
+  l_rgw_obj_cache_stale,
+  l_rgw_obj_cache_admit,
+  l_rgw_obj_cache_reject,
+  l_rgw_obj_cache_evict,
+  l_rgw_obj_cache_invalidate,
+  l_rgw_obj_cache_head_hit,
+  l_rgw_obj_cache_head_revalidate,
+  l_rgw_obj_cache_bytes,
+  l_rgw_obj_cache_entries,
+
+  l_rgw_obj_cache_last
+};
+
 namespace rgw::op_counters {
 
 struct CountersContainer {
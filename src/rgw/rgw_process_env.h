@@ -9,6 +9,9 @@ class ActiveRateLimiter;
 class OpsLogSink;
 class RGWREST;
 
+namespace boost::asio {
+  class io_context;
+}
 namespace rgw {
   class SiteConfig;
 }
@@ -45,6 +48,8 @@ struct RGWProcessEnv {
   OpsLogSink *olog = nullptr;
   std::unique_ptr<rgw::auth::StrategyRegistry> auth_registry;
   ActiveRateLimiter* ratelimiting = nullptr;
+  // workers that hash, compress and encrypt object uploads, if enabled
+  boost::asio::io_context* put_pipeline = nullptr;
 
 #ifdef WITH_ARROW_FLIGHT
   // managed by rgw:flight::FlightFrontend in rgw_flight_frontend.cc
@@ -15,6 +15,10 @@
 
 #include "rgw_putobj.h"
 
+#include <boost/asio/post.hpp>
+#include "common/async/completion.h"
+#include "common/ceph_mutex.h"
+
 namespace rgw::putobj {
 
 int ChunkProcessor::process(bufferlist&& data, uint64_t offset)
@@ -96,4 +100,118 @@ int StripeProcessor::process(bufferlist&& data, uint64_t offset)
   return Pipe::process(std::move(data), offset - bounds.first);
 }
 
+// completion of a chunk on a worker. the caller either yields or blocks until
+// finish() is called
+struct OffloadProcessor::Stage {
+  using Signature = void(boost::system::error_code);
+  using Completion = ceph::async::Completion<Signature>;
+  std::unique_ptr<Completion> completion;
+  ceph::mutex mutex = ceph::make_mutex("OffloadProcessor::Stage");
+  ceph::condition_variable cond;
+  bool done = false;
+  int ret = 0;
+
+  int wait(optional_yield y) {
+    std::unique_lock l{mutex};
+    if (done) {
+      return ret;
+    }
+    if (y) {
+      using CompletionInit = boost::asio::async_completion<
+          spawn::yield_context, Signature>;
+      boost::system::error_code ec;
+      auto&& token = y.get_yield_context()[ec];
+      CompletionInit init(token);
+      completion = Completion::create(y.get_io_context().get_executor(),
+                                      std::move(init.completion_handler));
+      l.unlock();
+      init.result.get();
+      return -ec.value();
+    }
+    cond.wait(l, [this] { return done; });
+    return ret;
+  }
+
+  void finish(int r) {
+    std::unique_lock l{mutex};
+    ret = r;
+    done = true;
+    if (completion) {
+      boost::system::error_code ec(-ret, boost::system::system_category());
+      Completion::post(std::move(completion), ec);
+    } else {
+      cond.notify_all();
+    }
+  }
+};
+
+OffloadProcessor::~OffloadProcessor()
+{
+  // a worker may still reference the offloaded processors
+  if (stage) {
+    stage->wait(null_yield);
+  }
+}
+
+int OffloadProcessor::wait_stage()
+{
+  if (!stage) {
+    return 0;
+  }
+  int r = stage->wait(y);
+  stage.reset();
+  return r;
+}
+
+int OffloadProcessor::write(Output::Queue&& queued)
+{
+  for (auto& [data, offset] : queued) {
+    int r = writer->process(std::move(data), offset);
+    if (r < 0) {
+      return r;
+    }
+  }
+  return 0;
+}
+
+int OffloadProcessor::process(bufferlist&& data, uint64_t offset)
+{
+  // the offloaded processors are stateful, so chunks go through them in
+  // order: wait for the previous chunk before handing over the next
+  int r = wait_stage();
+  if (r < 0) {
+    return r;
+  }
+  // take the previous chunk's output before the worker starts adding to it
+  auto queued = std::exchange(output.queued, {});
+
+  const bool flush = (data.length() == 0);
+  stage = std::make_shared<Stage>();
+  boost::asio::post(workers,
+      [this, s = stage, data = std::move(data), offset] () mutable {
+        if (hash) {
+          for (const auto& p : data.buffers()) {
+            hash->Update(reinterpret_cast<const unsigned char*>(p.c_str()),
+                         p.length());
+          }
+        }
+        s->finish(next->process(std::move(data), offset));
+      });
+
+  // write the previous chunk's output while the worker runs
+  r = write(std::move(queued));
+  if (r < 0) {
+    return r;
+  }
+
+  if (flush) {
+    r = wait_stage();
+    if (r < 0) {
+      return r;
+    }
+    return write(std::exchange(output.queued, {}));
+  }
+  return 0;
+}
+
 } // namespace rgw::putobj
@@ -15,7 +15,13 @@
 
 #pragma once
 
+#include <memory>
+#include <utility>
+#include <vector>
+
 #include "include/buffer.h"
+#include "common/async/yield_context.h"
+#include "common/ceph_crypto.h"
 #include "rgw_sal.h"
 
 namespace rgw::putobj {
@@ -70,4 +76,51 @@ class StripeProcessor : public Pipe {
   int process(bufferlist&& data, uint64_t data_offset) override;
 };
 
+// runs the processors stacked on top of get_output() on a worker thread
+// pool, one chunk at a time. while a worker hashes, compresses and encrypts
+// one chunk, the caller's coroutine is free to read the next chunk from the
+// client and to write the previous chunk's output to the final processor.
+// at most one chunk is being processed and one chunk's output is being
+// written at any time, so buffering stays bounded to a few chunks
+class OffloadProcessor : public rgw::sal::DataProcessor {
+  // collects the output of the offloaded processors
+  class Output : public rgw::sal::DataProcessor {
+   public:
+    using Queue = std::vector<std::pair<bufferlist, uint64_t>>;
+    Queue queued;
+
+    int process(bufferlist&& data, uint64_t offset) override {
+      queued.emplace_back(std::move(data), offset);
+      return 0;
+    }
+  };
+  struct Stage;
+
+  boost::asio::io_context& workers;
+  optional_yield y;
+  rgw::sal::DataProcessor *writer;
+  rgw::sal::DataProcessor *next = nullptr;
+  ceph::crypto::MD5 *hash;
+  Output output;
+  std::shared_ptr<Stage> stage; // chunk being processed by a worker
+
+  int wait_stage();
+  int write(Output::Queue&& queued);
+ public:
+  // if given, hash is updated with the data before it's passed on
+  OffloadProcessor(boost::asio::io_context& workers, optional_yield y,
+                   rgw::sal::DataProcessor *writer,
+                   ceph::crypto::MD5 *hash)
+    : workers(workers), y(y), writer(writer), hash(hash)
+  {}
+  ~OffloadProcessor() override;
+
+  // the processors to offload write their output here
+  rgw::sal::DataProcessor* get_output() { return &output; }
+  // the first of the offloaded processors
+  void set_next(rgw::sal::DataProcessor *next) { this->next = next; }
+
+  int process(bufferlist&& data, uint64_t offset) override;
+};
+
 } // namespace rgw::putobj
@@ -22,6 +22,10 @@
 #include <limits.h>
 #include <errno.h>
 #include <sys/uio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 #include "include/buffer.h"
 #include "include/buffer_raw.h"
@@ -29,6 +33,7 @@
 #include "include/utime.h"
 #include "include/coredumpctl.h"
 #include "include/encoding.h"
+#include "include/mempool.h"
 #include "common/buffer_instrumentation.h"
 #include "common/environment.h"
 #include "common/Clock.h"
@@ -145,6 +150,100 @@ TEST(Buffer, BenchAlloc) {
   bench_buffer_alloc(4, 1000000);
 }
 
+TEST(BufferRaw, small_raw_pool) {
+  // buffers allocated here are freed by another thread, and buffers of
+  // a thread that has exited are freed here
+  buffer::set_small_raw_pool(true);
+  std::vector<bufferptr> v;
+  for (unsigned i = 0; i < 1000; i++) {
+    v.push_back(buffer::create(i * 7 % 4097, i & 0xff));
+  }
+  std::thread([&v] {
+    for (unsigned i = 0; i < v.size(); i++) {
+      for (unsigned j = 0; j < v[i].length(); j++) {
+	ASSERT_EQ((char)(i & 0xff), v[i][j]);
+      }
+    }
+    v.clear();
+  }).join();
+  // slots freed remotely are reused by their owner
+  for (unsigned i = 0; i < 1000; i++) {
+    v.push_back(buffer::create(i * 7 % 4097, 1));
+  }
+  v.clear();
+  std::thread([&v] {
+    for (unsigned i = 0; i < 100; i++) {
+      v.push_back(buffer::create(300, 2));
+    }
+  }).join();
+  for (auto &p : v) {
+    for (unsigned j = 0; j < p.length(); j++) {
+      ASSERT_EQ(2, p[j]);
+    }
+  }
+  v.clear();
+}
+
+// idle slots in mempool buffer_slab, once every thread that touched them
+// has published its batched updates
+static ssize_t buffer_slab_items() {
+  return mempool::buffer_slab::allocated_items();
+}
+
+TEST(BufferRaw, small_raw_pool_accounting) {
+  buffer::set_small_raw_pool(true);
+  // a fresh thread, so the slots come from and go back to a cache of
+  // its own; 64 frees or reuses publish the batched counters
+  std::thread([] {
+    constexpr unsigned n = 64;
+    std::vector<bufferptr> v;
+    for (unsigned i = 0; i < n; i++) {
+      v.push_back(buffer::create(300));
+    }
+    const ssize_t before = buffer_slab_items();
+    const size_t before_bytes = mempool::buffer_slab::allocated_bytes();
+    v.clear();
+    EXPECT_EQ(before + n, buffer_slab_items());
+    EXPECT_LE(before_bytes + n * 300, mempool::buffer_slab::allocated_bytes());
+    for (unsigned i = 0; i < n; i++) {
+      v.push_back(buffer::create(300));
+    }
+    EXPECT_EQ(before, buffer_slab_items());
+    EXPECT_EQ(before_bytes, mempool::buffer_slab::allocated_bytes());
+
+    // freed by a thread without a cache of its own, the slots are
+    // accounted right away and queued for this thread
+    std::thread([&v] { v.clear(); }).join();
+    EXPECT_EQ(before + n, buffer_slab_items());
+    // ... which takes them back once its own free list runs dry
+    for (unsigned i = 0; i < n; i++) {
+      v.push_back(buffer::create(300));
+    }
+    EXPECT_EQ(before, buffer_slab_items());
+    v.clear();
+  }).join();
+}
+
+TEST(BufferRaw, small_raw_pool_remote_bound) {
+  buffer::set_small_raw_pool(true);
+  // a thread that doesn't allocate again must not have an unbounded
+  // backlog of the slots other threads freed queued for it
+  std::thread([] {
+    constexpr unsigned n = 1000;
+    std::vector<bufferptr> v;
+    for (unsigned i = 0; i < n; i++) {
+      v.push_back(buffer::create(4000));
+    }
+    const ssize_t before = buffer_slab_items();
+    std::thread([&v] { v.clear(); }).join();
+    const ssize_t queued = buffer_slab_items() - before;
+    EXPECT_LT(0, queued);
+    EXPECT_GT((ssize_t)n, queued);
+    // the bound is six classes of 256K, in slots of 4608 bytes
+    EXPECT_GE(6 * 256 * 1024, queued * 4608);
+  }).join();
+}
+
 TEST(BufferRaw, ostream) {
   bufferptr ptr(1);
   std::ostringstream stream;
@@ -1337,6 +1436,83 @@ TEST(BufferList, BenchAlloc) {
   bench_bufferlist_alloc(4, 100000, 16);
 }
 
+// encode something shaped like a pg log entry: a handful of small fields
+// and a short string, into a bufferlist of its own
+static bufferlist encode_small_message(uint64_t seq)
+{
+  bufferlist bl;
+  ENCODE_START(1, 1, bl);
+  encode(seq, bl);
+  encode((uint32_t)seq, bl);
+  encode(std::string("rbd_data.1234567890ab.0000000000000042"), bl);
+  bufferlist payload;
+  payload.append(buffer::create(128 + seq % 512, 'x'));
+  encode(payload, bl);
+  ENCODE_FINISH(bl);
+  return bl;
+}
+
+static void bench_small_message_encode(bool pool, bool cross_thread)
+{
+  constexpr unsigned num = 2000000;
+  buffer::set_small_raw_pool(pool);
+  std::deque<bufferlist> q;
+  std::mutex lock;
+  std::condition_variable cond;
+  bool done = false;
+  // the consumer drops the messages, as a messenger thread would once sent
+  std::thread consumer;
+  if (cross_thread) {
+    consumer = std::thread([&] {
+      std::unique_lock l(lock);
+      while (!done || !q.empty()) {
+	if (q.empty()) {
+	  cond.wait(l);
+	  continue;
+	}
+	auto batch = std::move(q);
+	q.clear();
+	l.unlock();
+	batch.clear();
+	l.lock();
+      }
+    });
+  }
+  utime_t start = ceph_clock_now();
+  for (unsigned i = 0; i < num; i++) {
+    bufferlist bl = encode_small_message(i);
+    if (cross_thread) {
+      std::lock_guard l(lock);
+      q.push_back(std::move(bl));
+      if (q.size() >= 64) {
+	cond.notify_one();
+      }
+    }
+  }
+  if (cross_thread) {
+    {
+      std::lock_guard l(lock);
+      done = true;
+    }
+    cond.notify_one();
+    consumer.join();
+  }
+  utime_t end = ceph_clock_now();
+  cout << "small raw pool " << (pool ? "on " : "off")
+       << (cross_thread ? " freed by another thread" : " freed locally")
+       << ": " << (double)num / (double)(end - start) << " msgs/sec"
+       << std::endl;
+  buffer::set_small_raw_pool(true);
+}
+
+// encodes 8M messages; run with --gtest_also_run_disabled_tests
+TEST(BufferList, DISABLED_BenchSmallMessageEncode) {
+  for (bool cross_thread : {false, true}) {
+    bench_small_message_encode(false, cross_thread);
+    bench_small_message_encode(true, cross_thread);
+  }
+}
+
 /*
  * append_bench tests now have multiple variants:
  *
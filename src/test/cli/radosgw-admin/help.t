@@ -233,6 +233,7 @@
                                          bilog trim
                                          bilog status
      --max-entries=<entries>           max entries for listing operations
+     --bench                           with bucket list, time each page instead of listing entries
      --metadata-key=<key>              key to retrieve metadata from with metadata get
      --remote=<remote>                 zone or zonegroup id of remote gateway
      --period=<id>                     period id
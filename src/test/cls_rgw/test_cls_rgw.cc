@@ -583,18 +583,18 @@ TEST_F(cls_rgw, index_list_delimited)
   auto id_entry_map = it->second.dir.m;
   bool truncated = it->second.is_truncated;
 
-  // the cls code will make 4 tries to get 1000 entries; however
-  // because each of the subdirectories is so large, each attempt will
-  // only retrieve the first part of the subdirectory
+  // the first read of 1000 keys ends inside the first subdirectory;
+  // after that the cls code seeks past each subdirectory and only
+  // reads a few keys at a time, so one call gets everything
 
-  ASSERT_EQ(48u, id_entry_map.size()) <<
-    "We should get 40 top-level entries and the tops of 8 \"subdirectories\".";
-  ASSERT_EQ(true, truncated) << "We did not get all entries.";
+  ASSERT_EQ(65u, id_entry_map.size()) <<
+    "We should get 55 top-level entries and the tops of 10 \"subdirectories\".";
+  ASSERT_EQ(false, truncated) << "We should have all entries.";
 
   ASSERT_EQ("a-0", id_entry_map.cbegin()->first);
-  ASSERT_EQ("p/", id_entry_map.crbegin()->first);
+  ASSERT_EQ("u-4", id_entry_map.crbegin()->first);
 
-  // now let's get the rest of the entries
+  // now let's start after one of the subdirectories
 
   list_results.clear();
   
@@ -970,6 +970,22 @@ TEST_F(CRUSHTest, straw2_stddev)
   }
 }
 
+TEST_F(CRUSHTest, hash32_3_batch) {
+  // the batched hash used by straw2 must match the scalar one lane for
+  // lane, including the scalar tail of a partial batch.
+  std::vector<__u32> b(37), out(37);
+  for (unsigned i = 0; i < b.size(); ++i)
+    b[i] = i * 2654435761u;
+  for (unsigned n = 0; n <= b.size(); ++n) {
+    for (__u32 x : {0u, 1u, 12345u, 0xffffffffu}) {
+      crush_hash32_3_batch(CRUSH_HASH_RJENKINS1, x, b.data(), 3, out.data(), n);
+      for (unsigned i = 0; i < n; ++i) {
+	ASSERT_EQ(crush_hash32_3(CRUSH_HASH_RJENKINS1, x, b[i], 3), out[i]);
+      }
+    }
+  }
+}
+
 TEST_F(CRUSHTest, straw2_reweight) {
   // when we adjust the weight of an item in a straw2 bucket,
   // we should *only* see movement from or to that item, never
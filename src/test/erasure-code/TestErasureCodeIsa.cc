@@ -368,6 +368,48 @@ TEST_F(IsaErasureCodeTest, encode)
   }
 }
 
+TEST_F(IsaErasureCodeTest, encode_with_crc)
+{
+  // m=1 goes through region_xor, m>1 through ec_encode_data; the object
+  // spans several 16K slices per chunk and ends in a partial one
+  for (const char *m : {"1", "3"}) {
+    ErasureCodeIsaDefault Isa(tcache);
+    ErasureCodeProfile profile;
+    profile["k"] = "4";
+    profile["m"] = m;
+    Isa.init(profile, &cerr);
+    const unsigned n = Isa.get_chunk_count();
+
+    bufferlist in;
+    for (unsigned i = 0; i < 4 * 40000; i++)
+      in.append(static_cast<char>(i * 31 + 7));
+    set<int> want_to_encode;
+    for (unsigned i = 0; i < n; i++)
+      want_to_encode.insert(i);
+
+    map<int,bufferlist> encoded;
+    EXPECT_EQ(0, Isa.encode(want_to_encode, in, &encoded));
+
+    vector<uint32_t> crcs(n, -1);
+    map<int,bufferlist> fused;
+    EXPECT_EQ(0, Isa.encode_with_crc(want_to_encode, in, &fused, &crcs));
+    ASSERT_EQ(n, fused.size());
+    for (unsigned i = 0; i < n; i++) {
+      EXPECT_TRUE(encoded[i].contents_equal(fused[i]));
+      EXPECT_EQ(encoded[i].crc32c(-1), crcs[i]);
+    }
+
+    // chunks that are not wanted are neither returned nor hashed
+    vector<uint32_t> partial(n, 0);
+    fused.clear();
+    EXPECT_EQ(0, Isa.encode_with_crc(set<int>{0, 4}, in, &fused, &partial));
+    EXPECT_EQ(2u, fused.size());
+    EXPECT_EQ(encoded[0].crc32c(0), partial[0]);
+    EXPECT_EQ(encoded[4].crc32c(0), partial[4]);
+    EXPECT_EQ(0u, partial[1]);
+  }
+}
+
 TEST_F(IsaErasureCodeTest, sanity_check_k)
 {
   ErasureCodeIsaDefault Isa(tcache);
@@ -59,7 +59,9 @@ int ErasureCodeBench::setup(int argc, char** argv) {
     ("plugin,p", po::value<string>()->default_value("jerasure"),
      "erasure code plugin name")
     ("workload,w", po::value<string>()->default_value("encode"),
-     "run either encode or decode")
+     "run either encode, encode-crc, encode-crc-fused or decode. "
+     "encode-crc encodes then computes the crc32c of every chunk, "
+     "encode-crc-fused does the same with a single encode_with_crc() call")
     ("erasures,e", po::value<int>()->default_value(1),
      "number of erasures when decoding")
     ("erased", po::value<vector<int> >(),
@@ -156,7 +158,9 @@ int ErasureCodeBench::run() {
   ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
   instance.disable_dlclose = true;
 
-  if (workload == "encode")
+  if (workload == "encode" ||
+      workload == "encode-crc" ||
+      workload == "encode-crc-fused")
     return encode();
   else
     return decode();
@@ -185,7 +189,21 @@ int ErasureCodeBench::encode()
   utime_t begin_time = ceph_clock_now();
   for (int i = 0; i < max_iterations; i++) {
     std::map<int,bufferlist> encoded;
-    code = erasure_code->encode(want_to_encode, in, &encoded);
+    if (workload == "encode-crc-fused") {
+      vector<uint32_t> crcs(k + m, -1);
+      code = erasure_code->encode_with_crc(want_to_encode, in, &encoded, &crcs);
+      if (code == -EOPNOTSUPP)
+        cerr << "plugin " << plugin << " has no encode_with_crc()" << endl;
+    } else {
+      code = erasure_code->encode(want_to_encode, in, &encoded);
+      if (code == 0 && workload == "encode-crc") {
+        // data chunks may share the input buffer; do not let them hit
+        // the crc cache of the previous iteration
+        in.invalidate_crc();
+        for (auto &&[shard, chunk] : encoded)
+          chunk.crc32c(-1);
+      }
+    }
     if (code)
       return code;
   }
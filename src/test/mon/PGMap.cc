@@ -167,3 +167,65 @@ TEST(pgmap, dump_object_stat_sum_2)
   ASSERT_EQ(percentify(0), tbl.get(0, col++));
   ASSERT_EQ(stringify(byte_u_t(avail/pool.size)), tbl.get(0, col++));
 }
+
+TEST(pgmap, apply_incremental_purged_snaps)
+{
+  PGMap pg_map;
+  auto apply = [&pg_map](std::function<void(PGMap::Incremental&)> f) {
+    PGMap::Incremental inc;
+    inc.version = pg_map.version + 1;
+    f(inc);
+    pg_map.apply_incremental(nullptr, inc);
+    pg_map.calc_purged_snaps();
+    // must match a from-scratch recomputation
+    PGMap full = pg_map;
+    full.calc_stats();
+    full.calc_purged_snaps();
+    ASSERT_EQ(full.purged_snaps, pg_map.purged_snaps);
+    ASSERT_EQ(full.num_pg_by_osd.size(), pg_map.num_pg_by_osd.size());
+    for (auto& [osd, count] : full.num_pg_by_osd) {
+      ASSERT_EQ(count.acting, pg_map.num_pg_by_osd[osd].acting);
+      ASSERT_EQ(count.primary, pg_map.num_pg_by_osd[osd].primary);
+    }
+  };
+  auto mk_stat = [](snapid_t first, snapid_t len, int primary) {
+    pg_stat_t s;
+    s.state = PG_STATE_ACTIVE | PG_STATE_CLEAN;
+    s.purged_snaps.insert(first, len);
+    s.up = s.acting = {primary, primary + 1};
+    s.up_primary = s.acting_primary = primary;
+    return s;
+  };
+
+  apply([&](PGMap::Incremental& inc) {
+    inc.pg_stat_updates[pg_t(0, 1)] = mk_stat(1, 10, 0);
+    inc.pg_stat_updates[pg_t(1, 1)] = mk_stat(2, 10, 1);
+    inc.pg_stat_updates[pg_t(0, 2)] = mk_stat(5, 5, 2);
+  });
+  EXPECT_EQ(2u, pg_map.purged_snaps.size());
+  EXPECT_EQ(9u, pg_map.purged_snaps[1].size());
+
+  // counters only: nothing to recompute
+  apply([&](PGMap::Incremental& inc) {
+    auto s = mk_stat(1, 10, 0);
+    s.stats.sum.num_objects = 10;
+    inc.pg_stat_updates[pg_t(0, 1)] = s;
+  });
+
+  // purged_snaps and mapping change in one pool
+  apply([&](PGMap::Incremental& inc) {
+    inc.pg_stat_updates[pg_t(1, 1)] = mk_stat(1, 12, 3);
+  });
+  EXPECT_EQ(10u, pg_map.purged_snaps[1].size());
+
+  // a pg going unknown drops its pool
+  apply([&](PGMap::Incremental& inc) {
+    inc.pg_stat_updates[pg_t(0, 2)] = pg_stat_t();
+  });
+  EXPECT_EQ(0u, pg_map.purged_snaps.count(2));
+
+  apply([&](PGMap::Incremental& inc) {
+    inc.pg_remove.insert(pg_t(1, 1));
+  });
+  EXPECT_EQ(10u, pg_map.purged_snaps[1].size());
+}
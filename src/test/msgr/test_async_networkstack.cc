@@ -26,6 +26,7 @@
 
 #include "acconfig.h"
 #include "common/config_obs.h"
+#include "common/perf_counters.h"
 #include "include/Context.h"
 #include "msg/async/Event.h"
 #include "msg/async/Stack.h"
@@ -271,6 +272,229 @@ TEST_P(NetworkWorkerTest, SimpleTest) {
   });
 }
 
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+// a large send with ms_async_zerocopy keeps the sent bytes referenced until
+// the kernel's completion is reaped from the error queue.  loopback always
+// copies, so the completion reports that and the socket stops using
+// zerocopy for later sends.
+TEST_P(NetworkWorkerTest, ZeroCopySendTest) {
+  if (strncmp(GetParam(), "posix", 5)) {
+    GTEST_SKIP() << "zerocopy is only implemented by the posix stack";
+  }
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_LE(0, fd);
+    int one = 1;
+    int r = ::setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+    ::close(fd);
+    if (r < 0) {
+      GTEST_SKIP() << "SO_ZEROCOPY is not supported by this kernel";
+    }
+  }
+  g_ceph_context->_conf.set_val_or_die("ms_async_zerocopy", "true");
+  g_ceph_context->_conf.set_val_or_die("ms_async_zerocopy_min_bytes", "4096");
+  entity_addr_t bind_addr;
+  ASSERT_TRUE(bind_addr.parse(get_addr().c_str()));
+
+  exec_events([this, bind_addr](Worker *worker) mutable {
+    if (worker->id != 0) {
+      return;
+    }
+    entity_addr_t cli_addr;
+    SocketOptions options;
+    ServerSocket bind_socket;
+    EventCenter *center = &worker->center;
+    ssize_t r = worker->listen(bind_addr, 0, options, &bind_socket);
+    ASSERT_EQ(0, r);
+
+    ConnectedSocket cli_socket, srv_socket;
+    r = worker->connect(bind_addr, options, &cli_socket);
+    ASSERT_EQ(0, r);
+    {
+      C_poll cb(center);
+      center->create_file_event(bind_socket.fd(), EVENT_READABLE, &cb);
+      ASSERT_TRUE(cb.poll(500));
+      center->delete_file_event(bind_socket.fd(), EVENT_READABLE);
+      r = bind_socket.accept(&srv_socket, options, &cli_addr, worker);
+      ASSERT_EQ(0, r);
+    }
+    {
+      C_poll cb(center);
+      center->create_file_event(cli_socket.fd(), EVENT_READABLE, &cb);
+      r = cli_socket.is_connected();
+      if (r == 0) {
+        ASSERT_EQ(true, cb.poll(500));
+        r = cli_socket.is_connected();
+      }
+      ASSERT_EQ(1, r);
+      center->delete_file_event(cli_socket.fd(), EVENT_READABLE);
+    }
+
+    PerfCounters *logger = worker->get_perf_counter();
+    const uint64_t zerocopy_bytes_before =
+      logger->get(l_msgr_send_zerocopy_bytes) +
+      logger->get(l_msgr_send_zerocopy_copied_bytes);
+
+    // send and drain on the other end until everything went out
+    C_poll srv_cb(center);
+    center->create_file_event(srv_socket.fd(), EVENT_READABLE, &srv_cb);
+    auto send_all = [&] (bufferlist& bl) {
+      const size_t len = bl.length();
+      size_t received = 0;
+      char buf[65536];
+      while (bl.length() || received < len) {
+        if (bl.length()) {
+          ssize_t r = cli_socket.send(bl, false);
+          ASSERT_LE(0, r);
+        }
+        ssize_t r = srv_socket.read(buf, sizeof(buf));
+        if (r == -EAGAIN) {
+          srv_cb.reset();
+          srv_cb.poll(10);
+          continue;
+        }
+        ASSERT_LT(0, r);
+        received += r;
+      }
+    };
+
+    const size_t len = 256 << 10;
+    bufferptr bp = buffer::create_page_aligned(len);
+    memset(bp.c_str(), 'z', len);
+    {
+      bufferlist bl;
+      bl.append(bp);
+      send_all(bl);
+    }
+    // the socket holds on to the sent bytes until the completion is reaped
+    ASSERT_LT(1, bp.raw_nref());
+    for (int i = 0; i < 1000 && bp.raw_nref() > 1; ++i) {
+      cli_socket.reap_send_completions();
+      usleep(1000);
+    }
+    ASSERT_EQ(1, bp.raw_nref());
+    ASSERT_EQ(zerocopy_bytes_before + len,
+              logger->get(l_msgr_send_zerocopy_bytes) +
+              logger->get(l_msgr_send_zerocopy_copied_bytes));
+
+    // loopback copied, so the next send isn't held
+    bufferptr bp2 = buffer::create_page_aligned(len);
+    memset(bp2.c_str(), 'y', len);
+    {
+      bufferlist bl;
+      bl.append(bp2);
+      send_all(bl);
+    }
+    ASSERT_EQ(1, bp2.raw_nref());
+
+    center->delete_file_event(srv_socket.fd(), EVENT_READABLE);
+    bind_socket.abort_accept();
+    srv_socket.close();
+    cli_socket.close();
+  });
+  g_ceph_context->_conf.set_val_or_die("ms_async_zerocopy", "false");
+}
+
+// closing a socket with zerocopy sends still in flight must not drop the
+// pins: the kernel keeps sending from those pages after close()
+TEST_P(NetworkWorkerTest, ZeroCopyCloseTest) {
+  if (strncmp(GetParam(), "posix", 5)) {
+    GTEST_SKIP() << "zerocopy is only implemented by the posix stack";
+  }
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_LE(0, fd);
+    int one = 1;
+    int r = ::setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+    ::close(fd);
+    if (r < 0) {
+      GTEST_SKIP() << "SO_ZEROCOPY is not supported by this kernel";
+    }
+  }
+  g_ceph_context->_conf.set_val_or_die("ms_async_zerocopy", "true");
+  g_ceph_context->_conf.set_val_or_die("ms_async_zerocopy_min_bytes", "4096");
+  entity_addr_t bind_addr;
+  ASSERT_TRUE(bind_addr.parse(get_addr().c_str()));
+
+  exec_events([this, bind_addr](Worker *worker) mutable {
+    if (worker->id != 0) {
+      return;
+    }
+    entity_addr_t cli_addr;
+    SocketOptions options;
+    ServerSocket bind_socket;
+    EventCenter *center = &worker->center;
+    ssize_t r = worker->listen(bind_addr, 0, options, &bind_socket);
+    ASSERT_EQ(0, r);
+
+    ConnectedSocket cli_socket, srv_socket;
+    r = worker->connect(bind_addr, options, &cli_socket);
+    ASSERT_EQ(0, r);
+    {
+      C_poll cb(center);
+      center->create_file_event(bind_socket.fd(), EVENT_READABLE, &cb);
+      ASSERT_TRUE(cb.poll(500));
+      center->delete_file_event(bind_socket.fd(), EVENT_READABLE);
+      r = bind_socket.accept(&srv_socket, options, &cli_addr, worker);
+      ASSERT_EQ(0, r);
+    }
+    {
+      C_poll cb(center);
+      center->create_file_event(cli_socket.fd(), EVENT_READABLE, &cb);
+      r = cli_socket.is_connected();
+      if (r == 0) {
+        ASSERT_EQ(true, cb.poll(500));
+        r = cli_socket.is_connected();
+      }
+      ASSERT_EQ(1, r);
+      center->delete_file_event(cli_socket.fd(), EVENT_READABLE);
+    }
+    // a receiver that doesn't read keeps the sent bytes queued on the
+    // sender, so their completions can't have arrived yet
+    int small = 4096;
+    ASSERT_EQ(0, ::setsockopt(srv_socket.fd(), SOL_SOCKET, SO_RCVBUF,
+                              &small, sizeof(small)));
+
+    const size_t len = 16 << 20;
+    bufferptr bp = buffer::create_page_aligned(len);
+    memset(bp.c_str(), 'z', len);
+    bufferlist bl;
+    bl.append(bp);
+    ssize_t sent = cli_socket.send(bl, false);
+    ASSERT_LT(0, sent);
+    ASSERT_GT((ssize_t)len, sent);
+    bl.clear();
+    cli_socket.close();
+    ASSERT_LT(1, bp.raw_nref());
+
+    // once the receiver catches up, the completions are reaped from the
+    // closed socket's fd and the pins go
+    C_poll srv_cb(center);
+    center->create_file_event(srv_socket.fd(), EVENT_READABLE, &srv_cb);
+    char buf[65536];
+    for (ssize_t received = 0; received < sent; ) {
+      r = srv_socket.read(buf, sizeof(buf));
+      if (r == -EAGAIN) {
+        srv_cb.reset();
+        srv_cb.poll(10);
+        continue;
+      }
+      ASSERT_LT(0, r);
+      received += r;
+    }
+    for (int i = 0; i < 1000 && bp.raw_nref() > 1; ++i) {
+      center->process_events(1000);
+    }
+    ASSERT_EQ(1, bp.raw_nref());
+
+    center->delete_file_event(srv_socket.fd(), EVENT_READABLE);
+    bind_socket.abort_accept();
+    srv_socket.close();
+  });
+  g_ceph_context->_conf.set_val_or_die("ms_async_zerocopy", "false");
+}
+#endif
+
 TEST_P(NetworkWorkerTest, ConnectFailedTest) {
   entity_addr_t bind_addr;
   ASSERT_TRUE(bind_addr.parse(get_addr().c_str()));
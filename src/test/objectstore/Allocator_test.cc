@@ -13,6 +13,7 @@
 #include "include/stringify.h"
 #include "include/Context.h"
 #include "os/bluestore/Allocator.h"
+#include "alloc_trace_reader.h"
 
 using namespace std;
 
@@ -652,6 +653,94 @@ TEST_P(AllocTest, test_init_rm_free_unbound)
   }
 }
 
+TEST_P(AllocTest, test_alloc_trace)
+{
+  int64_t block_size = 0x1000;
+  int64_t capacity = 1024 * block_size;
+  init_alloc(capacity, block_size);
+  alloc->init_add_free(0, capacity);
+  PExtentVector before;
+  ASSERT_EQ(2 * block_size,
+	    alloc->allocate(2 * block_size, block_size, 0, 0, &before));
+
+  string path = "alloc_trace." + stringify(getpid()) + "." + GetParam();
+  ostringstream ss;
+  ASSERT_EQ(0, alloc->start_trace(path, ss));
+  ASSERT_TRUE(alloc->is_tracing());
+  PExtentVector a, b;
+  ASSERT_EQ(4 * block_size,
+	    alloc->allocate(4 * block_size, block_size, 0, 0, &a));
+  ASSERT_EQ(8 * block_size,
+	    alloc->allocate(8 * block_size, block_size, 0, 0, &b));
+  alloc->release(a);
+  // space allocated before the trace started is released as is
+  alloc->release(before);
+  alloc->stop_trace();
+  ASSERT_FALSE(alloc->is_tracing());
+  const uint64_t traced_free = alloc->get_free();
+
+  // the trace must not grow once stopped
+  PExtentVector after;
+  alloc->allocate(block_size, block_size, 0, 0, &after);
+
+  alloc_trace_reader_t t;
+  ASSERT_EQ(0, t.open(path.c_str()));
+  ::unlink(path.c_str());
+  ASSERT_EQ((uint64_t)capacity, t.capacity);
+  ASSERT_EQ((uint64_t)block_size, t.alloc_unit);
+  ASSERT_EQ(alloc->get_type(), t.alloc_type);
+
+  // replay into a fresh allocator of the same type, which must hand out
+  // exactly the traced extents
+  boost::scoped_ptr<Allocator> replay(
+    Allocator::create(g_ceph_context, GetParam(), capacity, block_size));
+  int type = t.get_type();
+  uint64_t snapshot_free = 0;
+  while (type == Allocator::TRACE_FREE) {
+    uint64_t offset, length;
+    ASSERT_TRUE(t.get(&offset));
+    ASSERT_TRUE(t.get(&length));
+    replay->init_add_free(offset, length);
+    snapshot_free += length;
+    type = t.get_type();
+  }
+  ASSERT_EQ((uint64_t)(capacity - 2 * block_size), snapshot_free);
+
+  std::vector<PExtentVector> allocated, released;
+  for (; type != EOF; type = t.get_type()) {
+    uint64_t dt;
+    ASSERT_TRUE(t.get(&dt));
+    if (type == Allocator::TRACE_ALLOC) {
+      uint64_t want, unit, max;
+      int64_t hint, result;
+      PExtentVector traced, got;
+      ASSERT_TRUE(t.get(&want));
+      ASSERT_TRUE(t.get(&unit));
+      ASSERT_TRUE(t.get(&max));
+      ASSERT_TRUE(t.get_signed(&hint));
+      ASSERT_TRUE(t.get_signed(&result));
+      ASSERT_TRUE(t.get_extents(&traced));
+      ASSERT_EQ(result, replay->allocate(want, unit, max, hint, &got));
+      ASSERT_EQ(traced, got);
+      allocated.push_back(traced);
+    } else {
+      ASSERT_EQ(Allocator::TRACE_RELEASE, type);
+      PExtentVector traced;
+      ASSERT_TRUE(t.get_extents(&traced));
+      replay->release(traced);
+      released.push_back(traced);
+    }
+  }
+  ASSERT_EQ(2u, allocated.size());
+  ASSERT_EQ(a, allocated[0]);
+  ASSERT_EQ(b, allocated[1]);
+  ASSERT_EQ(2u, released.size());
+  ASSERT_EQ(a, released[0]);
+  ASSERT_EQ(before, released[1]);
+  ASSERT_EQ(traced_free, replay->get_free());
+  replay->shutdown();
+}
+
 INSTANTIATE_TEST_SUITE_P(
   Allocator,
   AllocTest,
@@ -0,0 +1,88 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "os/bluestore/Allocator.h"
+
+/*
+ * Reads a trace recorded with
+ *   "ceph daemon <osd> bluestore allocator trace start <name> <path>"
+ */
+struct alloc_trace_reader_t {
+  FILE *f = nullptr;
+  uint64_t capacity = 0;
+  uint64_t alloc_unit = 0;
+  std::string alloc_type;
+
+  ~alloc_trace_reader_t() {
+    if (f) {
+      fclose(f);
+    }
+  }
+
+  int open(const char* fname) {
+    f = fopen(fname, "r");
+    if (!f) {
+      std::cerr << "error: unable to open " << fname << std::endl;
+      return -1;
+    }
+    char magic[sizeof(Allocator::TRACE_MAGIC)];
+    uint64_t type_len;
+    if (fread(magic, sizeof(magic), 1, f) != 1 ||
+        memcmp(magic, Allocator::TRACE_MAGIC, sizeof(magic)) != 0 ||
+        !get(&capacity) || !get(&alloc_unit) || !get(&type_len)) {
+      std::cerr << "error: " << fname << " is not an allocator trace"
+                << std::endl;
+      return -1;
+    }
+    alloc_type.resize(type_len);
+    if (fread(alloc_type.data(), 1, type_len, f) != type_len) {
+      std::cerr << "error: truncated trace header" << std::endl;
+      return -1;
+    }
+    return 0;
+  }
+  int get_type() {
+    return getc_unlocked(f);
+  }
+  bool get(uint64_t *v) {
+    *v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      int c = getc_unlocked(f);
+      if (c == EOF) {
+        return false;
+      }
+      *v |= uint64_t(c & 0x7f) << shift;
+      if (!(c & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  bool get_signed(int64_t *v) {
+    uint64_t u;
+    if (!get(&u)) {
+      return false;
+    }
+    *v = int64_t(u >> 1) ^ -int64_t(u & 1);
+    return true;
+  }
+  bool get_extents(PExtentVector *extents) {
+    uint64_t n, offset, length;
+    if (!get(&n)) {
+      return false;
+    }
+    while (n--) {
+      if (!get(&offset) || !get(&length)) {
+        return false;
+      }
+      extents->emplace_back(offset, length);
+    }
+    return true;
+  }
+};
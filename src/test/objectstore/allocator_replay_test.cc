@@ -16,6 +16,7 @@
 #include "include/denc.h"
 #include "global/global_init.h"
 #include "os/bluestore/Allocator.h"
+#include "alloc_trace_reader.h"
 
 using namespace std;
 
@@ -30,6 +31,9 @@ void usage(const string &name) {
           "export_binary <out_file>|"
           "free_histogram [<alloc_unit>] [<num_buckets>]"
        << std::endl;
+  cerr << "       " << name << " <alloc_trace> "
+       << "replay_trace [<alloc_type>] [<report_every_ops>]"
+       << std::endl;
 }
 
 void usage_replay_alloc(const string &name) {
@@ -534,6 +538,191 @@ int check_duplicates(char* fname)
   return r >= 0 ? errors != 0 : r;
 }
 
+static void dump_latencies(const char* what, std::vector<uint64_t>& lat)
+{
+  std::cout << what << ": " << lat.size() << " ops";
+  if (!lat.empty()) {
+    std::sort(lat.begin(), lat.end());
+    auto pct = [&](double p) {
+      return lat[size_t(p * (lat.size() - 1))];
+    };
+    std::cout << ", latency (ns)"
+              << " p50 " << pct(0.5)
+              << " p90 " << pct(0.9)
+              << " p99 " << pct(0.99)
+              << " p99.9 " << pct(0.999)
+              << " max " << lat.back();
+  }
+  std::cout << std::endl;
+}
+
+/*
+ * Replays a recorded trace against any allocator type.  The replayed
+ * allocator generally hands out different extents than the traced one,
+ * so released extents are translated through a map from traced to
+ * replayed offsets.  Releases of space that was in use before the trace
+ * started are applied as is.
+ */
+int replay_trace(const char* fname, string alloc_type, uint64_t report_every)
+{
+  alloc_trace_reader_t t;
+  if (t.open(fname) < 0) {
+    return -1;
+  }
+  if (alloc_type.empty()) {
+    alloc_type = t.alloc_type;
+  }
+  std::cout << "trace from " << t.alloc_type << " allocator, capacity 0x"
+            << std::hex << t.capacity << " alloc_unit 0x" << t.alloc_unit
+            << std::dec << ", replaying with " << alloc_type << std::endl;
+
+  auto mem_before = mempool::bluestore_alloc::allocated_bytes();
+  unique_ptr<Allocator> alloc(
+    Allocator::create(g_ceph_context, alloc_type, t.capacity, t.alloc_unit,
+                      "replay"));
+  if (!alloc) {
+    return -1;
+  }
+
+  interval_set<uint64_t> free_space;  // mirrors the replayed allocator
+  // traced offset -> (replayed offset, length)
+  std::map<uint64_t, std::pair<uint64_t, uint64_t>> xlate;
+  std::vector<uint64_t> alloc_lat, release_lat;
+  uint64_t ops = 0, failures = 0;
+
+  auto report = [&]() {
+    std::cout << "ops " << ops
+              << " free 0x" << std::hex << alloc->get_free() << std::dec
+              << " fragmentation " << alloc->get_fragmentation()
+              << " mem " << (mempool::bluestore_alloc::allocated_bytes() -
+                             mem_before)
+              << std::endl;
+  };
+  auto corrupt = [&]() {
+    std::cerr << "error: truncated or corrupt trace after " << ops << " ops"
+              << std::endl;
+    return -1;
+  };
+
+  int type = t.get_type();
+  while (type == Allocator::TRACE_FREE) {
+    uint64_t offset, length;
+    if (!t.get(&offset) || !t.get(&length)) {
+      return corrupt();
+    }
+    alloc->init_add_free(offset, length);
+    free_space.insert(offset, length);
+    type = t.get_type();
+  }
+  report();
+
+  for (; type != EOF; type = t.get_type(), ++ops) {
+    uint64_t dt;
+    if (!t.get(&dt)) {
+      return corrupt();
+    }
+    if (type == Allocator::TRACE_ALLOC) {
+      uint64_t want, unit, max;
+      int64_t hint, result;
+      PExtentVector traced, got;
+      if (!t.get(&want) || !t.get(&unit) || !t.get(&max) ||
+          !t.get_signed(&hint) || !t.get_signed(&result) ||
+          !t.get_extents(&traced)) {
+        return corrupt();
+      }
+      auto t0 = ceph::mono_clock::now();
+      auto r = alloc->allocate(want, unit, max, hint, &got);
+      alloc_lat.push_back((ceph::mono_clock::now() - t0).count());
+      if (r < 0) {
+        ++failures;
+        got.clear();
+      }
+      for (auto& e : got) {
+        free_space.erase(e.offset, e.length);
+      }
+      // pair traced and replayed bytes up in order
+      auto g = got.begin();
+      uint64_t g_pos = 0;
+      for (auto& e : traced) {
+        uint64_t pos = 0;
+        while (pos < e.length && g != got.end()) {
+          uint64_t l = std::min<uint64_t>(e.length - pos, g->length - g_pos);
+          xlate[e.offset + pos] = std::make_pair(g->offset + g_pos, l);
+          pos += l;
+          g_pos += l;
+          if (g_pos == g->length) {
+            ++g;
+            g_pos = 0;
+          }
+        }
+      }
+    } else if (type == Allocator::TRACE_RELEASE) {
+      PExtentVector traced;
+      if (!t.get_extents(&traced)) {
+        return corrupt();
+      }
+      interval_set<uint64_t> to_release;
+      for (auto& e : traced) {
+        uint64_t pos = e.offset, end = e.end();
+        auto p = xlate.upper_bound(pos);
+        if (p != xlate.begin()) {
+          --p;
+          if (p->first + p->second.second <= pos) {
+            ++p;
+          }
+        }
+        while (pos < end) {
+          if (p != xlate.end() && p->first <= pos) {
+            // translated: cut [pos, piece_end) out of the mapping
+            uint64_t start = p->first;
+            auto [rstart, rlen] = p->second;
+            uint64_t piece_end = std::min(end, start + rlen);
+            to_release.union_insert(rstart + (pos - start), piece_end - pos);
+            p = xlate.erase(p);
+            if (pos > start) {
+              xlate[start] = std::make_pair(rstart, pos - start);
+            }
+            if (piece_end < start + rlen) {
+              p = xlate.emplace(piece_end,
+                std::make_pair(rstart + (piece_end - start),
+                               start + rlen - piece_end)).first;
+            }
+            pos = piece_end;
+          } else {
+            // in use since before the trace started
+            uint64_t gap_end = p == xlate.end() ? end : std::min(end, p->first);
+            interval_set<uint64_t> gap, already_free;
+            gap.insert(pos, gap_end - pos);
+            already_free.intersection_of(gap, free_space);
+            gap.subtract(already_free);
+            for (auto [o, l] : gap) {
+              to_release.union_insert(o, l);
+            }
+            pos = gap_end;
+          }
+        }
+      }
+      auto t0 = ceph::mono_clock::now();
+      alloc->release(to_release);
+      release_lat.push_back((ceph::mono_clock::now() - t0).count());
+      free_space.union_of(to_release);
+    } else {
+      return corrupt();
+    }
+    if (report_every && ops % report_every == 0) {
+      report();
+    }
+  }
+
+  report();
+  std::cout << "Fragmentation score:" << alloc->get_fragmentation_score()
+            << std::endl;
+  std::cout << "Allocation failures: " << failures << std::endl;
+  dump_latencies("allocate", alloc_lat);
+  dump_latencies("release", release_lat);
+  return 0;
+}
+
 int main(int argc, char **argv)
 {
   auto args = argv_to_vec(argc, argv);
@@ -780,5 +969,9 @@ int main(int argc, char **argv)
     return export_as_binary(argv[1], argv[3]);
   } else if (strcmp(argv[2], "duplicates") == 0) {
     return check_duplicates(argv[1]);
+  } else if (strcmp(argv[2], "replay_trace") == 0) {
+    return replay_trace(argv[1],
+                        argc >= 4 ? argv[3] : "",
+                        argc >= 5 ? strtoull(argv[4], nullptr, 10) : 100000);
   }
 }
@@ -7374,6 +7374,77 @@ TEST_P(StoreTestSpecificAUSize, OnodeSizeTracking) {
   }
 }
 
+TEST_P(StoreTestSpecificAUSize, ClockOnodeCache) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  // small enough that the onode cache has to trim while we go
+  SetVal(g_conf(), "bluestore_onode_cache_type", "clock");
+  SetVal(g_conf(), "bluestore_cache_autotune", "false");
+  SetVal(g_conf(), "bluestore_cache_size_hdd", "4000000");
+  SetVal(g_conf(), "bluestore_cache_size_ssd", "4000000");
+  g_conf().apply_changes(nullptr);
+  StartDeferred(4096);
+
+  int r;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  const unsigned num_objects = 2000;
+  auto make_oid = [](unsigned i) {
+    return ghobject_t(hobject_t("clock_" + stringify(i), "", CEPH_NOSNAP,
+                                i, -1, ""));
+  };
+  for (unsigned i = 0; i < num_objects; ++i) {
+    ObjectStore::Transaction t;
+    bufferlist bl;
+    bl.append(std::string(4096, 'a' + i % 26));
+    t.write(cid, make_oid(i), 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // read everything back twice, so hot and cold onodes get swept and
+  // reloaded
+  for (unsigned pass = 0; pass < 2; ++pass) {
+    for (unsigned i = 0; i < num_objects; ++i) {
+      bufferlist bl;
+      r = store->read(ch, make_oid(i), 0, 4096, bl);
+      ASSERT_EQ(r, 4096);
+      ASSERT_EQ(bl[0], char('a' + i % 26));
+      // keep the first few hot
+      for (unsigned j = 0; j < 10; ++j) {
+        struct stat st;
+        ASSERT_EQ(store->stat(ch, make_oid(j), &st), 0);
+      }
+    }
+  }
+  for (unsigned i = 0; i < num_objects; i += 2) {
+    ObjectStore::Transaction t;
+    t.remove(cid, make_oid(i));
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  for (unsigned i = 0; i < num_objects; ++i) {
+    struct stat st;
+    ASSERT_EQ(store->stat(ch, make_oid(i), &st), i % 2 ? 0 : -ENOENT);
+  }
+  {
+    ObjectStore::Transaction t;
+    for (unsigned i = 1; i < num_objects; i += 2) {
+      t.remove(cid, make_oid(i));
+    }
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTestSpecificAUSize, BlobReuseOnOverwrite) {
 
   if (string(GetParam()) != "bluestore")
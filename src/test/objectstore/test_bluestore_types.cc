@@ -423,6 +423,59 @@ TEST(bluestore_blob_t, csum_bench)
   }
 }
 
+TEST(bluestore_deferred_transaction_t, compact)
+{
+  auto add = [](bluestore_deferred_transaction_t& t,
+		uint64_t offset, uint32_t length, char c) {
+    t.ops.push_back(bluestore_deferred_op_t());
+    t.ops.back().op = bluestore_deferred_op_t::OP_WRITE;
+    t.ops.back().extents.emplace_back(offset, length);
+    t.ops.back().data.append(string(length, c));
+  };
+  {
+    // a single extent is left alone
+    bluestore_deferred_transaction_t t;
+    add(t, 0x1000, 0x1000, 'a');
+    ASSERT_EQ(make_pair(0ul, 0ul), t.compact());
+    ASSERT_EQ(1u, t.ops.size());
+  }
+  {
+    // adjacent extents are merged, overwritten bytes dropped
+    bluestore_deferred_transaction_t t;
+    add(t, 0x1000, 0x1000, 'a');
+    add(t, 0x2000, 0x1000, 'b');
+    add(t, 0x1800, 0x1000, 'c');
+    add(t, 0x8000, 0x1000, 'd');
+    ASSERT_EQ(make_pair(0x1000ul, 2ul), t.compact());
+    ASSERT_EQ(1u, t.ops.size());
+    auto& op = t.ops.front();
+    ASSERT_EQ(2u, op.extents.size());
+    ASSERT_EQ(bluestore_pextent_t(0x1000, 0x2000), op.extents[0]);
+    ASSERT_EQ(bluestore_pextent_t(0x8000, 0x1000), op.extents[1]);
+    bufferlist expected;
+    expected.append(string(0x800, 'a'));
+    expected.append(string(0x1000, 'c'));
+    expected.append(string(0x800, 'b'));
+    expected.append(string(0x1000, 'd'));
+    ASSERT_TRUE(expected.contents_equal(op.data));
+  }
+  {
+    // a later write inside an earlier one splits it
+    bluestore_deferred_transaction_t t;
+    add(t, 0, 0x3000, 'a');
+    add(t, 0x1000, 0x1000, 'b');
+    ASSERT_EQ(make_pair(0x1000ul, 1ul), t.compact());
+    auto& op = t.ops.front();
+    ASSERT_EQ(1u, op.extents.size());
+    ASSERT_EQ(bluestore_pextent_t(0, 0x3000), op.extents[0]);
+    bufferlist expected;
+    expected.append(string(0x1000, 'a'));
+    expected.append(string(0x1000, 'b'));
+    expected.append(string(0x1000, 'a'));
+    ASSERT_TRUE(expected.contents_equal(op.data));
+  }
+}
+
 TEST(Blob, put_ref)
 {
   {
@@ -1017,6 +1070,102 @@ TEST(Blob, split)
   }
 }
 
+TEST(BufferSpace, lazy_map)
+{
+  BlueStore::BufferCacheShard *cache = BlueStore::BufferCacheShard::create(
+    g_ceph_context, "lru", NULL);
+  cache->set_max(1 << 20);
+  {
+    BlueStore::BufferSpace bs;
+    ASSERT_TRUE(bs.buffer_map.empty());
+    ASSERT_EQ(bs.buffer_map.end(), bs.buffer_map.find(0));
+    ASSERT_EQ(bs.buffer_map.end(), bs._data_lower_bound(0x1000));
+    bs.discard(cache, 0, 0x1000);
+    ASSERT_TRUE(bs.buffer_map.empty());
+
+    bufferlist bl;
+    bl.append(string(0x2000, 'a'));
+    bs.did_read(cache, 0x1000, bl);
+    ASSERT_EQ(1u, bs.buffer_map.size());
+
+    bs.discard(cache, 0x1000, 0x1000);
+    ASSERT_EQ(1u, bs.buffer_map.size());
+    bs.discard(cache, 0, 0x4000);
+    ASSERT_TRUE(bs.buffer_map.empty());
+    ASSERT_EQ(0u, bs.buffer_map.count(0x2000));
+
+    // reallocated on demand
+    bs.did_read(cache, 0, bl);
+    ASSERT_EQ(1u, bs.buffer_map.size());
+    std::lock_guard l(cache->lock);
+    bs._clear(cache);
+    ASSERT_TRUE(bs.buffer_map.empty());
+  }
+  delete cache;
+}
+
+TEST(ClockOnodeCacheShard, second_chance)
+{
+  BlueStore store(g_ceph_context, "", 4096);
+  BlueStore::OnodeCacheShard *oc = BlueStore::OnodeCacheShard::create(
+    g_ceph_context, "clock", NULL);
+  BlueStore::BufferCacheShard *bc = BlueStore::BufferCacheShard::create(
+    g_ceph_context, "lru", NULL);
+  auto coll = ceph::make_ref<BlueStore::Collection>(&store, oc, bc, coll_t());
+  oc->set_max(10);
+
+  std::map<std::string, BlueStore::Onode*> onodes;
+  auto add = [&](const std::string& name) {
+    ghobject_t oid(hobject_t(name, "", CEPH_NOSNAP, 0, 0, ""));
+    BlueStore::OnodeRef o(new BlueStore::Onode(coll.get(), oid, ""));
+    o->exists = true;
+    coll->onode_space.add_onode(oid, o);
+    onodes[name] = o.get();
+    // unpinned as soon as o goes out of scope
+  };
+  auto touch = [&](const std::string& name) {
+    BlueStore::OnodeRef o(onodes[name]);
+  };
+  auto cached = [&]() {
+    std::set<std::string> names;
+    coll->onode_space.map_any([&](BlueStore::Onode* o) {
+      names.insert(o->oid.hobj.oid.name);
+      return false;
+    });
+    return names;
+  };
+
+  add("a");
+  add("b");
+  add("c");
+  // new onodes start out referenced: the first sweep clears every bit,
+  // the second evicts the first one it comes back to
+  oc->set_max(2);
+  oc->trim();
+  ASSERT_EQ(std::set<std::string>({"b", "c"}), cached());
+
+  // b is referenced again and survives the next sweep, which takes c
+  touch("b");
+  oc->set_max(1);
+  oc->trim();
+  ASSERT_EQ(std::set<std::string>({"b"}), cached());
+
+  // that sweep aged b, so without another reference it goes next
+  add("d");
+  ASSERT_EQ(std::set<std::string>({"d"}), cached());
+
+  // pinned onodes are passed over until they are unpinned
+  {
+    BlueStore::OnodeRef pinned(onodes["d"]);
+    add("e");
+    oc->set_max(0);
+    oc->trim();
+    ASSERT_EQ(std::set<std::string>({"d"}), cached());
+  }
+  oc->trim();
+  ASSERT_EQ(std::set<std::string>(), cached());
+}
+
 TEST(Blob, legacy_decode)
 {
   BlueStore store(g_ceph_context, "", 4096);
@@ -16,7 +16,11 @@
 #include <sstream>
 #include <errno.h>
 #include <signal.h>
+#include <thread>
+#include "common/ceph_context.h"
+#include "messages/MOSDECSubOpRead.h"
 #include "osd/ECBackend.h"
+#include "test/erasure-code/ErasureCodeExample.h"
 #include "gtest/gtest.h"
 
 using namespace std;
@@ -60,3 +64,292 @@ TEST(ECUtil, stripe_info_t)
             make_pair((uint64_t)0, 2*swidth));
 }
 
+// just enough of a pg for a ReadPipeline to read the 2+1 shards of
+// ErasureCodeExample from osd.0, osd.1 and osd.2
+struct ReadListener : public ECListener {
+  OSDMapRef osdmap;
+  pg_info_t info;
+  std::set<pg_shard_t> acting;
+  std::set<pg_shard_t> empty_shards;
+  std::map<hobject_t, std::set<pg_shard_t>> missing_loc;
+  std::map<pg_shard_t, pg_missing_t> shard_missing;
+  pg_missing_t no_missing;
+  ceph_tid_t last_tid = 0;
+
+  // osds sub reads were sent to, in order
+  std::vector<int> sent;
+  // work queued with schedule_delayed_work(), and its delay
+  std::vector<std::pair<GenContextURef<ThreadPool::TPHandle&>,
+			ceph::timespan>> delayed;
+
+  ReadListener() {
+    info.pgid = spg_t(pg_t(0, 1));
+    for (int i = 0; i < 3; ++i) {
+      acting.insert(pg_shard_t(i, shard_id_t(i)));
+    }
+  }
+
+  const OSDMapRef& pgb_get_osdmap() const override { return osdmap; }
+  epoch_t pgb_get_osdmap_epoch() const override { return 1; }
+  const pg_info_t &get_info() const override { return info; }
+  void cancel_pull(const hobject_t &) override { ceph_abort(); }
+  pg_shard_t primary_shard() const override { return *acting.begin(); }
+  bool pgb_is_primary() const override { return true; }
+  void on_failed_pull(const std::set<pg_shard_t> &, const hobject_t &,
+		      const eversion_t &) override { ceph_abort(); }
+  void on_local_recover(const hobject_t &, const ObjectRecoveryInfo &,
+			ObjectContextRef, bool,
+			ceph::os::Transaction *) override { ceph_abort(); }
+  void on_global_recover(const hobject_t &, const object_stat_sum_t &,
+			 bool) override { ceph_abort(); }
+  void on_peer_recover(pg_shard_t, const hobject_t &,
+		       const ObjectRecoveryInfo &) override { ceph_abort(); }
+  void begin_peer_recover(pg_shard_t, const hobject_t) override {
+    ceph_abort();
+  }
+  bool pg_is_repair() const override { return false; }
+  ObjectContextRef get_obc(
+    const hobject_t &,
+    const std::map<std::string, bufferlist, std::less<>> &) override {
+    ceph_abort();
+  }
+  bool check_failsafe_full() override { return false; }
+  hobject_t get_temp_recovery_object(const hobject_t&, eversion_t) override {
+    ceph_abort();
+  }
+  bool pg_is_remote_backfilling() override { return false; }
+  void pg_add_local_num_bytes(int64_t) override {}
+  void pg_add_num_bytes(int64_t) override {}
+  void inc_osd_stat_repaired() override {}
+  void add_temp_obj(const hobject_t &) override {}
+  void clear_temp_obj(const hobject_t &) override {}
+  epoch_t get_last_peering_reset_epoch() const override { return 1; }
+  GenContext<ThreadPool::TPHandle&> *bless_unlocked_gencontext(
+    GenContext<ThreadPool::TPHandle&> *c) override { return c; }
+  void schedule_recovery_work(GenContext<ThreadPool::TPHandle&> *,
+			      uint64_t) override { ceph_abort(); }
+  void schedule_delayed_work(GenContext<ThreadPool::TPHandle&> *c,
+			     ceph::timespan delay) override {
+    delayed.emplace_back(GenContextURef<ThreadPool::TPHandle&>(c), delay);
+  }
+  OstreamTemp clog_warn() override { return OstreamTemp(CLOG_WARN, nullptr); }
+  epoch_t get_interval_start_epoch() const override { return 1; }
+  const std::set<pg_shard_t> &get_acting_shards() const override {
+    return acting;
+  }
+  const std::set<pg_shard_t> &get_backfill_shards() const override {
+    return empty_shards;
+  }
+  const std::map<hobject_t, std::set<pg_shard_t>> &get_missing_loc_shards()
+    const override {
+    return missing_loc;
+  }
+  const std::map<pg_shard_t, pg_missing_t> &get_shard_missing()
+    const override {
+    return shard_missing;
+  }
+  const pg_missing_const_i &get_shard_missing(pg_shard_t) const override {
+    return no_missing;
+  }
+  const pg_missing_const_i *maybe_get_shard_missing(
+    pg_shard_t) const override {
+    return &no_missing;
+  }
+  const pg_info_t &get_shard_info(pg_shard_t) const override { return info; }
+  ceph_tid_t get_tid() override { return ++last_tid; }
+  pg_shard_t whoami_shard() const override { return *acting.begin(); }
+  void send_message_osd_cluster(
+    std::vector<std::pair<int, Message*>>& messages, epoch_t) override {
+    for (auto &&[osd, m] : messages) {
+      sent.push_back(osd);
+      m->put();
+    }
+  }
+  std::ostream& gen_dbg_prefix(std::ostream& out) const override {
+    return out << "ReadListener ";
+  }
+  const pg_pool_t &get_pool() const override { ceph_abort(); }
+  const std::set<pg_shard_t> &get_acting_recovery_backfill_shards()
+    const override {
+    return acting;
+  }
+  bool should_send_op(pg_shard_t, const hobject_t &) override { return true; }
+  const std::map<pg_shard_t, pg_info_t> &get_shard_info() const override {
+    ceph_abort();
+  }
+  spg_t primary_spg_t() const override { return info.pgid; }
+  const PGLog &get_log() const override { ceph_abort(); }
+  DoutPrefixProvider *get_dpp() override { return nullptr; }
+  void apply_stats(const hobject_t &, const object_stat_sum_t &) override {}
+  bool is_missing_object(const hobject_t&) const override { return false; }
+  void add_local_next_event(const pg_log_entry_t&) override {}
+  void log_operation(
+    std::vector<pg_log_entry_t>&&,
+    const std::optional<pg_hit_set_history_t> &,
+    const eversion_t &,
+    const eversion_t &,
+    const eversion_t &,
+    bool,
+    ceph::os::Transaction &,
+    bool) override { ceph_abort(); }
+  void op_applied(const eversion_t &) override {}
+
+  void run_delayed(CephContext *cct) {
+    ThreadPool::TPHandle handle(cct, nullptr, ceph::timespan::zero(),
+				ceph::timespan::zero());
+    auto work = std::move(delayed);
+    delayed.clear();
+    for (auto &&[c, delay] : work) {
+      c.release()->complete(handle);
+    }
+  }
+};
+
+class ECHedgedRead : public ::testing::Test {
+public:
+  // 2+1 stripes of 8 bytes, the coding chunk is the xor of the data chunks
+  static constexpr uint64_t chunk_size = 4;
+  const std::string data = "abcdefgh";
+
+  boost::intrusive_ptr<CephContext> cct;
+  ECUtil::stripe_info_t sinfo{2, 2 * chunk_size};
+  ReadListener listener;
+  std::unique_ptr<ECCommon::ReadPipeline> pipeline;
+  hobject_t hoid{object_t("obj"), "", CEPH_NOSNAP, 0, 1, ""};
+
+  // completions of the client read, and what it returned
+  int completed = 0;
+  int result = -1;
+  bufferlist read;
+
+  void SetUp() override {
+    cct.reset(new CephContext(CEPH_ENTITY_TYPE_OSD), false);
+    cct->_conf.set_val_or_die("osd_ec_hedged_reads", "true");
+    cct->_conf.set_val_or_die("osd_ec_hedged_read_min_delay", "1");
+    cct->_conf.set_val_or_die("osd_ec_hedged_read_max_delay", "50");
+    cct->_conf.apply_changes(nullptr);
+    pipeline = std::make_unique<ECCommon::ReadPipeline>(
+      cct.get(), std::make_shared<ErasureCodeExample>(), sinfo, &listener);
+  }
+
+  void start_read() {
+    std::map<hobject_t,
+	     std::list<boost::tuple<uint64_t, uint64_t, uint32_t>>> reads;
+    reads[hoid].push_back(boost::make_tuple(0, data.size(), 0));
+    pipeline->objects_read_and_reconstruct(
+      reads, false,
+      make_gen_lambda_context<
+	std::map<hobject_t, std::pair<int, extent_map>>&&>(
+	  [this](std::map<hobject_t, std::pair<int, extent_map>> &&results) {
+	    ++completed;
+	    auto &[r, em] = results.at(hoid);
+	    result = r;
+	    read.clear();
+	    for (auto i = em.begin(); i != em.end(); ++i) {
+	      read.append(i.get_val());
+	    }
+	  }));
+  }
+
+  bufferlist chunk(int shard) const {
+    bufferlist bl;
+    if (shard < 2) {
+      bl.append(data.substr(shard * chunk_size, chunk_size));
+    } else {
+      for (unsigned i = 0; i < chunk_size; ++i) {
+	bl.append(char(data[i] ^ data[chunk_size + i]));
+      }
+    }
+    return bl;
+  }
+
+  void reply(int shard) {
+    ECSubReadReply r;
+    r.from = pg_shard_t(shard, shard_id_t(shard));
+    r.tid = listener.last_tid;
+    r.buffers_read[hoid].push_back(std::make_pair(0, chunk(shard)));
+    pipeline->handle_sub_read_reply(r.from, r);
+  }
+
+  // wait until the read of shard is due to be hedged
+  void wait_for_hedge(int shard) {
+    std::this_thread::sleep_for(pipeline->get_hedge_delay(shard));
+  }
+};
+
+TEST_F(ECHedgedRead, hedge_after_delay)
+{
+  start_read();
+  // the data shards are read first
+  ASSERT_EQ(std::vector<int>({0, 1}), listener.sent);
+  // no latency sampled yet, so the hedge waits for the max delay
+  ASSERT_EQ(1u, listener.delayed.size());
+  EXPECT_GE(std::chrono::milliseconds(50), listener.delayed[0].second);
+  EXPECT_LT(std::chrono::milliseconds(25), listener.delayed[0].second);
+  EXPECT_EQ(std::chrono::milliseconds(50), pipeline->get_hedge_delay(1));
+
+  reply(0);
+  EXPECT_EQ(0, completed);
+
+  // a timer that fires early only rearms itself
+  listener.run_delayed(cct.get());
+  EXPECT_EQ(2u, listener.sent.size());
+  ASSERT_EQ(1u, listener.delayed.size());
+
+  // osd.1 is slow: once its delay passed, the spare shard is read but
+  // the outstanding shard is not read again
+  wait_for_hedge(1);
+  listener.run_delayed(cct.get());
+  ASSERT_EQ(std::vector<int>({0, 1, 2}), listener.sent);
+  EXPECT_EQ(0, completed);
+
+  // the hedged shard answers first and wins
+  reply(2);
+  EXPECT_EQ(1, completed);
+  EXPECT_EQ(0, result);
+  EXPECT_EQ(data, read.to_str());
+  EXPECT_TRUE(pipeline->tid_to_read_map.empty());
+
+  // the straggler is dropped, and the read completes only once
+  reply(1);
+  EXPECT_EQ(1, completed);
+  EXPECT_EQ(3u, listener.sent.size());
+  for (auto &&[shard, tids] : pipeline->shard_to_read_map) {
+    EXPECT_TRUE(tids.empty()) << shard;
+  }
+}
+
+TEST_F(ECHedgedRead, straggler_wins)
+{
+  start_read();
+  reply(0);
+  wait_for_hedge(1);
+  listener.run_delayed(cct.get());
+  ASSERT_EQ(std::vector<int>({0, 1, 2}), listener.sent);
+
+  // the slow shard makes it before the hedged one
+  reply(1);
+  EXPECT_EQ(1, completed);
+  EXPECT_EQ(data, read.to_str());
+
+  reply(2);
+  EXPECT_EQ(1, completed);
+  EXPECT_TRUE(pipeline->tid_to_read_map.empty());
+}
+
+TEST_F(ECHedgedRead, no_hedge_when_done)
+{
+  start_read();
+  ASSERT_EQ(1u, listener.delayed.size());
+  reply(0);
+  reply(1);
+  EXPECT_EQ(1, completed);
+  EXPECT_EQ(data, read.to_str());
+
+  // the timer of a completed read does nothing
+  wait_for_hedge(1);
+  listener.run_delayed(cct.get());
+  EXPECT_EQ(2u, listener.sent.size());
+  EXPECT_TRUE(listener.delayed.empty());
+  EXPECT_EQ(1, completed);
+}
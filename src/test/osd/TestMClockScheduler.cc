@@ -261,3 +261,56 @@ TEST_F(mClockSchedulerTest, TestAllQueuesEnqueueDequeue) {
 
   ASSERT_TRUE(q.empty());
 }
+
+TEST_F(mClockSchedulerTest, TestDequeueBatch) {
+  ASSERT_TRUE(q.empty());
+
+  for (unsigned i = 100; i < 104; ++i) {
+    q.enqueue(create_item(i, client1, op_scheduler_class::client));
+    std::this_thread::sleep_for(std::chrono::microseconds(1));
+  }
+  q.enqueue(create_item(104, client1, op_scheduler_class::immediate));
+  q.enqueue(create_high_prio_item(200, 200, client1,
+				  op_scheduler_class::client));
+
+  // the high queues come first and the batch stops at max
+  std::vector<OpSchedulerItem> items;
+  ASSERT_EQ(3u, q.dequeue_batch(3, items));
+  ASSERT_EQ(3u, items.size());
+  ASSERT_EQ(104u, items[0].get_map_epoch());
+  ASSERT_EQ(200u, items[1].get_map_epoch());
+  ASSERT_EQ(100u, items[2].get_map_epoch());
+
+  // and stops early once the queue is empty
+  items.clear();
+  ASSERT_EQ(3u, q.dequeue_batch(10, items));
+  ASSERT_EQ(101u, items[0].get_map_epoch());
+  ASSERT_EQ(102u, items[1].get_map_epoch());
+  ASSERT_EQ(103u, items[2].get_map_epoch());
+  ASSERT_TRUE(q.empty());
+  ASSERT_EQ(0u, q.dequeue_batch(10, items));
+}
+
+TEST_F(mClockSchedulerTest, TestMultiClientDequeueBatch) {
+  const unsigned NUM = 1000;
+  for (unsigned i = 0; i < NUM; ++i) {
+    for (auto &&c: {client1, client2, client3}) {
+      q.enqueue(create_item(i, c));
+    }
+  }
+
+  // per client order is kept across batches
+  std::map<uint64_t, epoch_t> next;
+  std::vector<OpSchedulerItem> items;
+  while (!q.empty()) {
+    items.clear();
+    ASSERT_LT(0u, q.dequeue_batch(16, items));
+    ASSERT_GE(16u, items.size());
+    for (auto &r : items) {
+      ASSERT_EQ(next[r.get_owner()]++, r.get_map_epoch());
+    }
+  }
+  for (auto &&c: {client1, client2, client3}) {
+    ASSERT_EQ(NUM, next[c]);
+  }
+}
@@ -0,0 +1,114 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Scheduler throughput with dequeue() vs dequeue_batch().
+ *
+ * Not run as part of make check; run by hand, e.g.
+ *   ./bin/ceph_bench_mclock_scheduler --gtest_filter=*ops_per_sec*
+ */
+
+#include <chrono>
+#include <iostream>
+
+#include "gtest/gtest.h"
+
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "common/ceph_time.h"
+#include "common/common_init.h"
+
+#include "osd/scheduler/mClockScheduler.h"
+#include "osd/scheduler/OpSchedulerItem.h"
+
+using namespace ceph::osd::scheduler;
+
+int main(int argc, char **argv) {
+  std::vector<const char*> args(argv, argv+argc);
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+
+struct BenchItem : public PGOpQueueable {
+  op_scheduler_class scheduler_class;
+
+  explicit BenchItem(op_scheduler_class c)
+    : PGOpQueueable(spg_t()), scheduler_class(c) {}
+
+  ostream &print(ostream &rhs) const final { return rhs; }
+  std::string print() const final { return std::string(); }
+  std::optional<OpRequestRef> maybe_get_op() const final {
+    return std::nullopt;
+  }
+  op_scheduler_class get_scheduler_class() const final {
+    return scheduler_class;
+  }
+  void run(OSD *osd, OSDShard *sdata, PGRef& pg,
+	   ThreadPool::TPHandle &handle) final {}
+};
+
+class mClockSchedulerBench
+  : public ::testing::TestWithParam<std::tuple<unsigned, unsigned>> {
+public:
+  static constexpr unsigned num_ops = 200000;
+  // ops in the queue at any time, like a busy shard
+  static constexpr unsigned queue_depth = 256;
+
+  mClockScheduler q{g_ceph_context, 0, 1, 0, false, 12, nullptr};
+
+  OpSchedulerItem make_item(uint64_t owner) {
+    // the owners share the op classes, as clients of an osd do.  leave out
+    // background_best_effort: the default profile limits it, and we want
+    // to measure the scheduler rather than its limit.
+    static constexpr op_scheduler_class classes[] = {
+      op_scheduler_class::client,
+      op_scheduler_class::background_recovery,
+    };
+    return OpSchedulerItem(
+      std::make_unique<BenchItem>(classes[owner % std::size(classes)]),
+      4096, 12, utime_t(), owner, 1);
+  }
+};
+
+TEST_P(mClockSchedulerBench, ops_per_sec) {
+  auto [num_clients, batch] = GetParam();
+  unsigned enqueued = 0, dequeued = 0;
+  std::vector<OpSchedulerItem> items;
+  items.reserve(batch);
+
+  auto start = ceph::mono_clock::now();
+  while (dequeued < num_ops) {
+    while (enqueued < num_ops && enqueued - dequeued < queue_depth) {
+      q.enqueue(make_item(enqueued++ % num_clients));
+    }
+    if (batch <= 1) {
+      WorkItem w = q.dequeue();
+      if (std::get_if<OpSchedulerItem>(&w)) {
+	++dequeued;
+      }
+    } else {
+      items.clear();
+      dequeued += q.dequeue_batch(batch, items);
+    }
+  }
+  auto elapsed = ceph::mono_clock::now() - start;
+  double secs = std::chrono::duration<double>(elapsed).count();
+
+  std::cout << "clients " << num_clients
+	    << " batch " << batch
+	    << ": " << num_ops << " ops in " << secs << "s, "
+	    << (uint64_t)(num_ops / secs) << " ops/sec" << std::endl;
+  ASSERT_TRUE(q.empty());
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  mClockScheduler,
+  mClockSchedulerBench,
+  ::testing::Combine(
+    ::testing::Values(1u, 8u, 64u),    // clients
+    ::testing::Values(1u, 8u, 32u)));  // ops per dequeue call
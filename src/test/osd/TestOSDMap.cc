@@ -269,6 +269,44 @@ public:
     }
     return ruleno;
   }
+  // apply @inc to osdmap, update the mapping from what note_incremental()
+  // flagged, and check every pg against a full calculation
+  void apply_and_check_incremental_mapping(OSDMap::Incremental& inc) {
+    mapping.note_incremental(osdmap, inc);
+    ASSERT_EQ(0, osdmap.apply_incremental(inc));
+    mapping.update_dirty(osdmap);
+    ASSERT_EQ(osdmap.get_epoch(), mapping.get_epoch());
+    for (auto& [poolid, pool] : osdmap.get_pools()) {
+      for (unsigned ps = 0; ps < pool.get_pg_num(); ++ps) {
+	pg_t pgid(ps, poolid);
+	vector<int> up, acting, up2, acting2;
+	int up_primary, acting_primary, up_primary2, acting_primary2;
+	osdmap.pg_to_up_acting_osds(pgid, &up, &up_primary,
+				    &acting, &acting_primary);
+	mapping.get(pgid, &up2, &up_primary2, &acting2, &acting_primary2);
+	ASSERT_EQ(up, up2) << pgid;
+	ASSERT_EQ(up_primary, up_primary2) << pgid;
+	ASSERT_EQ(acting, acting2) << pgid;
+	ASSERT_EQ(acting_primary, acting_primary2) << pgid;
+      }
+    }
+    // the patched reverse maps match ones built from scratch, up to order
+    OSDMapMapping full;
+    full.update(osdmap);
+    auto sorted = [](auto v) {
+      std::sort(v.begin(), v.end());
+      return v;
+    };
+    ASSERT_EQ(full.acting_rmap.size(), mapping.acting_rmap.size());
+    ASSERT_EQ(full.up_rmap.size(), mapping.up_rmap.size());
+    for (unsigned osd = 0; osd < full.acting_rmap.size(); ++osd) {
+      ASSERT_EQ(full.acting_rmap[osd], sorted(mapping.acting_rmap[osd]))
+	<< "osd." << osd;
+      ASSERT_EQ(full.up_rmap[osd], sorted(mapping.up_rmap[osd]))
+	<< "osd." << osd;
+    }
+    ASSERT_EQ(full.degraded_pgs, sorted(mapping.degraded_pgs));
+  }
   void test_mappings(int pool,
 		     int num,
 		     vector<int> *any,
@@ -775,6 +813,104 @@ TEST_F(OSDMapTest, PrimaryAffinity) {
   }
 }
 
+TEST_F(OSDMapTest, IncrementalMapping) {
+  set_up_map();
+  {
+    // nothing computed yet, so this is a full pass
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    apply_and_check_incremental_mapping(inc);
+  }
+
+  pg_t rep_pg(0, my_rep_pool);
+  vector<int> up;
+  osdmap.pg_to_raw_up(rep_pg, &up, nullptr);
+  int down_osd = up[0];
+  {
+    // mark an osd down
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[down_osd] = CEPH_OSD_UP;
+    apply_and_check_incremental_mapping(inc);
+  }
+  {
+    // change primary affinity
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_primary_affinity[up[1]] = 0;
+    apply_and_check_incremental_mapping(inc);
+  }
+  {
+    // mark the down osd out
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_weight[down_osd] = CEPH_OSD_OUT;
+    apply_and_check_incremental_mapping(inc);
+  }
+  {
+    // bring it back up and in again; the weight increase means a full pass
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[down_osd] = CEPH_OSD_UP;
+    inc.new_weight[down_osd] = CEPH_OSD_IN;
+    apply_and_check_incremental_mapping(inc);
+  }
+  {
+    // upmap a pg away from its primary, then drop the upmap
+    int target = -1;
+    for (int i = 0; i < (int)get_num_osds(); ++i) {
+      if (std::find(up.begin(), up.end(), i) == up.end()) {
+	target = i;
+	break;
+      }
+    }
+    ASSERT_NE(-1, target);
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_pg_upmap_items[rep_pg] =
+      mempool::osdmap::vector<pair<int32_t,int32_t>>({{up[0], target}});
+    apply_and_check_incremental_mapping(inc);
+    OSDMap::Incremental inc2(osdmap.get_epoch() + 1);
+    inc2.old_pg_upmap_items.insert(rep_pg);
+    apply_and_check_incremental_mapping(inc2);
+  }
+  {
+    // pg_temp, and its osd going down while it's in place
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_pg_temp[rep_pg] =
+      mempool::osdmap::vector<int32_t>(up.rbegin(), up.rend());
+    apply_and_check_incremental_mapping(inc);
+    OSDMap::Incremental inc2(osdmap.get_epoch() + 1);
+    inc2.new_state[up[2]] = CEPH_OSD_UP;
+    apply_and_check_incremental_mapping(inc2);
+  }
+  {
+    // grow a pool
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    pg_pool_t pool = *osdmap.get_pg_pool(my_rep_pool);
+    pool.set_pg_num(pool.get_pg_num() * 2);
+    pool.set_pgp_num(pool.get_pgp_num() * 2);
+    pool.last_change = inc.epoch;
+    inc.new_pools[my_rep_pool] = pool;
+    apply_and_check_incremental_mapping(inc);
+  }
+  {
+    // two epochs noted before the mapping catches up: the second marks
+    // down an osd that pgs only moved to in the first, which the reverse
+    // maps from the last completed mapping don't know about yet
+    osdmap.pg_to_raw_up(rep_pg, &up, nullptr);
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[up[0]] = CEPH_OSD_UP;
+    mapping.note_incremental(osdmap, inc);
+    ASSERT_EQ(0, osdmap.apply_incremental(inc));
+    vector<int> new_up;
+    osdmap.pg_to_up_acting_osds(rep_pg, &new_up, nullptr, nullptr, nullptr);
+    OSDMap::Incremental inc2(osdmap.get_epoch() + 1);
+    inc2.new_state[new_up.back()] = CEPH_OSD_UP;
+    apply_and_check_incremental_mapping(inc2);
+  }
+  {
+    // a deleted pool leaves the reverse maps
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.old_pools.insert(my_ec_pool);
+    apply_and_check_incremental_mapping(inc);
+  }
+}
+
 TEST_F(OSDMapTest, get_osd_crush_node_flags) {
   set_up_map();
 
@@ -1628,6 +1764,48 @@ TEST_F(OSDMapTest, BUG_40104) {
   }
 }
 
+TEST_F(OSDMapTest, CalcPGUpmapsThreads) {
+  // the upmaps we come up with must not depend on the number of threads
+  set_up_map(60, true);
+  int64_t pool_id;
+  {
+    OSDMap::Incremental pending_inc(osdmap.get_epoch() + 1);
+    pending_inc.new_pool_max = osdmap.get_pool_max();
+    pool_id = ++pending_inc.new_pool_max;
+    pg_pool_t empty;
+    auto p = pending_inc.get_new_pool(pool_id, &empty);
+    p->size = 3;
+    p->min_size = 1;
+    p->set_pg_num(4096);
+    p->set_pgp_num(4096);
+    p->type = pg_pool_t::TYPE_REPLICATED;
+    p->crush_rule = 0;
+    p->set_flag(pg_pool_t::FLAG_HASHPSPOOL);
+    pending_inc.new_pool_names[pool_id] = "upmap_pool";
+    osdmap.apply_incremental(pending_inc);
+    ASSERT_TRUE(osdmap.have_pg_pool(pool_id));
+  }
+  auto calc = [&](const char *threads, bool aggressive) {
+    g_ceph_context->_conf.set_val("osd_calc_pg_upmaps_threads", threads);
+    g_ceph_context->_conf.set_val("osd_calc_pg_upmaps_aggressively",
+                                  aggressive ? "true" : "false");
+    std::random_device::result_type seed = 42;
+    OSDMap::Incremental pending_inc(osdmap.get_epoch() + 1);
+    int num_changed = osdmap.calc_pg_upmaps(g_ceph_context, 1, 100, {pool_id},
+                                            &pending_inc, &seed);
+    return std::make_pair(num_changed, pending_inc.new_pg_upmap_items);
+  };
+  for (bool aggressive : {false, true}) {
+    auto serial = calc("1", aggressive);
+    ASSERT_LT(0, serial.first);
+    auto parallel = calc("4", aggressive);
+    ASSERT_EQ(serial.first, parallel.first);
+    ASSERT_EQ(serial.second, parallel.second);
+  }
+  g_ceph_context->_conf.rm_val("osd_calc_pg_upmaps_threads");
+  g_ceph_context->_conf.rm_val("osd_calc_pg_upmaps_aggressively");
+}
+
 TEST_F(OSDMapTest, BUG_42052) {
   // https://tracker.ceph.com/issues/42052
   set_up_map(6, true);
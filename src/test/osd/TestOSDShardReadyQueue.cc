@@ -0,0 +1,140 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "osd/OSDShardReadyQueue.h"
+
+static spg_t make_token(unsigned i)
+{
+  return spg_t(pg_t(i, 1));
+}
+
+TEST(OSDShardReadyQueue, OwnEntriesFirst)
+{
+  OSDShardReadyQueue rq(2, 8);
+  EXPECT_FALSE(rq.has_ready());
+
+  rq.push(0, make_token(0));
+  rq.push(1, make_token(1));
+  EXPECT_TRUE(rq.has_ready());
+  EXPECT_EQ(2u, rq.get_num_ready());
+
+  OSDShardReadyQueue::entry_t e;
+  bool stolen = true;
+  ASSERT_TRUE(rq.pop(1, &e, &stolen));
+  EXPECT_EQ(make_token(1), e.token);
+  EXPECT_FALSE(stolen);
+
+  // thread 1's queue is empty now, so it steals from thread 0
+  ASSERT_TRUE(rq.pop(1, &e, &stolen));
+  EXPECT_EQ(make_token(0), e.token);
+  EXPECT_TRUE(stolen);
+
+  EXPECT_FALSE(rq.pop(1, &e, &stolen));
+  EXPECT_FALSE(rq.has_ready());
+  EXPECT_EQ(0u, rq.get_num_ready());
+}
+
+TEST(OSDShardReadyQueue, Fifo)
+{
+  OSDShardReadyQueue rq(1, 8);
+  for (unsigned i = 0; i < 16; ++i) { // grows past the reserve
+    rq.push(0, make_token(i));
+  }
+  OSDShardReadyQueue::entry_t e;
+  bool stolen;
+  for (unsigned i = 0; i < 16; ++i) {
+    ASSERT_TRUE(rq.pop(0, &e, &stolen));
+    EXPECT_EQ(make_token(i), e.token);
+  }
+  EXPECT_FALSE(rq.pop(0, &e, &stolen));
+}
+
+// producers push into the queues of several shards while consumers pop
+// from their own shard and steal from the others, as idle workers do.
+// every entry must be consumed exactly once, and the ready count must
+// never wrap below zero while entries are stolen as soon as they appear.
+TEST(OSDShardReadyQueue, StealAcrossShards)
+{
+  constexpr unsigned num_shards = 3;
+  constexpr unsigned threads_per_shard = 2;
+  constexpr unsigned per_producer = 20000;
+
+  std::vector<std::unique_ptr<OSDShardReadyQueue>> shards;
+  for (unsigned s = 0; s < num_shards; ++s) {
+    shards.push_back(std::make_unique<OSDShardReadyQueue>(threads_per_shard, 64));
+  }
+
+  std::atomic<bool> producing = true;
+  std::atomic<bool> wrapped = false;
+  std::vector<std::vector<spg_t>> consumed(num_shards * threads_per_shard);
+
+  auto consume = [&] (unsigned thread_index) {
+    const unsigned shard = thread_index % num_shards;
+    const unsigned shard_thread = thread_index / num_shards;
+    auto& out = consumed[thread_index];
+    for (;;) {
+      bool any = false;
+      for (unsigned i = 0; i < num_shards; ++i) {
+	auto& rq = *shards[(shard + i) % num_shards];
+	if (rq.get_num_ready() > num_shards * threads_per_shard * per_producer) {
+	  wrapped = true;
+	}
+	OSDShardReadyQueue::entry_t e;
+	bool stolen;
+	if (rq.pop(shard_thread, &e, &stolen)) {
+	  out.push_back(e.token);
+	  any = true;
+	  break;
+	}
+      }
+      if (!any && !producing) {
+	bool drained = true;
+	for (auto& rq : shards) {
+	  drained = drained && !rq->has_ready();
+	}
+	if (drained) {
+	  return;
+	}
+      }
+    }
+  };
+
+  std::vector<std::thread> producers, consumers;
+  for (unsigned t = 0; t < num_shards * threads_per_shard; ++t) {
+    consumers.emplace_back(consume, t);
+  }
+  for (unsigned t = 0; t < num_shards * threads_per_shard; ++t) {
+    producers.emplace_back([&, t] {
+      auto& rq = *shards[t % num_shards];
+      for (unsigned i = 0; i < per_producer; ++i) {
+	rq.push(t / num_shards, spg_t(pg_t(i, t)));
+      }
+    });
+  }
+  for (auto& p : producers) {
+    p.join();
+  }
+  producing = false;
+  for (auto& c : consumers) {
+    c.join();
+  }
+
+  EXPECT_FALSE(wrapped);
+  std::set<spg_t> seen;
+  for (auto& v : consumed) {
+    for (auto& token : v) {
+      EXPECT_TRUE(seen.insert(token).second) << token;
+    }
+  }
+  EXPECT_EQ(num_shards * threads_per_shard * per_producer, seen.size());
+  for (auto& rq : shards) {
+    EXPECT_EQ(0u, rq->get_num_ready());
+  }
+}
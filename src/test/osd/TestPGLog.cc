@@ -2234,7 +2234,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   log.add(modify);
 
   EXPECT_TRUE(log.logged_object(oid));
-  pg_log_entry_t *entry = log.objects[oid];
+  pg_log_entry_t *entry = log.objects.find(oid);
   EXPECT_EQ(modify.op, entry->op);
   EXPECT_EQ(modify.version, entry->version);
   EXPECT_EQ(modify.prior_version, entry->prior_version);
@@ -2248,7 +2248,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   log.add(del);
 
   EXPECT_TRUE(log.logged_object(oid));
-  entry = log.objects[oid];
+  entry = log.objects.find(oid);
   EXPECT_EQ(del.op, entry->op);
   EXPECT_EQ(del.version, entry->version);
   EXPECT_EQ(del.prior_version, entry->prior_version);
@@ -2261,7 +2261,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
 		   utime_t(20,1), -ENOENT));
 
   EXPECT_TRUE(log.logged_object(oid));
-  entry = log.objects[oid];
+  entry = log.objects.find(oid);
   EXPECT_EQ(del.op, entry->op);
   EXPECT_EQ(del.version, entry->version);
   EXPECT_EQ(del.prior_version, entry->prior_version);
@@ -2912,6 +2912,46 @@ TEST_F(PGLogTrimTest, TestGetRequest) {
   EXPECT_FALSE(result);
 }
 
+TEST_F(PGLogTrimTest, TestIndexTracksTrim) {
+  SetUp(20);
+  PGLog::IndexedLog log;
+  log.head = mk_evt(20, 0);
+  log.skip_can_rollback_to_to_head();
+  log.head = mk_evt(9, 0);
+
+  entity_name_t client = entity_name_t::CLIENT(777);
+
+  log.add(mk_ple_mod(mk_obj(1), mk_evt(10, 100), mk_evt(8, 70),
+		     osd_reqid_t(client, 8, 1)));
+  log.add(mk_ple_mod(mk_obj(2), mk_evt(15, 150), mk_evt(10, 100),
+		     osd_reqid_t(client, 8, 2)));
+  log.add(mk_ple_mod(mk_obj(1), mk_evt(20, 160), mk_evt(10, 100),
+		     osd_reqid_t(client, 8, 3)));
+  log.add(mk_ple_mod(mk_obj(3), mk_evt(21, 165), mk_evt(15, 150),
+		     osd_reqid_t(client, 8, 4)));
+
+  EXPECT_EQ(3u, log.objects.size());
+  EXPECT_EQ(4u, log.caller_ops.size());
+  ASSERT_TRUE(log.objects.find(mk_obj(1)));
+  EXPECT_EQ(mk_evt(20, 160), log.objects.find(mk_obj(1))->version);
+
+  log.trim(cct, mk_evt(15, 150), nullptr, nullptr, nullptr);
+
+  // the newer entry for obj 1 stays indexed, obj 2 went with its entry
+  EXPECT_EQ(2u, log.log.size());
+  EXPECT_EQ(2u, log.objects.size());
+  EXPECT_EQ(2u, log.caller_ops.size());
+  EXPECT_EQ(1u, log.dup_index.size());
+  EXPECT_EQ(nullptr, log.objects.find(mk_obj(2)));
+  ASSERT_TRUE(log.objects.find(mk_obj(1)));
+  EXPECT_EQ(&log.log.front(), log.objects.find(mk_obj(1)));
+  EXPECT_EQ(nullptr, log.caller_ops.find(osd_reqid_t(client, 8, 1)));
+  EXPECT_EQ(&log.log.back(), log.caller_ops.find(osd_reqid_t(client, 8, 4)));
+  ASSERT_TRUE(log.dup_index.find(osd_reqid_t(client, 8, 2)));
+  EXPECT_EQ(mk_evt(15, 150),
+	    log.dup_index.find(osd_reqid_t(client, 8, 2))->version);
+}
+
 TEST_F(PGLogTest, _merge_object_divergent_entries) {
   {
     // Test for issue 20843
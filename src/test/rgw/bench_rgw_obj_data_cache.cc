@@ -0,0 +1,252 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+/*
+ * Load generator for RGWObjDataCache. Clients run as coroutines on an asio
+ * io_context, the same way the beast frontend serves requests, and issue
+ * GETs for objects picked from a zipf distribution. Each simulated RADOS op
+ * waits for the backend latency, and a GET issues the ops that the RADOS
+ * driver would:
+ * - a fresh cached head: none
+ * - a stale cached head: a stat of the head's attributes, plus a data read
+ *   if the object changed
+ * - not cached: a stat of the head that returns its data too
+ * A fraction of requests overwrite their object instead. Writes through this
+ * gateway invalidate the cached copy; writes through other gateways are only
+ * noticed once the cached head goes stale, and reads served in between are
+ * counted as stale reads.
+ */
+
+#include "rgw_obj_data_cache.h"
+#include "common/ceph_context.h"
+#include "global/global_context.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/program_options.hpp>
+#include <spawn/spawn.hpp>
+
+struct parameters {
+  uint64_t num_objects = 100000;
+  uint64_t obj_size = 16 * 1024;
+  double zipf_skew = 0.99;
+  double write_ratio = 0.01;
+  double remote_write_ratio = 0;
+  int backend_latency_us = 500;
+  int num_clients = 256;
+};
+
+struct client_stats {
+  uint64_t reads = 0;
+  uint64_t hits = 0;
+  uint64_t rados_ops = 0;
+  uint64_t stale_reads = 0;
+  uint64_t writes = 0;
+};
+
+// cumulative distribution of a zipf(skew) popularity over num_objects
+static std::vector<double> make_zipf_cdf(uint64_t num_objects, double skew)
+{
+  std::vector<double> cdf(num_objects);
+  double sum = 0;
+  for (uint64_t i = 0; i < num_objects; ++i) {
+    sum += 1.0 / std::pow(i + 1, skew);
+    cdf[i] = sum;
+  }
+  for (auto& c : cdf) {
+    c /= sum;
+  }
+  return cdf;
+}
+
+static void simulate_client(RGWObjDataCache& cache, const parameters& params,
+                            const std::vector<double>& cdf,
+                            std::vector<std::atomic<uint32_t>>& versions,
+                            client_stats& stats, const std::atomic<bool>& to_run,
+                            boost::asio::io_context& ioctx,
+                            spawn::yield_context yield)
+{
+  std::default_random_engine rng{std::random_device{}()};
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  boost::asio::steady_timer timer(ioctx);
+  const std::string data(params.obj_size, 'x');
+
+  auto rados_op = [&] {
+    timer.expires_after(std::chrono::microseconds(params.backend_latency_us));
+    timer.async_wait(yield);
+    ++stats.rados_ops;
+  };
+  // what a stat of the head returns for the current version
+  auto read_head = [&] (uint32_t v) {
+    RGWObjDataCache::Head head;
+    head.size = params.obj_size;
+    head.attrs["user.rgw.idtag"].append(std::to_string(v));
+    head.stamp = ceph::coarse_mono_clock::now();
+    return head;
+  };
+  auto make_version = [&] (const RGWObjDataCache::Head& head) {
+    RGWObjDataCache::Version version;
+    version.tag = head.attrs.at("user.rgw.idtag").to_str();
+    version.size = params.obj_size;
+    return version;
+  };
+
+  while (to_run) {
+    const uint64_t n = std::lower_bound(cdf.begin(), cdf.end(), dist(rng)) - cdf.begin();
+    const auto key = RGWObjDataCache::make_key("bucket:1", std::to_string(n));
+
+    const double op = dist(rng);
+    if (op < params.write_ratio + params.remote_write_ratio) {
+      rados_op();
+      ++versions[n];
+      if (op < params.write_ratio) {
+        cache.invalidate(key);
+      }
+      ++stats.writes;
+      continue;
+    }
+
+    ++stats.reads;
+    const uint32_t current = versions[n];
+    RGWObjDataCache::Head head;
+    bufferlist bl;
+    const auto cached = cache.get_head(key, &head, &bl);
+    if (cached == RGWObjDataCache::HeadLookup::fresh) {
+      if (cache.get(key, make_version(head), bl)) {
+        ++stats.hits;
+        if (make_version(head).tag != std::to_string(current)) {
+          ++stats.stale_reads;
+        }
+        continue;
+      }
+      head = read_head(current);
+      rados_op();
+    } else {
+      head = read_head(current);
+      rados_op();
+      if (cached == RGWObjDataCache::HeadLookup::stale) {
+        cache.revalidate_head(key, head);
+      }
+    }
+    const auto version = make_version(head);
+    if (cache.get(key, version, bl)) {
+      ++stats.hits;
+      continue;
+    }
+    if (cached == RGWObjDataCache::HeadLookup::stale) {
+      // only the attributes were read, now read the data
+      rados_op();
+    }
+    bl.append(data);
+    cache.put(key, version, std::move(bl), std::move(head));
+  }
+}
+
+int main(int argc, char **argv)
+{
+  parameters params;
+  uint64_t cache_size = 256 << 20;
+  int ttl_ms = 2000;
+  int thread_count = 8;
+  int runtime = 30;
+  try {
+    using namespace boost::program_options;
+    options_description desc{"Options"};
+    desc.add_options()
+      ("help,h", "Help screen")
+      ("objects", value<uint64_t>()->default_value(params.num_objects), "number of distinct objects")
+      ("obj_size", value<uint64_t>()->default_value(params.obj_size), "object size in bytes")
+      ("cache_size", value<uint64_t>()->default_value(cache_size), "cache size in bytes")
+      ("zipf", value<double>()->default_value(params.zipf_skew), "zipf skew of object popularity")
+      ("write_ratio", value<double>()->default_value(params.write_ratio), "fraction of requests that overwrite the object")
+      ("remote_write_ratio", value<double>()->default_value(params.remote_write_ratio), "fraction of requests that overwrite the object through another gateway")
+      ("ttl_ms", value<int>()->default_value(ttl_ms), "how long a cached head is used without reading it again")
+      ("backend_latency_us", value<int>()->default_value(params.backend_latency_us), "simulated latency of a read from rados")
+      ("clients", value<int>()->default_value(params.num_clients), "number of concurrent clients")
+      ("threads", value<int>()->default_value(thread_count), "server's threads count")
+      ("runtime", value<int>()->default_value(runtime), "for how many seconds the test will run");
+    variables_map vm;
+    store(parse_command_line(argc, argv, desc), vm);
+    if (vm.count("help")) {
+      std::cout << desc << std::endl;
+      return EXIT_SUCCESS;
+    }
+    params.num_objects = vm["objects"].as<uint64_t>();
+    params.obj_size = vm["obj_size"].as<uint64_t>();
+    params.zipf_skew = vm["zipf"].as<double>();
+    params.write_ratio = vm["write_ratio"].as<double>();
+    params.remote_write_ratio = vm["remote_write_ratio"].as<double>();
+    ttl_ms = vm["ttl_ms"].as<int>();
+    params.backend_latency_us = vm["backend_latency_us"].as<int>();
+    params.num_clients = vm["clients"].as<int>();
+    cache_size = vm["cache_size"].as<uint64_t>();
+    thread_count = vm["threads"].as<int>();
+    runtime = vm["runtime"].as<int>();
+  } catch (const boost::program_options::error &ex) {
+    std::cerr << ex.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::unique_ptr<CephContext> cct = std::make_unique<CephContext>(CEPH_ENTITY_TYPE_ANY);
+  if (!g_ceph_context) {
+    g_ceph_context = cct.get();
+  }
+  RGWObjDataCache cache(g_ceph_context, cache_size, params.obj_size,
+                        std::chrono::milliseconds(ttl_ms));
+
+  const auto cdf = make_zipf_cdf(params.num_objects, params.zipf_skew);
+  std::vector<std::atomic<uint32_t>> versions(params.num_objects);
+  std::vector<client_stats> stats(params.num_clients);
+
+  boost::asio::io_context context;
+  auto work = boost::asio::make_work_guard(context);
+  std::atomic<bool> to_run = true;
+  for (int i = 0; i < params.num_clients; i++) {
+    spawn::spawn(context, [&, i] (spawn::yield_context yield) {
+      simulate_client(cache, params, cdf, versions, stats[i], to_run,
+                      context, yield);
+    });
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  threads.reserve(thread_count);
+  for (int i = 0; i < thread_count; i++) {
+    threads.emplace_back([&] () noexcept { context.run(); });
+  }
+  std::this_thread::sleep_for(std::chrono::seconds(runtime));
+  to_run = false;
+  work.reset();
+  for (auto& t : threads) {
+    t.join();
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  client_stats total;
+  for (auto& s : stats) {
+    total.reads += s.reads;
+    total.hits += s.hits;
+    total.rados_ops += s.rados_ops;
+    total.stale_reads += s.stale_reads;
+    total.writes += s.writes;
+  }
+  std::cout << "reads: " << total.reads
+            << " writes: " << total.writes
+            << " hit ratio: " << (total.reads ? double(total.hits) / total.reads : 0)
+            << " rados ops/read: "
+            << (total.reads ? double(total.rados_ops - total.writes) / total.reads : 0)
+            << " stale reads: " << total.stale_reads
+            << " reads/s: " << total.reads / elapsed.count()
+            << " cached bytes: " << cache.get_size()
+            << " cached objects: " << cache.get_num_entries()
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,270 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#include "driver/rados/rgw_bucket_list_merge.h"
+#include "cls/rgw/cls_rgw_const.h"
+#include <gtest/gtest.h>
+
+#include <map>
+#include <optional>
+#include <set>
+
+using rgw::bucket_list::ShardMerge;
+using rgw::bucket_list::ShardReader;
+
+// serves chunks of in-memory sorted shards, the way the cls op does
+class FakeShardReader : public ShardReader {
+ public:
+  std::vector<std::vector<std::string>> shards;
+  size_t chunk;
+  // what the osd answers when no chunk is returned
+  bool returns_marker = true;
+  bool moves_marker = true;
+
+  std::vector<std::optional<cls_rgw_obj_key>> started;
+  unsigned starts = 0;
+  unsigned finishes = 0;
+  std::set<size_t> cancelled;
+
+  FakeShardReader(std::vector<std::vector<std::string>> shards, size_t chunk)
+    : shards(std::move(shards)), chunk(chunk), started(this->shards.size())
+  {}
+
+  rgw_cls_list_ret read(size_t idx, const std::string& after) const {
+    rgw_cls_list_ret ret;
+    ret.is_truncated = false;
+    auto& names = shards[idx];
+    auto i = std::upper_bound(names.begin(), names.end(), after);
+    for (; i != names.end() && ret.dir.m.size() < chunk; ++i) {
+      rgw_bucket_dir_entry e;
+      e.key.name = *i;
+      e.exists = true;
+      ret.dir.m.emplace(*i, std::move(e));
+    }
+    if (i != names.end()) {
+      ret.is_truncated = true;
+      if (returns_marker) {
+	ret.marker.name = moves_marker ? *std::prev(i) : after;
+      }
+    }
+    return ret;
+  }
+
+  int start(size_t idx, const cls_rgw_obj_key& marker) override {
+    EXPECT_FALSE(started[idx]) << "second read of shard " << idx;
+    started[idx] = marker;
+    ++starts;
+    return 0;
+  }
+  int finish(size_t idx, rgw_cls_list_ret* result) override {
+    EXPECT_TRUE(started[idx]) << "no read of shard " << idx;
+    *result = read(idx, started[idx]->name);
+    started[idx].reset();
+    ++finishes;
+    return 0;
+  }
+  void cancel(size_t idx) override {
+    EXPECT_TRUE(started[idx]);
+    started[idx].reset();
+    cancelled.insert(idx);
+  }
+
+  std::vector<rgw_cls_list_ret> first_chunks() const {
+    std::vector<rgw_cls_list_ret> results;
+    for (size_t i = 0; i < shards.size(); ++i) {
+      results.push_back(read(i, ""));
+    }
+    return results;
+  }
+};
+
+// list up to max entries, returning the names in order and whether the
+// page stopped early
+static std::vector<std::string> list(ShardMerge& merge, size_t max,
+				     bool* stopped)
+{
+  std::vector<std::string> names;
+  *stopped = false;
+  while (names.size() < max && !merge.empty()) {
+    names.push_back(merge.entry().key.name);
+    EXPECT_EQ(0, merge.advance(names.size() < max, stopped));
+    if (*stopped) {
+      break;
+    }
+  }
+  return names;
+}
+
+// take the next entry, still wanting more
+static std::string take(ShardMerge& merge)
+{
+  std::string name = merge.entry().key.name;
+  bool stopped;
+  EXPECT_EQ(0, merge.advance(true, &stopped));
+  EXPECT_FALSE(stopped);
+  return name;
+}
+
+TEST(BucketListMerge, MergesInOrder)
+{
+  FakeShardReader reader({{"a", "d", "g", "j"},
+			  {"b", "e", "h"},
+			  {"c", "f", "i", "k", "l"}}, 100);
+  ShardMerge merge(reader, reader.first_chunks(), 1);
+  bool stopped;
+  auto names = list(merge, 100, &stopped);
+  EXPECT_FALSE(stopped);
+  EXPECT_EQ(std::vector<std::string>({"a", "b", "c", "d", "e", "f", "g",
+				      "h", "i", "j", "k", "l"}), names);
+  EXPECT_FALSE(merge.is_truncated());
+  EXPECT_EQ(0u, reader.starts);
+}
+
+TEST(BucketListMerge, DuplicateNamesAdvanceEveryShard)
+{
+  // a name on several shards (e.g. a common prefix) is returned once
+  FakeShardReader reader({{"a", "p/", "z"},
+			  {"p/", "q"},
+			  {"b", "p/"}}, 100);
+  ShardMerge merge(reader, reader.first_chunks(), 1);
+  bool stopped;
+  auto names = list(merge, 100, &stopped);
+  EXPECT_EQ(std::vector<std::string>({"a", "b", "p/", "q", "z"}), names);
+  EXPECT_FALSE(merge.is_truncated());
+}
+
+TEST(BucketListMerge, ContinuesTruncatedShards)
+{
+  std::vector<std::vector<std::string>> shards(3);
+  std::vector<std::string> all;
+  for (int i = 0; i < 60; ++i) {
+    char name[8];
+    snprintf(name, sizeof(name), "o%03d", i);
+    shards[i % 3].push_back(name);
+    all.push_back(name);
+  }
+  FakeShardReader reader(shards, 4);
+  ShardMerge merge(reader, reader.first_chunks(), 2);
+  bool stopped;
+  auto names = list(merge, 60, &stopped);
+  EXPECT_FALSE(stopped);
+  EXPECT_EQ(all, names);
+  EXPECT_FALSE(merge.is_truncated());
+  // every chunk but the first of each shard was read once
+  EXPECT_EQ(3u * (20 / 4 - 1), merge.reads());
+  EXPECT_EQ(reader.starts, reader.finishes);
+  EXPECT_TRUE(reader.cancelled.empty());
+}
+
+TEST(BucketListMerge, ReadsAheadPerShard)
+{
+  // shard 0 drains long before the others; only it reads ahead
+  FakeShardReader reader({{"a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7"},
+			  {"b0", "b1", "b2", "b3"},
+			  {"c0", "c1", "c2", "c3"}}, 4);
+  ShardMerge merge(reader, reader.first_chunks(), 2);
+  EXPECT_EQ("a0", take(merge));
+  EXPECT_EQ("a1", take(merge));
+  EXPECT_EQ(0u, reader.starts);
+  // shard 0 now has fewer than 2 entries left
+  EXPECT_EQ("a2", take(merge));
+  ASSERT_EQ(1u, reader.starts);
+  ASSERT_TRUE(reader.started[0]);
+  EXPECT_EQ("a3", reader.started[0]->name);
+  EXPECT_FALSE(reader.started[1]);
+  EXPECT_FALSE(reader.started[2]);
+  EXPECT_EQ(0u, reader.finishes);
+
+  // the read ahead is used once shard 0 drains
+  bool stopped;
+  auto names = list(merge, 100, &stopped);
+  EXPECT_EQ(std::vector<std::string>({"a3", "a4", "a5", "a6", "a7",
+				      "b0", "b1", "b2", "b3",
+				      "c0", "c1", "c2", "c3"}), names);
+  EXPECT_EQ(1u, reader.starts);
+  EXPECT_EQ(1u, reader.finishes);
+  EXPECT_EQ(1u, merge.reads());
+}
+
+TEST(BucketListMerge, CancelsUnusedReadAhead)
+{
+  FakeShardReader reader({{"a0", "a1", "a2", "a3", "a4", "a5"},
+			  {"b0", "b1"}}, 3);
+  {
+    ShardMerge merge(reader, reader.first_chunks(), 2);
+    EXPECT_EQ("a0", take(merge));
+    // still wanting more, shard 0 reads ahead ...
+    EXPECT_EQ("a1", take(merge));
+    EXPECT_EQ(1u, reader.starts);
+    EXPECT_TRUE(merge.is_truncated());
+  }
+  // ... but the page filled before it was needed
+  EXPECT_EQ(0u, reader.finishes);
+  EXPECT_EQ(std::set<size_t>({0}), reader.cancelled);
+}
+
+TEST(BucketListMerge, NoReadAheadWhenPageIsFull)
+{
+  FakeShardReader reader({{"a0", "a1", "a2", "a3", "a4", "a5"},
+			  {"b0", "b1"}}, 3);
+  {
+    ShardMerge merge(reader, reader.first_chunks(), 2);
+    bool stopped;
+    auto names = list(merge, 2, &stopped);
+    EXPECT_EQ(std::vector<std::string>({"a0", "a1"}), names);
+  }
+  EXPECT_EQ(0u, reader.starts);
+  EXPECT_TRUE(reader.cancelled.empty());
+}
+
+TEST(BucketListMerge, StopsWithoutProgress)
+{
+  FakeShardReader reader({{"a0", "a1", "a2", "a3", "a4", "a5"},
+			  {"b0", "b1"}}, 2);
+  auto first = reader.first_chunks();
+  // the osd keeps answering with the marker it was given from here on
+  reader.moves_marker = false;
+  ShardMerge merge(reader, std::move(first), 1);
+  bool stopped;
+  auto names = list(merge, 100, &stopped);
+  // the shard is not treated as drained; the page ends where it ran dry
+  EXPECT_TRUE(stopped);
+  EXPECT_EQ(std::vector<std::string>({"a0", "a1"}), names);
+  EXPECT_TRUE(merge.is_truncated());
+  EXPECT_EQ(1u, reader.finishes);
+}
+
+TEST(BucketListMerge, StopsWithoutMarker)
+{
+  // older osds do not return a marker; a drained truncated shard ends
+  // the page as it did before shards were continued
+  FakeShardReader reader({{"a0", "a1", "a2", "a3"},
+			  {"b0", "b1"}}, 2);
+  reader.returns_marker = false;
+  ShardMerge merge(reader, reader.first_chunks(), 1);
+  bool stopped;
+  auto names = list(merge, 100, &stopped);
+  EXPECT_TRUE(stopped);
+  EXPECT_EQ(std::vector<std::string>({"a0", "a1"}), names);
+  EXPECT_TRUE(merge.is_truncated());
+  EXPECT_EQ(0u, reader.starts);
+}
+
+TEST(BucketListMerge, EntriesOutliveRefill)
+{
+  FakeShardReader reader({{"a0", "a1", "a2", "a3"}}, 2);
+  ShardMerge merge(reader, reader.first_chunks(), 1);
+  std::vector<rgw_bucket_dir_entry*> visited;
+  bool stopped;
+  while (!merge.empty()) {
+    visited.push_back(&merge.entry());
+    ASSERT_EQ(0, merge.advance(true, &stopped));
+  }
+  EXPECT_EQ(1u, merge.reads());
+  // the entries of the first chunk are still there after the refill
+  std::vector<std::string> names;
+  for (auto e : visited) {
+    names.push_back(e->key.name);
+  }
+  EXPECT_EQ(std::vector<std::string>({"a0", "a1", "a2", "a3"}), names);
+}
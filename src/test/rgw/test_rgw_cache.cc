@@ -0,0 +1,143 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#include "rgw_cache.h"
+#include "common/dout.h"
+#include "global/global_context.h"
+#include <gtest/gtest.h>
+
+#include <map>
+#include <set>
+
+#define dout_subsys ceph_subsys_rgw
+
+class ObjectCacheTest : public ::testing::Test {
+protected:
+  NoDoutPrefix dpp{g_ceph_context, dout_subsys};
+  std::unique_ptr<ObjectCache> cache;
+
+  void make_cache(uint64_t shards, int64_t lru_size) {
+    g_ceph_context->_conf.set_val_or_die("rgw_cache_shards",
+                                         std::to_string(shards));
+    g_ceph_context->_conf.set_val_or_die("rgw_cache_lru_size",
+                                         std::to_string(lru_size));
+    cache = std::make_unique<ObjectCache>();
+    cache->set_ctx(g_ceph_context);
+    cache->set_enabled(true);
+  }
+
+  void put(const std::string& name) {
+    ObjectCacheInfo info;
+    info.status = 0;
+    info.flags = CACHE_FLAG_DATA;
+    info.data.append(name);
+    cache->put(&dpp, name, info, nullptr);
+  }
+
+  bool hit(const std::string& name) {
+    return cache->get(&dpp, name).has_value();
+  }
+
+  // the cached names, without marking them referenced as get() would
+  std::set<std::string> cached() {
+    std::set<std::string> names;
+    cache->for_each([&names] (const std::string& name,
+                              const ObjectCacheEntry&) {
+      names.insert(name);
+    });
+    return names;
+  }
+};
+
+TEST_F(ObjectCacheTest, EvictsOldestUnreferenced)
+{
+  make_cache(1, 3);
+  put("a");
+  put("b");
+  put("c");
+  put("d");
+  EXPECT_EQ(std::set<std::string>({"b", "c", "d"}), cached());
+  put("e");
+  EXPECT_EQ(std::set<std::string>({"c", "d", "e"}), cached());
+}
+
+TEST_F(ObjectCacheTest, SecondChance)
+{
+  make_cache(1, 3);
+  put("a");
+  put("b");
+  put("c");
+  // a hit spares "a" from the next sweep, which takes "b" instead
+  ASSERT_TRUE(hit("a"));
+  put("d");
+  EXPECT_EQ(std::set<std::string>({"a", "c", "d"}), cached());
+
+  // the sweep cleared the reference, so "a" goes once the hand is back
+  // unless it is hit again
+  put("e");
+  EXPECT_EQ(std::set<std::string>({"a", "d", "e"}), cached());
+  put("f");
+  EXPECT_EQ(std::set<std::string>({"d", "e", "f"}), cached());
+}
+
+TEST_F(ObjectCacheTest, RewriteIsAReference)
+{
+  make_cache(1, 3);
+  put("a");
+  put("b");
+  put("c");
+  // a put() of a cached entry updates it in place and marks it referenced
+  put("a");
+  put("d");
+  EXPECT_EQ(std::set<std::string>({"a", "c", "d"}), cached());
+}
+
+TEST_F(ObjectCacheTest, PerShardCapacity)
+{
+  constexpr uint64_t num_shards = 4;
+  // each shard holds its part of rgw_cache_lru_size, rounded up
+  make_cache(num_shards, 7);
+  for (int i = 0; i < 64; i++) {
+    put("obj" + std::to_string(i));
+  }
+  std::map<size_t, unsigned> per_shard;
+  for (auto& name : cached()) {
+    per_shard[std::hash<std::string>{}(name) % num_shards]++;
+  }
+  ASSERT_EQ(num_shards, per_shard.size());
+  for (auto [shard, n] : per_shard) {
+    EXPECT_EQ(2u, n) << "shard " << shard;
+  }
+
+  // eviction in one shard leaves the others alone
+  const auto before = cached();
+  std::string name;
+  for (int i = 64; ; i++) {
+    name = "obj" + std::to_string(i);
+    if (std::hash<std::string>{}(name) % num_shards == 0) {
+      break;
+    }
+  }
+  put(name);
+  const auto after = cached();
+  EXPECT_EQ(before.size(), after.size());
+  EXPECT_TRUE(after.count(name));
+  for (auto& n : before) {
+    if (std::hash<std::string>{}(n) % num_shards != 0) {
+      EXPECT_TRUE(after.count(n)) << n;
+    }
+  }
+}
+
+TEST_F(ObjectCacheTest, InvalidateRemove)
+{
+  make_cache(1, 3);
+  put("a");
+  put("b");
+  EXPECT_TRUE(cache->invalidate_remove(&dpp, "a"));
+  EXPECT_FALSE(hit("a"));
+  // the freed slot is reused without evicting anything
+  put("c");
+  put("d");
+  EXPECT_EQ(std::set<std::string>({"b", "c", "d"}), cached());
+}
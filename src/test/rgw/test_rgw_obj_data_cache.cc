@@ -0,0 +1,249 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#include "rgw_obj_data_cache.h"
+#include "global/global_context.h"
+#include <gtest/gtest.h>
+
+static RGWObjDataCache::Version make_version(const std::string& tag,
+                                             uint64_t size)
+{
+  RGWObjDataCache::Version version;
+  version.tag = tag;
+  version.etag = "etag-" + tag;
+  version.size = size;
+  return version;
+}
+
+static bufferlist make_data(const std::string& s)
+{
+  bufferlist bl;
+  bl.append(s);
+  return bl;
+}
+
+TEST(RGWObjDataCache, HitAfterPut)
+{
+  RGWObjDataCache cache(g_ceph_context, 1 << 20, 64 << 10);
+  const auto key = RGWObjDataCache::make_key("bucket:1", "obj");
+  const auto version = make_version("t1", 3);
+
+  bufferlist bl;
+  EXPECT_FALSE(cache.get(key, version, bl));
+  cache.put(key, version, make_data("abc"));
+  ASSERT_TRUE(cache.get(key, version, bl));
+  EXPECT_EQ("abc", bl.to_str());
+  EXPECT_EQ(3u, cache.get_size());
+  EXPECT_EQ(1u, cache.get_num_entries());
+}
+
+TEST(RGWObjDataCache, KeysAreDistinct)
+{
+  RGWObjDataCache cache(g_ceph_context, 1 << 20, 64 << 10);
+  const auto version = make_version("t1", 3);
+  cache.put(RGWObjDataCache::make_key("bucket:1", "obj"), version,
+            make_data("abc"));
+
+  bufferlist bl;
+  EXPECT_FALSE(cache.get(RGWObjDataCache::make_key("bucket:2", "obj"),
+                         version, bl));
+  EXPECT_FALSE(cache.get(RGWObjDataCache::make_key("bucket:1", "_:v1_obj"),
+                         version, bl));
+}
+
+TEST(RGWObjDataCache, RewrittenObjectMisses)
+{
+  RGWObjDataCache cache(g_ceph_context, 1 << 20, 64 << 10);
+  const auto key = RGWObjDataCache::make_key("bucket:1", "obj");
+  cache.put(key, make_version("t1", 3), make_data("abc"));
+  ASSERT_TRUE(cache.contains(key));
+
+  // another gateway overwrote the object, the head now carries a new tag
+  bufferlist bl;
+  EXPECT_FALSE(cache.get(key, make_version("t2", 3), bl));
+  EXPECT_FALSE(cache.contains(key));
+  EXPECT_EQ(0u, cache.get_size());
+}
+
+TEST(RGWObjDataCache, Invalidate)
+{
+  RGWObjDataCache cache(g_ceph_context, 1 << 20, 64 << 10);
+  const auto key = RGWObjDataCache::make_key("bucket:1", "obj");
+  const auto version = make_version("t1", 3);
+  cache.put(key, version, make_data("abc"));
+  cache.invalidate(key);
+
+  bufferlist bl;
+  EXPECT_FALSE(cache.get(key, version, bl));
+  EXPECT_EQ(0u, cache.get_num_entries());
+  cache.invalidate(key); // no-op
+}
+
+TEST(RGWObjDataCache, ReplaceResident)
+{
+  RGWObjDataCache cache(g_ceph_context, 1 << 20, 64 << 10);
+  const auto key = RGWObjDataCache::make_key("bucket:1", "obj");
+  cache.put(key, make_version("t1", 3), make_data("abc"));
+  cache.put(key, make_version("t2", 4), make_data("defg"));
+
+  bufferlist bl;
+  ASSERT_TRUE(cache.get(key, make_version("t2", 4), bl));
+  EXPECT_EQ("defg", bl.to_str());
+  EXPECT_EQ(4u, cache.get_size());
+  EXPECT_EQ(1u, cache.get_num_entries());
+}
+
+TEST(RGWObjDataCache, SkipsLargeObjects)
+{
+  RGWObjDataCache cache(g_ceph_context, 1 << 20, 4);
+  const auto key = RGWObjDataCache::make_key("bucket:1", "obj");
+  const auto version = make_version("t1", 5);
+  cache.put(key, version, make_data("abcde"));
+
+  EXPECT_FALSE(cache.contains(key));
+  EXPECT_EQ(0u, cache.get_size());
+}
+
+TEST(RGWObjDataCache, StaysWithinBudget)
+{
+  constexpr uint64_t max_bytes = 16 * 1024;
+  RGWObjDataCache cache(g_ceph_context, max_bytes, 1024);
+  const std::string data(512, 'x');
+  for (int i = 0; i < 1000; ++i) {
+    const auto key = RGWObjDataCache::make_key("bucket:1", std::to_string(i));
+    const auto version = make_version("t1", data.size());
+    bufferlist bl;
+    cache.get(key, version, bl);
+    cache.put(key, version, make_data(data));
+    EXPECT_LE(cache.get_size(), max_bytes);
+  }
+  EXPECT_GT(cache.get_num_entries(), 0u);
+}
+
+TEST(RGWObjDataCache, AdmissionKeepsHotObjects)
+{
+  constexpr uint64_t max_bytes = 16 * 1024;
+  RGWObjDataCache cache(g_ceph_context, max_bytes, 1024);
+  const std::string data(512, 'x');
+  const auto version = make_version("t1", data.size());
+
+  const auto hot = RGWObjDataCache::make_key("bucket:1", "hot");
+  bufferlist bl;
+  for (int i = 0; i < 5; ++i) {
+    cache.get(hot, version, bl);
+  }
+  cache.put(hot, version, make_data(data));
+
+  // a scan of objects that are each read once must not flush out an object
+  // that is read repeatedly
+  for (int i = 0; i < 1000; ++i) {
+    const auto key = RGWObjDataCache::make_key("bucket:1", std::to_string(i));
+    if (!cache.get(key, version, bl)) {
+      cache.put(key, version, make_data(data));
+    }
+  }
+  EXPECT_TRUE(cache.get(hot, version, bl));
+}
+
+static RGWObjDataCache::Head make_head(const std::string& tag, uint64_t size)
+{
+  RGWObjDataCache::Head head;
+  head.size = size;
+  head.attrs["user.rgw.idtag"] = make_data(tag);
+  head.stamp = ceph::coarse_mono_clock::now();
+  return head;
+}
+
+TEST(RGWObjDataCache, FreshHeadSkipsStat)
+{
+  RGWObjDataCache cache(g_ceph_context, 1 << 20, 64 << 10,
+                        std::chrono::hours(1));
+  const auto key = RGWObjDataCache::make_key("bucket:1", "obj");
+  RGWObjDataCache::Head head;
+  bufferlist bl;
+  EXPECT_EQ(RGWObjDataCache::HeadLookup::none, cache.get_head(key, &head, &bl));
+
+  cache.put(key, make_version("t1", 3), make_data("abc"), make_head("t1", 3));
+  ASSERT_EQ(RGWObjDataCache::HeadLookup::fresh, cache.get_head(key, &head, &bl));
+  EXPECT_EQ("t1", head.attrs["user.rgw.idtag"].to_str());
+  // the head holds the whole object, so its data comes along
+  EXPECT_EQ("abc", bl.to_str());
+
+  // data filled without a head, e.g. of a multipart upload, always needs
+  // the stat
+  const auto other = RGWObjDataCache::make_key("bucket:1", "other");
+  cache.put(other, make_version("t1", 3), make_data("abc"));
+  EXPECT_EQ(RGWObjDataCache::HeadLookup::none,
+            cache.get_head(other, &head, &bl));
+}
+
+TEST(RGWObjDataCache, HeadOfMultipartHasNoData)
+{
+  RGWObjDataCache cache(g_ceph_context, 1 << 20, 64 << 10,
+                        std::chrono::hours(1));
+  const auto key = RGWObjDataCache::make_key("bucket:1", "obj");
+  // the data lives in the parts, the head object is empty
+  cache.put(key, make_version("t1", 3), make_data("abc"), make_head("t1", 0));
+  RGWObjDataCache::Head head;
+  bufferlist bl;
+  ASSERT_EQ(RGWObjDataCache::HeadLookup::fresh, cache.get_head(key, &head, &bl));
+  EXPECT_EQ(0u, bl.length());
+}
+
+TEST(RGWObjDataCache, StaleHeadIsRevalidated)
+{
+  RGWObjDataCache cache(g_ceph_context, 1 << 20, 64 << 10,
+                        std::chrono::hours(1));
+  const auto key = RGWObjDataCache::make_key("bucket:1", "obj");
+  auto old = make_head("t1", 3);
+  old.stamp -= std::chrono::hours(2);
+  cache.put(key, make_version("t1", 3), make_data("abc"), old);
+
+  RGWObjDataCache::Head head;
+  bufferlist bl;
+  EXPECT_EQ(RGWObjDataCache::HeadLookup::stale, cache.get_head(key, &head, &bl));
+
+  // the head was read again and hasn't changed
+  cache.revalidate_head(key, make_head("t1", 3));
+  EXPECT_EQ(RGWObjDataCache::HeadLookup::fresh, cache.get_head(key, &head, &bl));
+  EXPECT_TRUE(cache.get(key, make_version("t1", 3), bl));
+}
+
+TEST(RGWObjDataCache, ChangedHeadDropsEntry)
+{
+  RGWObjDataCache cache(g_ceph_context, 1 << 20, 64 << 10,
+                        std::chrono::hours(1));
+  const auto key = RGWObjDataCache::make_key("bucket:1", "obj");
+  auto old = make_head("t1", 3);
+  old.stamp -= std::chrono::hours(2);
+  cache.put(key, make_version("t1", 3), make_data("abc"), old);
+
+  RGWObjDataCache::Head head;
+  bufferlist bl;
+  ASSERT_EQ(RGWObjDataCache::HeadLookup::stale, cache.get_head(key, &head, &bl));
+  // another gateway rewrote the object in the meantime
+  cache.revalidate_head(key, make_head("t2", 3));
+  EXPECT_FALSE(cache.contains(key));
+  EXPECT_EQ(0u, cache.get_size());
+}
+
+TEST(RGWObjDataCache, ZeroTTLAlwaysRevalidates)
+{
+  RGWObjDataCache cache(g_ceph_context, 1 << 20, 64 << 10);
+  const auto key = RGWObjDataCache::make_key("bucket:1", "obj");
+  cache.put(key, make_version("t1", 3), make_data("abc"), make_head("t1", 3));
+  RGWObjDataCache::Head head;
+  bufferlist bl;
+  EXPECT_EQ(RGWObjDataCache::HeadLookup::stale, cache.get_head(key, &head, &bl));
+}
+
+TEST(RGWObjDataCache, HeadCountsAgainstBudget)
+{
+  RGWObjDataCache cache(g_ceph_context, 1 << 20, 64 << 10,
+                        std::chrono::hours(1));
+  const auto key = RGWObjDataCache::make_key("bucket:1", "obj");
+  cache.put(key, make_version("t1", 3), make_data("abc"), make_head("t1", 3));
+  EXPECT_GT(cache.get_size(), 3u);
+  cache.invalidate(key);
+  EXPECT_EQ(0u, cache.get_size());
+}
@@ -13,6 +13,9 @@
  */
 
 #include "rgw_putobj.h"
+#include <thread>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
 #include <gtest/gtest.h>
 
 inline bufferlist string_buf(const char* buf) {
@@ -194,3 +197,99 @@ TEST(PutObj_Stripe, SkipFirstChunk)
   ASSERT_EQ(4u, mock.ops.size());
   EXPECT_EQ(Op({"", 4}), mock.ops[3]); // flush
 }
+
+// runs an io_context on a background thread for OffloadProcessor
+struct Workers {
+  boost::asio::io_context context;
+  boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work;
+  std::thread thread;
+
+  Workers() : work(boost::asio::make_work_guard(context)),
+              thread([this] { context.run(); }) {}
+  ~Workers() {
+    work.reset();
+    thread.join();
+  }
+};
+
+struct ErrorProcessor : rgw::sal::DataProcessor {
+  int process(bufferlist&& data, uint64_t offset) override {
+    return -EIO;
+  }
+};
+
+TEST(PutObj_Offload, InOrder)
+{
+  Workers workers;
+  MockProcessor mock;
+  rgw::putobj::OffloadProcessor offload(workers.context, null_yield,
+                                        &mock, nullptr);
+  rgw::putobj::ChunkProcessor chunk(offload.get_output(), 4);
+  offload.set_next(&chunk);
+
+  ASSERT_EQ(0, offload.process(string_buf("22"), 0));
+  ASSERT_EQ(0, offload.process(string_buf("4444"), 2));
+  ASSERT_EQ(0, offload.process(string_buf("666666"), 6));
+  // output is written one chunk behind
+  ASSERT_EQ(1u, mock.ops.size());
+  EXPECT_EQ(Op({"2244", 0}), mock.ops[0]);
+
+  ASSERT_EQ(0, offload.process({}, 12)); // flush
+  ASSERT_EQ(4u, mock.ops.size());
+  EXPECT_EQ(Op({"4466", 4}), mock.ops[1]);
+  EXPECT_EQ(Op({"6666", 8}), mock.ops[2]);
+  EXPECT_EQ(Op({"", 12}), mock.ops[3]);
+}
+
+TEST(PutObj_Offload, Hash)
+{
+  Workers workers;
+  MockProcessor mock;
+  ceph::crypto::MD5 hash;
+  rgw::putobj::OffloadProcessor offload(workers.context, null_yield,
+                                        &mock, &hash);
+  offload.set_next(offload.get_output());
+
+  bufferlist data = string_buf("22");
+  data.append(string_buf("4444")); // hash each buffer of the list
+  ASSERT_EQ(0, offload.process(std::move(data), 0));
+  ASSERT_EQ(0, offload.process(string_buf("666666"), 6));
+  ASSERT_EQ(0, offload.process({}, 12));
+
+  unsigned char m[CEPH_CRYPTO_MD5_DIGESTSIZE];
+  hash.Final(m);
+
+  ceph::crypto::MD5 expected_hash;
+  const std::string expected_data = "224444666666";
+  expected_hash.Update((const unsigned char*)expected_data.data(),
+                       expected_data.size());
+  unsigned char expected[CEPH_CRYPTO_MD5_DIGESTSIZE];
+  expected_hash.Final(expected);
+  EXPECT_EQ(0, memcmp(expected, m, sizeof(m)));
+}
+
+TEST(PutObj_Offload, ProcessError)
+{
+  Workers workers;
+  MockProcessor mock;
+  ErrorProcessor error;
+  rgw::putobj::OffloadProcessor offload(workers.context, null_yield,
+                                        &mock, nullptr);
+  offload.set_next(&error);
+
+  // the error is returned with the next chunk
+  ASSERT_EQ(0, offload.process(string_buf("22"), 0));
+  EXPECT_EQ(-EIO, offload.process(string_buf("22"), 2));
+}
+
+TEST(PutObj_Offload, WriteError)
+{
+  Workers workers;
+  ErrorProcessor error;
+  rgw::putobj::OffloadProcessor offload(workers.context, null_yield,
+                                        &error, nullptr);
+  offload.set_next(offload.get_output());
+
+  ASSERT_EQ(0, offload.process(string_buf("22"), 0));
+  EXPECT_EQ(-EIO, offload.process({}, 2));
+}